@@ -6,6 +6,8 @@
 
 #include <WiFiClientSecure.h>
 WiFiClientSecure client;
+// Second connection: messages and photo uploads don't wait for polling requests (dual connection mode)
+WiFiClientSecure sendClient;
 
 const char *ssid = "xxxxxxxxxxxx"; // SSID WiFi network
 const char *pass = "xxxxxxxxxxxx"; // Password  WiFi network
@@ -179,9 +181,11 @@ void setup()
   // Sync time with NTP
   configTzTime(MYTZ, "time.google.com", "time.windows.com", "pool.ntp.org");
   client.setCACert(telegram_cert);
+  sendClient.setCACert(telegram_cert);
 
   // Set the Telegram bot properies
   myBot.setUpdateTime(1000);
+  myBot.setSendClient(sendClient);
   myBot.setTelegramToken(token);
 
   // Check if all things are ok
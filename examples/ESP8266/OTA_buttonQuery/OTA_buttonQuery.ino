@@ -13,7 +13,7 @@
 #include <time.h>
 #include <LittleFS.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266httpUpdate.h>
+#include <TelegramOTA.h>
 
 BearSSL::WiFiClientSecure client;
 BearSSL::Session session;
@@ -68,8 +68,6 @@ void setup()
   int64_t chat_id = 1234567890; // You can discover your own chat id, with "Json Dump Bot"
   myBot.sendTo(chat_id, welcome_msg);
 
-  // We have to handle reboot manually after sync with TG server
-  ESPhttpUpdate.rebootOnUpdate(false);
 }
 
 void loop()
@@ -89,17 +87,18 @@ void loop()
   if (myBot.getNewMessage(msg))
   {
     String tgReply;
-    static String document;
+    static TBMessage document;
 
     switch (msg.messageType)
     {
     case MessageDocument:
-      document = msg.document.file_path;
-      if (msg.document.file_exists)
+      // Keep the document message: firmware is downloaded after user confirmation
+      document = msg;
+      if (msg.document.file_size > 0)
       {
 
         // Check file extension of received document (firmware must be .bin)
-        if (document.endsWith(".bin") > -1)
+        if (String(msg.document.file_name).endsWith(".bin"))
         {
           String report = "Start firmware update?\nFile name: " + String(msg.document.file_name) + "\nFile size: " + String(msg.document.file_size);
 
@@ -124,8 +123,7 @@ void loop()
       if (tgReply.equalsIgnoreCase(CONFIRM))
       {
         myBot.endQuery(msg, "Start flashing... please wait (~30/60s)", true);
-        handleUpdate(msg, document);
-        document.clear();
+        handleUpdate(document);
       }
       // User has canceled the command
       else if (tgReply.equalsIgnoreCase(CANCEL))
@@ -144,7 +142,7 @@ void loop()
       }
       else
       {
-        myBot.sendMessage(msg, "Send firmware binary file ###.bin to start update\n"
+        myBot.sendMessage(msg, "Send firmware binary file ###.bin (with its SHA-256 as caption) to start update\n"
                                "/version for print the current firmware version\n");
       }
       break;
@@ -152,46 +150,18 @@ void loop()
   }
 }
 
-// Install firmware update
-void handleUpdate(TBMessage msg, String &file_path)
+// Install firmware update: the image is streamed to flash over the bot connection
+// and verified with the SHA-256 written in the caption of document
+void handleUpdate(TBMessage &fwMsg)
 {
+  FlashUpdateSink flash;
+  TelegramOTA ota(myBot, flash);
 
-  // Create client for rom download
-  WiFiClientSecure client;
-  client.setInsecure();
+  OTAResult ret = ota.update(fwMsg);
+  Serial.printf("Update done, result: %d\n", ret);
 
-  String report;
-  Serial.print("Firmware path: ");
-  Serial.println(file_path);
-
-  ESPhttpUpdate.onProgress([](int cur, int total) {
-    static uint32_t sendT;
-    if (millis() - sendT > 1000)
-    {
-      sendT = millis();
-      Serial.printf("Updating %d of %d bytes...\n", cur, total);
-    }
-  });
-  t_httpUpdate_return ret = ESPhttpUpdate.update(client, file_path);
-  Serial.println("Update done!");
-  client.stop();
-  file_path.clear();
-
-  switch (ret)
+  if (ret == OTA_OK)
   {
-  case HTTP_UPDATE_FAILED:
-    report = "HTTP_UPDATE_FAILED Error (" + ESPhttpUpdate.getLastError();
-    +"): " + ESPhttpUpdate.getLastErrorString();
-    myBot.sendMessage(msg, report.c_str());
-    break;
-
-  case HTTP_UPDATE_NO_UPDATES:
-    myBot.sendMessage(msg, "HTTP_UPDATE_NO_UPDATES");
-    break;
-
-  case HTTP_UPDATE_OK:
-    myBot.begin();
-    myBot.sendMessage(msg, "UPDATE OK.\nRestarting in few seconds...");
     // Wait until bot synced with telegram to prevent cyclic reboot
     while (!myBot.noNewMessage())
     {
@@ -199,9 +169,5 @@ void handleUpdate(TBMessage msg, String &file_path)
       delay(50);
     }
     ESP.restart();
-
-    break;
-  default:
-    break;
   }
-}
\ No newline at end of file
+}
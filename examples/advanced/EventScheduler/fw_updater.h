@@ -31,6 +31,9 @@ bool updateHandler(TBMessage &theMsg, AsyncTelegramBot &theBot)
   case MessageDocument:
   {
 
+    // Document link is not resolved automatically: ask for it (blocking)
+    theBot.getFile(theMsg.document);
+
     // Store in memory link to the firmware file
     fw_path = theMsg.document.file_path;
     if (theMsg.document.file_exists)
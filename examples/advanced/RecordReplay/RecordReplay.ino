@@ -0,0 +1,96 @@
+/*
+  Name:        RecordReplay.ino
+  Created:     18/10/2026
+  Description: record the traffic of a real bot session, to be replayed offline.
+               The bot works as an echo bot and all the bytes exchanged with Telegram server are saved
+               in CAPTURE_FILE (send /stop to close the capture).
+               Download the capture from the filesystem to replay it on host with the Replay program of
+               extras/host (the bot receives again the same replies, without network: useful as benchmark
+               corpus or to reproduce a bug) or to inspect it with extras/fake_bot_api/capture_tool.py
+               Note: the capture contains the bot token.
+*/
+
+#include <FS.h>
+#include <AsyncTelegramBot.h>
+#include <TrafficCapture.h>
+
+#define CAPTURE_FILE  "/capture.bin"
+
+// Timezone definition
+#include <time.h>
+#define MYTZ "CET-1CEST,M3.5.0,M10.5.0/3"
+
+#ifdef ESP8266
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+BearSSL::WiFiClientSecure client;
+BearSSL::Session session;
+BearSSL::X509List certificate(telegram_cert);
+#define FILESYSTEM LittleFS
+#elif defined(ESP32)
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <SPIFFS.h>
+WiFiClientSecure client;
+#define FILESYSTEM SPIFFS
+#endif
+
+RecordingClient recorder(client);
+AsyncTelegramBot myBot(recorder);
+File capture;
+
+const char *ssid = "xxxxxxxxx";                                  // SSID WiFi network
+const char *pass = "xxxxxxxxx";                                  // Password  WiFi network
+const char *token = "xxxxxxxxxxx:xxxxxxxxxxxxxxxxxxxxxxxxxxxxx"; // Telegram token
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("\nStarting TelegramBot...");
+  if (!FILESYSTEM.begin()) {
+    Serial.println("FS Mount Failed");
+    return;
+  }
+
+  capture = FILESYSTEM.open(CAPTURE_FILE, "w");
+  recorder.setCapture(&capture);
+
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, pass);
+  while (WiFi.status() != WL_CONNECTED) {
+    Serial.print('.');
+    delay(500);
+  }
+#ifdef ESP8266
+  configTime(MYTZ, "time.google.com", "time.windows.com", "pool.ntp.org");
+  client.setSession(&session);
+  client.setTrustAnchors(&certificate);
+  client.setBufferSizes(1024, 1024);
+#elif defined(ESP32)
+  configTzTime(MYTZ, "time.google.com", "time.windows.com", "pool.ntp.org");
+  client.setCACert(telegram_cert);
+#endif
+  myBot.setUpdateTime(2000);
+
+  myBot.setTelegramToken(token);
+  Serial.print("\nTest Telegram connection... ");
+  myBot.begin() ? Serial.println("OK") : Serial.println("NOK");
+}
+
+void loop()
+{
+  static TBMessage msg;
+
+  MessageType type = myBot.getNewMessage(msg);
+  if (type != MessageNoData) {
+    Serial.printf("Update type %d from %lld: %s\n", (int)type, (long long)msg.sender.id, msg.text.c_str());
+    if (msg.text.equalsIgnoreCase("/stop") && capture) {
+      recorder.setCapture(nullptr);
+      Serial.printf("Capture closed: %lu bytes\n", (unsigned long)capture.size());
+      capture.close();
+      return;
+    }
+    // Replayed on host, the bot sends the same replies, so the recorded requests are matched
+    myBot.sendMessage(msg, msg.text);
+  }
+}
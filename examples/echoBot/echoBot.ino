@@ -25,7 +25,7 @@
 #ifdef ESP8266
 #include <ESP8266WiFi.h>
 BearSSL::WiFiClientSecure client;
-BearSSL::Session session;
+BearSSLSession session(client);     // TLS session resumed at reconnections
 BearSSL::X509List certificate(telegram_cert);
 
 #elif defined(ESP32)
@@ -71,7 +71,7 @@ void setup()
   // Sync time with NTP, to check properly Telegram certificate
   configTime(MYTZ, "time.google.com", "time.windows.com", "pool.ntp.org");
   //Set certficate, session and some other base client properies
-  client.setSession(&session);
+  myBot.setTLSSession(&session);
   client.setTrustAnchors(&certificate);
   client.setBufferSizes(1024, 1024);
 #elif defined(ESP32)
@@ -128,4 +128,4 @@ void loop()
     // echo the received message
     myBot.sendMessage(msg, msg.text);
   }
-}
\ No newline at end of file
+}
\ No newline at end of file
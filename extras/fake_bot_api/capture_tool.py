@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Inspect captures made with RecordingClient (see examples/advanced/RecordReplay).
+
+    capture_tool.py dump capture.bin            list request/reply pairs with timings
+    capture_tool.py updates capture.bin -o u.json
+                                                extract received updates, for fake_bot_api.py --updates
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+HEADER = b"TBCAP1\n"
+REQUEST_RE = re.compile(rb"^(\w+) /bot[^/]+/(\w+)")
+
+
+def read_records(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data.startswith(HEADER):
+        sys.exit("%s: not a capture file" % path)
+    pos = len(HEADER)
+    while pos + 7 <= len(data):
+        kind, ms, length = struct.unpack_from("<cIH", data, pos)
+        pos += 7
+        yield kind.decode(), ms, data[pos:pos + length]
+        pos += length
+
+
+def exchanges(path):
+    """Group records in (request time, request, reply time, reply, connection events)"""
+    current = None
+    events = []
+    for kind, ms, data in read_records(path):
+        if kind == "W":
+            if current is None or current[3]:
+                if current:
+                    yield current
+                current = [ms, b"", None, b"", events]
+                events = []
+            current[1] += data
+        elif kind == "R" and current:
+            if current[2] is None:
+                current[2] = ms
+            current[3] += data
+        elif kind in "CSD":
+            events.append(kind + (data[1:].decode(errors="replace") if kind == "C" else ""))
+    if current:
+        yield current
+
+
+def body(reply):
+    return reply.split(b"\r\n\r\n", 1)[1] if b"\r\n\r\n" in reply else b""
+
+
+def dump(args):
+    for sent, request, received, reply, events in exchanges(args.capture):
+        match = REQUEST_RE.match(request)
+        method = match.group(2).decode() if match else request.split(b" ", 1)[0].decode(errors="replace")
+        status = reply.split(b" ", 2)[1].decode() if reply.startswith(b"HTTP/") else "-"
+        latency = "%5d ms" % (received - sent) if received is not None else "no reply"
+        print("%10d %-22s %s %6d > %6d < %s %s" % (sent, method, status, len(request), len(reply), latency,
+                                                  " ".join(events)))
+
+
+def updates(args):
+    result = []
+    for _, request, _, reply, _ in exchanges(args.capture):
+        match = REQUEST_RE.match(request)
+        if not match or match.group(2) != b"getUpdates":
+            continue
+        try:
+            result += json.loads(body(reply)).get("result", [])
+        except ValueError:
+            pass
+    with open(args.output, "w") if args.output else sys.stdout as out:
+        json.dump(result, out, indent=1)
+        out.write("\n")
+    sys.stderr.write("%d updates\n" % len(result))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    command = commands.add_parser("dump", help="list request/reply pairs")
+    command.add_argument("capture")
+    command.set_defaults(run=dump)
+    command = commands.add_parser("updates", help="extract updates as JSON list")
+    command.add_argument("capture")
+    command.add_argument("-o", "--output", help="output file (default: stdout)")
+    command.set_defaults(run=updates)
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
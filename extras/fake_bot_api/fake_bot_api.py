@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""Fake Telegram Bot API server, for benchmarks and tests of AsyncTelegramBot without api.telegram.org.
+
+Only the Python standard library is needed. Point the bot at it with
+    myBot.setTelegramServer("192.168.1.10", 8080);
+and use a plain WiFiClient (or WiFiClientSecure with setInsecure() if --cert/--key are given).
+"""
+
+import argparse
+import base64
+import hashlib
+import json
+import random
+import re
+import ssl
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+BOT_RE = re.compile(r"^(?:https?://[^/]+)?/bot([^/]+)/(\w+)")
+FILE_RE = re.compile(r"^(?:https?://[^/]+)?/file/bot([^/]+)/(.+)$")
+
+
+def compact_json(obj):
+    # Same format of Telegram replies (the bot looks for '{"ok":true' in some replies)
+    return json.dumps(obj, separators=(",", ":"))
+
+
+class State:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.random = random.Random(args.seed)
+        self.message_id = 1000
+        self.updates = []
+        if args.updates:
+            with open(args.updates) as f:
+                self.updates = json.load(f)
+        self.log = open(args.log, "w") if args.log else sys.stdout
+        self.log.write("time,method,status,bytes_in,bytes_out,ms,fault\n")
+
+    def chance(self, probability):
+        with self.lock:
+            return self.random.random() < probability
+
+    def next_message_id(self):
+        with self.lock:
+            self.message_id += 1
+            return self.message_id
+
+    def pending_updates(self, offset, limit):
+        with self.lock:
+            # Updates with id lower than offset are confirmed and can be forgotten
+            self.updates = [u for u in self.updates if u["update_id"] >= offset]
+            return self.updates[:limit]
+
+    def record(self, method, status, bytes_in, bytes_out, start, fault):
+        with self.lock:
+            self.log.write("%.3f,%s,%d,%d,%d,%.1f,%s\n" % (
+                time.time(), method, status, bytes_in, bytes_out, (time.time() - start) * 1000, fault))
+            self.log.flush()
+
+
+class Handler(BaseHTTPRequestHandler):
+    # Needed for persistent connections (the bot sends HTTP/1.0 requests with keep-alive)
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length else b""
+
+    def send_reply(self, status, body, method, start, bytes_in, extra_headers=None):
+        state = self.server.state
+        args = state.args
+        fault = ""
+        if args.slow and state.chance(args.slow):
+            time.sleep(args.slow_ms / 1000)
+            fault = "slow"
+        close = args.close and state.chance(args.close)
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json" if isinstance(body, str) else "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (extra_headers or {}).items():
+            self.send_header(name, value)
+        self.send_header("Connection", "close" if close else "keep-alive")
+        self.end_headers()
+        data = body.encode() if isinstance(body, str) else body
+        if args.cut and len(data) > 1 and state.chance(args.cut):
+            # Drop connection in the middle of body
+            self.wfile.write(data[:len(data) // 2])
+            self.close_connection = True
+            fault = "cut"
+        else:
+            self.wfile.write(data)
+            if close:
+                self.close_connection = True
+                fault = fault or "close"
+        state.record(method, status, bytes_in, len(data), start, fault)
+
+    def do_POST(self):
+        start = time.time()
+        body = self.read_body()
+        match = BOT_RE.match(self.path)
+        if not match:
+            return self.send_reply(404, '{"ok":false,"error_code":404,"description":"Not Found"}', "?", start, len(body))
+        method = match.group(2)
+        state = self.server.state
+        args = state.args
+        if args.rate_limit and state.chance(args.rate_limit):
+            reply = {"ok": False, "error_code": 429, "description": "Too Many Requests: retry after %d" % args.retry_after,
+                     "parameters": {"retry_after": args.retry_after}}
+            return self.send_reply(429, compact_json(reply), method, start, len(body))
+
+        params = {}
+        if self.headers.get("Content-Type", "").startswith("application/json") and body:
+            try:
+                params = json.loads(body)
+            except ValueError:
+                reply = {"ok": False, "error_code": 400, "description": "Bad Request: can't parse JSON"}
+                return self.send_reply(400, compact_json(reply), method, start, len(body))
+        self.send_reply(200, compact_json({"ok": True, "result": self.result(method, params)}), method, start, len(body))
+
+    def do_GET(self):
+        start = time.time()
+        match = FILE_RE.match(self.path)
+        if not match:
+            return self.send_reply(404, '{"ok":false,"error_code":404,"description":"Not Found"}', "GET", start, 0)
+        data = self.file_content(match.group(2))
+        first, last = 0, len(data) - 1
+        status = 200
+        headers = {}
+        # Range requests are used by the bot to resume downloads
+        range_match = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("Range", ""))
+        if range_match:
+            first = int(range_match.group(1))
+            if range_match.group(2):
+                last = min(int(range_match.group(2)), last)
+            status = 206
+            headers["Content-Range"] = "bytes %d-%d/%d" % (first, last, len(data))
+        self.send_reply(status, data[first:last + 1], "file", start, 0, headers)
+
+    def file_content(self, path):
+        args = self.server.state.args
+        if args.files:
+            try:
+                with open("%s/%s" % (args.files, path.split("/")[-1]), "rb") as f:
+                    return f.read()
+            except OSError:
+                pass
+        # Deterministic content, so integrity of downloads can be checked
+        size = args.file_size
+        return bytes((i * 31 + 7) & 0xFF for i in range(size))
+
+    def result(self, method, params):
+        state = self.server.state
+        if method == "getMe":
+            return {"id": 123456789, "is_bot": True, "first_name": "Fake", "username": "fake_bot"}
+        if method == "getUpdates":
+            return state.pending_updates(int(params.get("offset", 0)), int(params.get("limit", 100)))
+        if method == "getFile":
+            file_id = params.get("file_id", "file")
+            return {"file_id": file_id, "file_unique_id": file_id, "file_size": state.args.file_size,
+                    "file_path": "documents/%s.bin" % file_id}
+        if method in ("answerCallbackQuery", "setMyCommands", "deleteMyCommands"):
+            return True
+        if method == "getMyCommands":
+            return []
+        # sendMessage, sendPhoto, editMessageText, forwardMessage...: echo the request as a message
+        chat_id = params.get("chat_id", 0)
+        message = {"message_id": params.get("message_id") or state.next_message_id(),
+                   "from": {"id": 123456789, "is_bot": True, "first_name": "Fake", "username": "fake_bot"},
+                   "chat": {"id": chat_id, "type": "private"}, "date": int(time.time())}
+        for key in ("text", "caption", "reply_markup"):
+            if key in params:
+                message[key] = params[key]
+        return message
+
+
+def der_element(data, pos):
+    """Return (start of content, end of element) of the DER element at pos"""
+    length = data[pos + 1]
+    start = pos + 2
+    if length & 0x80:
+        size = length & 0x7F
+        length = int.from_bytes(data[start:start + size], "big")
+        start += size
+    return start, start + length
+
+
+def key_pin(cert_file):
+    """Pin of certificate public key: base64 of SHA-256 of SubjectPublicKeyInfo (see KeyPinSet)"""
+    with open(cert_file) as f:
+        der = ssl.PEM_cert_to_DER_cert(f.read())
+    tbs, _ = der_element(der, 0)
+    pos, _ = der_element(der, tbs)
+    fields = []
+    while len(fields) < 7:
+        start, end = der_element(der, pos)
+        fields.append((pos, end))
+        pos = end
+    # version [0] is optional: then serial, signature, issuer, validity, subject, public key
+    spki = fields[6] if der[fields[0][0]] == 0xA0 else fields[5]
+    return "sha256//" + base64.b64encode(hashlib.sha256(der[spki[0]:spki[1]]).digest()).decode()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--cert", help="certificate file (enable TLS, ex. a self-signed one)")
+    parser.add_argument("--key", help="private key file of certificate")
+    parser.add_argument("--updates", help="JSON file with the list of updates returned by getUpdates")
+    parser.add_argument("--files", help="folder with files served for download (default: generated content)")
+    parser.add_argument("--file-size", type=int, default=65536, help="size of generated files")
+    parser.add_argument("--rate-limit", type=float, default=0, help="probability of a 429 reply")
+    parser.add_argument("--retry-after", type=int, default=1, help="retry_after of 429 replies (seconds)")
+    parser.add_argument("--slow", type=float, default=0, help="probability of a delayed reply")
+    parser.add_argument("--slow-ms", type=int, default=2000, help="delay of slow replies")
+    parser.add_argument("--close", type=float, default=0, help="probability of Connection: close")
+    parser.add_argument("--cut", type=float, default=0, help="probability of disconnection in the middle of body")
+    parser.add_argument("--seed", type=int, default=0, help="seed of faults generator")
+    parser.add_argument("--log", help="CSV file for request timings (default: stdout)")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.state = State(args)
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        sys.stderr.write("Public key pin: %s\n" % key_pin(args.cert))
+    sys.stderr.write("Fake Bot API listening on %s:%d%s\n" % (args.host, args.port, " (TLS)" if args.cert else ""))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,217 @@
+/*
+  Name:        Benchmark.cpp
+  Created:     18/10/2026
+  Description: microbenchmark of library hot paths (parsing of updates, payload building, keyboards
+               and multipart upload header). No network is needed: the bot is connected to a
+               MockClient that returns scripted replies, so only the library code is measured.
+               For each test the time per operation, the allocations made from the library allocator,
+               the allocations of the whole system heap (malloc and operator new, so String too; the
+               allocations of the MockClient are excluded) and the variation of memory used by the
+               library are printed. Runs on host (see extras/host/README.md).
+*/
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <HostHeap.h>
+
+#define ITERATIONS      200
+
+MockClient mock;
+UncountedClient server(mock);
+TrackingAllocator botMemory;
+TrackingAllocator kbdMemory;
+AsyncTelegramBotDynamic myBot(server, botMemory);
+
+#define FROM  "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\",\"last_name\":\"Doe\"," \
+              "\"username\":\"johndoe\",\"language_code\":\"en\"}"
+#define CHAT  "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"last_name\":\"Doe\",\"username\":\"johndoe\",\"type\":\"private\"}"
+#define MSG   "\"message_id\":1234," FROM "," CHAT ",\"date\":1620000000"
+
+// Reply of the server to messages sent by the bot (read before the next request)
+#define SENT_REPLY  "{\"ok\":true,\"result\":{\"message_id\":1}}"
+
+struct UpdateSample {
+  const char *name;
+  const char *json;
+};
+
+const UpdateSample samples[] = {
+  {"text", "{\"ok\":true,\"result\":[{\"update_id\":100001,\"message\":{" MSG
+           ",\"text\":\"Hello bot, this is a plain text message\"}}]}"},
+  {"query", "{\"ok\":true,\"result\":[{\"update_id\":100002,\"callback_query\":{\"id\":\"4382bfdwdsb323b2d9\"," FROM
+            ",\"message\":{" MSG ",\"text\":\"Choose an option\"},\"chat_instance\":\"-7654321987654321\",\"data\":\"LIGHT_ON\"}}]}"},
+  {"location", "{\"ok\":true,\"result\":[{\"update_id\":100003,\"message\":{" MSG
+               ",\"location\":{\"latitude\":45.464664,\"longitude\":9.188540}}}]}"},
+  {"contact", "{\"ok\":true,\"result\":[{\"update_id\":100004,\"message\":{" MSG
+              ",\"contact\":{\"phone_number\":\"+391234567890\",\"first_name\":\"Jane\",\"last_name\":\"Roe\",\"user_id\":987654321}}}]}"},
+  {"document", "{\"ok\":true,\"result\":[{\"update_id\":100005,\"message\":{" MSG
+               ",\"document\":{\"file_name\":\"firmware.bin\",\"mime_type\":\"application/octet-stream\","
+               "\"file_id\":\"BQACAgQAAxkBAAIBY2CJ8Ks4kL7G9sbVx0YmzBz3NJm5AAJ0CAACdPhQUGmB3T2q8YyXHwQ\","
+               "\"file_unique_id\":\"AgADdAgAAnT4UFA\",\"file_size\":412345},\"caption\":\"new firmware\"}}]}"},
+  {"reply", "{\"ok\":true,\"result\":[{\"update_id\":100006,\"message\":{" MSG
+            ",\"reply_to_message\":{" MSG ",\"text\":\"Original message\"},\"text\":\"This is a reply\"}}]}"},
+};
+
+// Memory used by the library allocators is read only outside the measure
+struct Measure {
+  uint32_t start;
+  uint32_t used;
+  uint32_t allocations;
+  uint32_t mallocs;
+
+  void begin() {
+    used = botMemory.getUsed() + kbdMemory.getUsed();
+    allocations = botMemory.getAllocations() + kbdMemory.getAllocations();
+    mallocs = HostHeap::getAllocations();
+    start = micros();
+  }
+
+  void end(const char *name, uint32_t iterations) {
+    uint32_t elapsed = micros() - start;
+    uint32_t sysAllocs = HostHeap::getAllocations() - mallocs;
+    uint32_t allocs = botMemory.getAllocations() + kbdMemory.getAllocations() - allocations;
+    Serial.printf("%-24s %9lu ns/op %6.2f allocs/op %6.2f malloc/op %7ld bytes used delta\n", name,
+                  (unsigned long)((uint64_t)elapsed * 1000 / iterations), (float)allocs / iterations,
+                  (float)sysAllocs / iterations, (long)(botMemory.getUsed() + kbdMemory.getUsed()) - (long)used);
+  }
+};
+
+// Queue a reply of the server, allocations of MockClient are not counted
+void serverReply(const char *json)
+{
+  HostHeap::setPaused(true);
+  mock.addJsonReply(json);
+  HostHeap::setPaused(false);
+}
+
+void benchParse()
+{
+  TBMessage msg;
+  for (const UpdateSample &sample : samples) {
+    char name[32];
+    snprintf(name, sizeof(name), "getNewMessage %s", sample.name);
+    Measure measure;
+    measure.begin();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+      serverReply(sample.json);
+      MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+      myBot.getNewMessage(msg);
+    }
+    measure.end(name, ITERATIONS);
+    mock.clearRequests();
+  }
+}
+
+void benchSend()
+{
+  TBMessage msg;
+  msg.chatId = 123456789;
+  msg.sender.id = 123456789;
+  InlineKeyboard kbd(kbdMemory);
+  kbd.addButton("ON", "LIGHT_ON", KeyboardButtonQuery);
+  kbd.addButton("OFF", "LIGHT_OFF", KeyboardButtonQuery);
+  kbd.addRow();
+  kbd.addButton("Docs", "https://github.com/cotestatnt/AsyncTelegram2", KeyboardButtonURL);
+
+  Measure measure;
+  measure.begin();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    serverReply(SENT_REPLY);
+    myBot.sendMessage(msg, "Light is ON, temperature 21.5 C");
+    mock.clearRequests();
+  }
+  measure.end("sendMessage", ITERATIONS);
+
+  measure.begin();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    serverReply(SENT_REPLY);
+    myBot.sendMessage(msg, "Light is ON, temperature 21.5 C", kbd);
+    mock.clearRequests();
+  }
+  measure.end("sendMessage keyboard", ITERATIONS);
+
+  measure.begin();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    serverReply(SENT_REPLY);
+    myBot.sendTextMessage(msg.chatId, "Light is *ON*", "MarkdownV2");
+    mock.clearRequests();
+  }
+  measure.end("sendTextMessage", ITERATIONS);
+
+  const String markup = kbd.getJSON();
+  measure.begin();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    serverReply(SENT_REPLY);
+    myBot.sendTextMessage(msg.chatId, "Light is *ON*", "MarkdownV2", "", false, false, 0, false, true, markup);
+    mock.clearRequests();
+  }
+  measure.end("sendTextMessage keyboard", ITERATIONS);
+}
+
+void benchKeyboards()
+{
+  const uint8_t sizes[] = {10, 50, 100};
+  for (uint8_t buttons : sizes) {
+    char name[32];
+    snprintf(name, sizeof(name), "addButton x%u", buttons);
+    Measure measure;
+    measure.begin();
+    size_t jsonLen;
+    {
+      InlineKeyboard kbd(kbdMemory);
+      for (uint8_t i = 0; i < buttons; i++) {
+        char label[8];
+        snprintf(label, sizeof(label), "B%u", i);
+        if (i % 4 == 0)
+          kbd.addRow();
+        kbd.addButton(label, label, KeyboardButtonQuery);
+      }
+      jsonLen = kbd.getJSON().length();
+    }
+    measure.end(name, buttons);
+    Serial.printf("    JSON %u bytes, keyboard memory peak %u bytes\n", (unsigned)jsonLen, (unsigned)kbdMemory.getPeak());
+    kbdMemory.resetPeak();
+  }
+}
+
+bool benchUpload()
+{
+  // sendPhoto() waits for server reply and then close connection: header building (setformData)
+  // and data transfer to client are measured
+  static uint8_t image[2048];
+  uint32_t sent = 0;
+  Measure measure;
+  measure.begin();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    serverReply(SENT_REPLY);
+    sent += myBot.sendPhoto((int64_t)123456789, image, sizeof(image));
+    mock.clearRequests();
+  }
+  measure.end("sendPhoto 2KB (form-data)", ITERATIONS);
+  if (sent < ITERATIONS)
+    Serial.printf("    only %lu uploads of %u succeeded\n", (unsigned long)sent, ITERATIONS);
+  return sent == ITERATIONS;
+}
+
+int main()
+{
+  Serial.println("\nAsyncTelegramBot benchmark");
+
+  // Virtual clock: each update request is sent as soon as possible
+  myBot.setClock(MockClient::getTime);
+  myBot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  mock.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Bench\",\"username\":\"bench_bot\"}}");
+  if (!myBot.begin()) {
+    Serial.println("Bot initialization failed");
+    return 1;
+  }
+  Serial.printf("Bot buffers: %u bytes\n\n", (unsigned)botMemory.getUsed());
+
+  benchParse();
+  benchSend();
+  benchKeyboards();
+  const bool uploaded = benchUpload();
+  Serial.printf("\nConnections: %lu, requests: %lu\n", (unsigned long)mock.getConnectCount(),
+                (unsigned long)mock.getRequestCount());
+  return uploaded ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+/*
+  Name:        FaultInjection.cpp
+  Created:     18/10/2026
+  Description: resilience test of the bot, run on host (see extras/host/README.md).
+               A MockClient plays the role of Telegram server and a FaultClient between bot and server
+               injects short reads, stalled replies, write errors, drops in the middle of a reply and
+               failed connections. Everything runs in virtual time.
+               The test prints time-to-recover after faults, lost and duplicated updates, checks
+               that uploads return within the upload timeout when the reply never comes, measures
+               the recovery after a server outage (reconnection backoff) and checks that reconnections
+               work while DNS is failing (DNS cache and fallback IPs).
+*/
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <FaultClient.h>
+
+#define UPDATES           2000      // updates sent by users during the test
+#define UPDATE_INTERVAL   3000      // time between two updates (ms)
+#define LOOP_PERIOD       10        // time spent by the sketch between two calls of getNewMessage() (ms)
+#define STUCK_TIME        120000    // no update delivered for this time: bot is stuck
+#define REPLY_TIMEOUT     5000
+#define UPLOAD_TIME_OUT   15000
+#define OUTAGE_CONNECTS   12        // failed connections of the simulated outage
+#define OUTAGE_LIMIT      600000    // max time to recover from the outage
+#define DNS_LOOKUP_TIME   300       // time of a DNS lookup (ms)
+#define DNS_RECONNECTS    50        // reconnections for each DNS test
+#define RECONNECT_PERIOD  10000     // time between two reconnections (ms)
+
+MockClient server;
+FaultClient network(server);
+AsyncTelegramBot myBot(network);
+
+bool dnsDown = false;
+
+uint32_t arrival[UPDATES];
+uint8_t  delivered[UPDATES];        // times each update has been delivered to the sketch
+
+// Reply to bot requests as Telegram server does (one update for each getUpdates, honouring offset)
+void serverReply(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  char reply[320];
+  if (strstr(request, "/getUpdates ") != nullptr) {
+    const char *offset = strstr(request, "\"offset\":");
+    int32_t id = offset != nullptr ? atol(offset + 9) : 0;
+    if (id < 1)
+      id = 1;
+    if (id <= UPDATES && arrival[id - 1] <= MockClient::getTime()) {
+      snprintf(reply, sizeof(reply),
+               "{\"ok\":true,\"result\":[{\"update_id\":%ld,\"message\":{\"message_id\":%ld,"
+               "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+               "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"},"
+               "\"date\":1620000000,\"text\":\"update %ld\"}}]}",
+               (long)id, (long)id, (long)id);
+    }
+    else
+      snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":[]}");
+  }
+  else
+    snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":{\"message_id\":1}}");
+  client.addJsonReply(reply);
+}
+
+bool testPolling()
+{
+  const uint32_t start = MockClient::getTime();
+  for (uint16_t i = 0; i < UPDATES; i++) {
+    arrival[i] = start + (i + 1) * UPDATE_INTERVAL;
+    delivered[i] = 0;
+  }
+  const uint32_t end = arrival[UPDATES - 1] + STUCK_TIME;
+
+  static TBMessage msg;
+  uint32_t faults = network.getFaultCount();
+  uint32_t faultTime = 0;
+  bool recovering = false;
+  uint32_t recoveries = 0, recoveryTotal = 0, recoveryMax = 0;
+  uint32_t lastDelivery = start;
+  bool stuck = false;
+
+  while (MockClient::getTime() < end) {
+    if (network.getFaultCount() != faults) {
+      faults = network.getFaultCount();
+      faultTime = network.getLastFaultTime();
+      recovering = true;
+    }
+
+    if (myBot.getNewMessage(msg) == MessageText) {
+      uint32_t id = msg.messageID;
+      if (id >= 1 && id <= UPDATES) {
+        delivered[id - 1]++;
+        lastDelivery = MockClient::getTime();
+        if (recovering) {
+          // Time to deliver the first update after the fault
+          uint32_t from = arrival[id - 1] > faultTime ? arrival[id - 1] : faultTime;
+          uint32_t recovery = lastDelivery - from;
+          recoveries++;
+          recoveryTotal += recovery;
+          recoveryMax = recovery > recoveryMax ? recovery : recoveryMax;
+          recovering = false;
+        }
+        myBot.sendMessage(msg, "ok");
+      }
+    }
+
+    const uint32_t now = MockClient::getTime();
+    if (now - lastDelivery > STUCK_TIME && now < arrival[UPDATES - 1]) {
+      stuck = true;
+      break;
+    }
+    if (delivered[UPDATES - 1])
+      break;
+    server.clearRequests();
+    MockClient::advanceTime(LOOP_PERIOD);
+    yield();
+  }
+
+  uint16_t lost = 0, duplicated = 0;
+  for (uint16_t i = 0; i < UPDATES; i++) {
+    lost += delivered[i] == 0;
+    duplicated += delivered[i] > 1;
+  }
+
+  Serial.printf("Requests: %lu, connections: %lu, faults: %lu (short read %lu, stall %lu, write %lu, drop %lu, connect %lu)\n",
+                (unsigned long)network.getRequestCount(), (unsigned long)server.getConnectCount(),
+                (unsigned long)network.getFaultCount(), (unsigned long)network.getFaultCount(FaultShortRead),
+                (unsigned long)network.getFaultCount(FaultStall), (unsigned long)network.getFaultCount(FaultWriteError),
+                (unsigned long)network.getFaultCount(FaultDrop), (unsigned long)network.getFaultCount(FaultConnect));
+  Serial.printf("Time to recover: avg %lu ms, max %lu ms\n",
+                recoveries ? (unsigned long)(recoveryTotal / recoveries) : 0UL, (unsigned long)recoveryMax);
+  Serial.printf("Updates lost: %u, duplicated: %u%s\n", lost, duplicated, stuck ? ", bot STUCK" : "");
+
+  // What the bot has seen
+  const TBStats &stats = myBot.getStats();
+  for (const TBMethodStats &m : stats.methods) {
+    if (m.method)
+      Serial.printf("  %-14s %6lu calls %5lu errors  latency %lu/%lu/%lu ms\n", m.method, (unsigned long)m.calls,
+                    (unsigned long)m.errors, (unsigned long)m.latencyMin, (unsigned long)m.latencyAvg(),
+                    (unsigned long)m.latencyMax);
+  }
+  Serial.printf("  handshakes %lu, reconnects %lu, timeouts %lu, parse failures %lu\n",
+                (unsigned long)stats.handshakes, (unsigned long)stats.reconnects,
+                (unsigned long)stats.timeouts, (unsigned long)stats.parseFailures);
+#if TB_TRACE_ENABLE
+  // Where the time goes (library compiled with -DTB_TRACE_ENABLE=true)
+  myBot.getTrace().printTo(Serial, stats);
+#endif
+  return !stuck && lost == 0 && duplicated == 0;
+}
+
+// Upload must return (with an error) when reply doesn't come
+bool testUpload(FaultType fault, uint32_t param, bool expected)
+{
+  static uint8_t image[4096];
+  // Previous uploads failed: wait for the reconnection backoff
+  const TBHealth &health = myBot.getHealth();
+  if (health.consecutiveFailures && (int32_t)(health.retryTime - MockClient::getTime()) > 0)
+    MockClient::advanceTime(health.retryTime - MockClient::getTime());
+  if (fault != FaultNone)
+    network.addFault(network.getRequestCount() + 1, fault, param);
+  const uint32_t start = MockClient::getTime();
+  bool result = myBot.sendPhoto((int64_t)123456789, image, sizeof(image));
+  const uint32_t elapsed = MockClient::getTime() - start;
+  const bool pass = result == expected && elapsed <= UPLOAD_TIME_OUT + REPLY_TIMEOUT;
+  Serial.printf("Upload with fault %d: %s in %lu ms %s\n", (int)fault, result ? "sent" : "failed",
+                (unsigned long)elapsed, pass ? "" : "<- FAIL");
+  return pass;
+}
+
+// Server outage: connections fail until the server is back. With backoff, connection attempts
+// are spaced out (up to RECONNECT_MAX_DELAY) instead of a handshake on every poll
+bool testOutage()
+{
+  static TBMessage msg;
+  const TBStats &stats = myBot.getStats();
+  const TBHealth &health = myBot.getHealth();
+  const uint32_t failures = stats.connectFailures;
+  network.addFault(network.getRequestCount() + 1, FaultConnect, OUTAGE_CONNECTS);
+  const uint32_t start = MockClient::getTime();
+  bool outage = false;
+  while (MockClient::getTime() - start < OUTAGE_LIMIT) {
+    myBot.getNewMessage(msg);
+    outage |= health.consecutiveFailures > 0;
+    if (outage && health.consecutiveFailures == 0)
+      break;
+    server.clearRequests();
+    MockClient::advanceTime(LOOP_PERIOD);
+    yield();
+  }
+  const bool pass = outage && health.consecutiveFailures == 0;
+  Serial.printf("Outage: %lu failed connections, recovered in %lu ms (breaker opened %lu times) %s\n",
+                (unsigned long)(stats.connectFailures - failures), (unsigned long)health.lastRecovery,
+                (unsigned long)health.outages, pass ? "" : "<- FAIL");
+  return pass;
+}
+
+// Simulated DNS: a failing lookup lasts until timeout
+bool resolve(const char *host, IPAddress &ip, uint32_t timeout)
+{
+  (void)host;
+  MockClient::advanceTime(dnsDown ? timeout : DNS_LOOKUP_TIME);
+  if (dnsDown)
+    return false;
+  ip = IPAddress(149, 154, 167, 220);
+  return true;
+}
+
+// Reconnections use the cached server address (a lookup only when cache expires) and keep
+// working when DNS fails, with the last address or the fallback IPs
+bool testDns()
+{
+  const TBStats &stats = myBot.getStats();
+  bool pass = true;
+  myBot.setResolver(resolve);
+  for (uint8_t down = 0; down < 2; down++) {
+    dnsDown = down;
+    const uint32_t lookups = stats.dnsLookups;
+    const uint32_t lookupFailures = stats.dnsFailures;
+    const uint32_t handshakes = stats.handshakes;
+    const uint32_t lookupTime = stats.dnsTime;
+    // Cached address is discarded: DNS failure is handled with fallback IPs
+    myBot.setDnsCache(DNS_CACHE_TTL);
+    for (uint16_t i = 0; i < DNS_RECONNECTS; i++) {
+      myBot.reset();
+      MockClient::advanceTime(RECONNECT_PERIOD);
+    }
+    const uint32_t connected = stats.handshakes - handshakes;
+    pass &= connected == DNS_RECONNECTS;
+    Serial.printf("DNS %s: %lu/%d reconnections, %lu lookups (%lu failed) in %lu ms %s\n", down ? "down" : "up",
+                  (unsigned long)connected, DNS_RECONNECTS, (unsigned long)(stats.dnsLookups - lookups),
+                  (unsigned long)(stats.dnsFailures - lookupFailures), (unsigned long)(stats.dnsTime - lookupTime),
+                  connected == DNS_RECONNECTS ? "" : "<- FAIL");
+  }
+  dnsDown = false;
+  return pass;
+}
+
+int main()
+{
+  Serial.println("\nAsyncTelegramBot fault injection test");
+
+  myBot.setClock(MockClient::getTime);
+  network.setClock(MockClient::getTime, MockClient::advanceTime);
+  server.setLatency(100, 500);
+  myBot.setReplyTimeout(REPLY_TIMEOUT);
+  myBot.setUploadTimeout(UPLOAD_TIME_OUT);
+  myBot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  server.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Fault\",\"username\":\"fault_bot\"}}");
+  if (!myBot.begin()) {
+    Serial.println("Bot initialization failed");
+    return 1;
+  }
+  server.onRequest(serverReply);
+
+  // Random faults with fixed seed: the same run every time
+  network.setSeed(12345);
+  network.setFaultRate(FaultShortRead, 20, 7);
+  network.setFaultRate(FaultStall, 5, 30000);
+  network.setFaultRate(FaultWriteError, 5);
+  network.setFaultRate(FaultDrop, 5, 150);
+  network.setFaultRate(FaultConnect, 20);
+  bool pass = testPolling();
+
+  // No more random faults: only the scheduled ones
+  for (uint8_t fault = FaultShortRead; fault < FaultTypes; fault++)
+    network.setFaultRate((FaultType)fault, 0);
+  myBot.reset();
+  pass &= testUpload(FaultNone, 0, true);
+  pass &= testUpload(FaultShortRead, 3, true);
+  pass &= testUpload(FaultStall, 60000, false);
+  pass &= testUpload(FaultDrop, 100, false);
+  pass &= testUpload(FaultWriteError, 0, false);
+  pass &= testUpload(FaultNone, 0, true);
+  pass &= testOutage();
+  pass &= testDns();
+
+  Serial.println(pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/*
+  Name:        KeyPinning.cpp
+  Created:     18/10/2026
+  Description: public key pinning with fallback to certificate chain validation, run on host
+               (see extras/host/README.md).
+               A MockClient plays the role of a TLS server with a self-signed test key, and a PinnedClient
+               between bot and server verifies the server key against the pins: connections skip the
+               (slow) chain validation while the key is pinned. Then the server rotates its key: the
+               client refuses the connection, or falls back to chain validation if fallback is enabled.
+               An empty pin set matches no key. Connections and average handshake time of each phase
+               are printed on Serial, and the program fails if the connections of a phase are not
+               the expected ones.
+
+               On a real board, use the adapter of the TLS client and the pins of Telegram server
+               (see KeyPinning.h for the openssl command that prints them):
+                 ESP8266: BearSSLPinning pinning(client, certificate); pinning.addKey(telegramKey, keyLen);
+                 ESP32:   MbedTLSPinning pinning(client, telegram_cert);
+               and PinnedClient pinned(client, pinning, pins); AsyncTelegramBot myBot(pinned);
+               A local TLS stand-in is extras/fake_bot_api with --cert and --key: it prints the pin of its key.
+*/
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <KeyPinning.h>
+
+#define CONNECTIONS     100
+#define HANDSHAKE_TIME  400       // TLS handshake time, key exchange (ms)
+#define CHAIN_TIME      900       // certificate chain validation time (ms)
+
+// Public keys (SubjectPublicKeyInfo, DER) of two self-signed test keys (EC P-256):
+//   openssl ecparam -name prime256v1 -genkey -noout -out key.pem
+//   openssl ec -in key.pem -pubout -outform der -out key.der
+static const uint8_t testKey[] = {
+  0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02,
+  0x01, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03,
+  0x42, 0x00, 0x04, 0x5e, 0x8a, 0x51, 0x0c, 0x60, 0x74, 0x7c, 0xf6, 0x9c,
+  0xc0, 0x5e, 0xcf, 0x1f, 0x45, 0x1d, 0x04, 0x89, 0x71, 0x88, 0x9f, 0xc9,
+  0x9b, 0x3b, 0xb2, 0x0c, 0xca, 0xe1, 0x85, 0xaa, 0x6c, 0x67, 0x23, 0xe4,
+  0x71, 0xc5, 0xde, 0xba, 0xa7, 0x0e, 0x85, 0x8f, 0xd3, 0xec, 0x65, 0x42,
+  0xdc, 0x5d, 0x5a, 0x89, 0xa4, 0xd1, 0xc1, 0xde, 0xe0, 0x09, 0xd2, 0xd8,
+  0x32, 0x40, 0x7c, 0x74, 0x16, 0xb6, 0xae
+};
+static const uint8_t rotatedKey[] = {
+  0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02,
+  0x01, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03,
+  0x42, 0x00, 0x04, 0xc5, 0xcb, 0x79, 0x3f, 0xfb, 0xd9, 0x1a, 0x78, 0xf3,
+  0xc9, 0x79, 0x69, 0x0e, 0x50, 0x33, 0xcc, 0xaa, 0x07, 0xb8, 0xa5, 0x9f,
+  0xc8, 0x56, 0x68, 0x9f, 0x42, 0x74, 0x48, 0x50, 0xbb, 0x94, 0x45, 0xa8,
+  0x65, 0x39, 0xfd, 0x3f, 0xec, 0xd4, 0x92, 0xad, 0x76, 0x10, 0x81, 0xa3,
+  0x52, 0x07, 0x68, 0xd4, 0x4b, 0x1f, 0x3b, 0xb8, 0xca, 0xb0, 0xf7, 0xb4,
+  0x92, 0x6a, 0x8f, 0x31, 0x96, 0x8d, 0xb9
+};
+
+// Pins of the keys: openssl dgst -sha256 -binary key.der | base64
+const char *testPin = "sha256//1Me7obTnRaleR656TaEeTf8p5e3izsFzp88I5YtOL1U=";
+const char *rotatedPin = "sha256//6ntAHhNNJupwJDQLRKNx9Tq8nsxVzCB5sSgLRLjye10=";
+
+MockClient server;
+KeyPinSet pins;
+PinnedClient client(server, server, pins);
+AsyncTelegramBot myBot(client);
+
+// Run CONNECTIONS reconnections and compare connections made with expected ones
+bool runConnections(const char *phase, uint32_t expPinned, uint32_t expChain, uint32_t expFallbacks, uint32_t expFailed)
+{
+  const uint32_t pinned = client.getPinnedCount();
+  const uint32_t chain = client.getChainCount();
+  const uint32_t fallbacks = client.getFallbackCount();
+  myBot.resetStats();
+
+  for (uint16_t i = 0; i < CONNECTIONS; i++) {
+    // Connection refused: don't wait for the reconnection backoff in real time
+    if (!myBot.reset())
+      MockClient::advanceTime(RECONNECT_MAX_DELAY);
+  }
+
+  const TBStats &stats = myBot.getStats();
+  const bool pass = client.getPinnedCount() - pinned == expPinned && client.getChainCount() - chain == expChain &&
+                    client.getFallbackCount() - fallbacks == expFallbacks && stats.connectFailures == expFailed;
+  Serial.printf("%-28s | %6lu %6lu %6lu %6lu | %5lu ms%s\n", phase,
+                (unsigned long)(client.getPinnedCount() - pinned), (unsigned long)(client.getChainCount() - chain),
+                (unsigned long)(client.getFallbackCount() - fallbacks), (unsigned long)stats.connectFailures,
+                stats.handshakes ? (unsigned long)(stats.handshakeTime / stats.handshakes) : 0UL,
+                pass ? "" : "  FAIL");
+  return pass;
+}
+
+int main()
+{
+  Serial.println("\nAsyncTelegramBot public key pinning");
+
+  // The whole test runs in virtual time
+  myBot.setClock(MockClient::getTime);
+  server.setLatency(100, HANDSHAKE_TIME);
+  server.setCertificate(testKey, sizeof(testKey), CHAIN_TIME);
+  if (!pins.addPin(testPin)) {
+    Serial.println("Pin not valid");
+    return 1;
+  }
+
+  myBot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  server.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Pin\",\"username\":\"pin_bot\"}}");
+  if (!myBot.begin()) {
+    Serial.println("Bot initialization failed");
+    return 1;
+  }
+
+  Serial.printf("%d connections for each phase, handshake %d ms, chain validation %d ms\n\n",
+                CONNECTIONS, HANDSHAKE_TIME, CHAIN_TIME);
+  Serial.println("phase                        | pinned  chain fallbk failed | handshake");
+  bool pass = runConnections("key pinned", CONNECTIONS, 0, 0, 0);
+
+  // Fallback is disabled by default
+  server.setCertificate(rotatedKey, sizeof(rotatedKey), CHAIN_TIME);
+  pass &= runConnections("key rotated, no fallback", 0, 0, 0, CONNECTIONS);
+
+  // A fallback every PIN_RETRY_CONNECTS chain connections
+  const uint32_t fallbacks = (CONNECTIONS + PIN_RETRY_CONNECTS) / (PIN_RETRY_CONNECTS + 1);
+  client.setFallback(true);
+  pass &= runConnections("key rotated, fallback", 0, CONNECTIONS, fallbacks, 0);
+
+  // Pins are tried again when the connections left after the last fallback are done
+  const uint32_t chainLeft = PIN_RETRY_CONNECTS - (CONNECTIONS - 1) % (PIN_RETRY_CONNECTS + 1);
+  pins.addPin(rotatedPin);
+  pass &= runConnections("new key pinned", CONNECTIONS - chainLeft, chainLeft, 0, 0);
+
+  // An empty set matches no key
+  pins.clear();
+  pass &= runConnections("no pins, fallback", 0, CONNECTIONS, fallbacks, 0);
+  client.setFallback(false);
+  pass &= runConnections("no pins, no fallback", 0, 0, 0, CONNECTIONS);
+
+  Serial.println(pass ? "\nPASS" : "\nFAIL");
+  return pass ? 0 : 1;
+}
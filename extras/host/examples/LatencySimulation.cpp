@@ -0,0 +1,189 @@
+/*
+  Name:        LatencySimulation.cpp
+  Created:     18/10/2026
+  Description: simulate a day of bot traffic in virtual time, in order to tune polling settings
+               without a real device connected to Telegram server (runs on host, see extras/host/README.md).
+               The bot is connected to a MockClient that plays the role of the server: users messages
+               arrive at random times, each poll and reply costs a network round trip and a new
+               connection costs a TLS handshake (shorter if the TLS session is resumed). For each polling
+               interval the message-to-reply latency (p50, p99, max), the requests per hour, the handshakes
+               and the handshakes paid by messages of the sketch (replies and alerts sent at random times:
+               the critical path) and the system heap allocations (malloc and operator new) made
+               by the bot and the sketch for each request are printed on Serial. The longest interval
+               is run again without pre-warming of connections closed by server while idle.
+*/
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <HostHeap.h>
+
+#define SIM_HOURS           24        // Simulated time for each polling setting
+#define LOOP_PERIOD         20        // Time spent by the sketch between two calls of getNewMessage() (ms)
+#define MESSAGE_INTERVAL    60000     // Average time between two users messages (ms)
+#define NETWORK_RTT         150       // Round trip time (ms)
+#define HANDSHAKE_TIME      1200      // TLS handshake time (ms)
+#define RESUMED_HANDSHAKE   250       // Handshake time when TLS session is resumed (ms, 0 no resumption)
+#define SERVER_CLOSE_EVERY  100       // Server closes connection every N requests (0 never)
+#define SERVER_IDLE_CLOSE   4000      // Server closes connections idle for this time (ms, 0 never)
+#define ALERT_INTERVAL      600000    // Average time between two alerts sent by the sketch (ms)
+#define MAX_MESSAGES        4096
+
+const uint32_t pollingTimes[] = {250, 500, 1000, 2000, 5000};
+
+// Allocations of the simulated server are not counted
+MockClient mock;
+UncountedClient server(mock);
+AsyncTelegramBot myBot(server);
+
+// Simulated server state
+uint32_t arrival[MAX_MESSAGES];       // virtual time of each user message
+uint32_t latency[MAX_MESSAGES];       // message-to-reply latency (0 if not replied yet)
+uint16_t messageCount = 0;
+uint32_t serverRequests = 0;
+int32_t  firstUpdateId = 1;
+
+// Reply to bot requests as Telegram server does (requests are received after half RTT)
+void serverReply(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  const uint32_t now = MockClient::getTime() + NETWORK_RTT / 2;
+  const bool close = SERVER_CLOSE_EVERY && (++serverRequests % SERVER_CLOSE_EVERY == 0);
+  char reply[320];
+
+  if (strstr(request, "/getUpdates ") != nullptr) {
+    const char *offset = strstr(request, "\"offset\":");
+    int32_t updateId = offset != nullptr ? atol(offset + 9) : 0;
+    if (updateId < firstUpdateId)
+      updateId = firstUpdateId;
+    uint16_t msg = updateId - firstUpdateId;
+    // Only one update for each request (limit = 1)
+    if (msg < messageCount && arrival[msg] <= now) {
+      snprintf(reply, sizeof(reply),
+               "{\"ok\":true,\"result\":[{\"update_id\":%ld,\"message\":{\"message_id\":%u,"
+               "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+               "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"},"
+               "\"date\":1620000000,\"text\":\"msg %u\"}}]}",
+               (long)updateId, msg, msg);
+    }
+    else
+      snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":[]}");
+  }
+  else {
+    const char *text = strstr(request, "\"text\":\"reply ");
+    if (text != nullptr) {
+      uint16_t msg = atoi(text + 14);
+      if (msg < messageCount && latency[msg] == 0)
+        latency[msg] = now - arrival[msg];
+    }
+    snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":{\"message_id\":1}}");
+  }
+  client.addJsonReply(reply, 200, close);
+}
+
+int compareLatency(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+void simulate(uint32_t pollingTime, bool prewarm)
+{
+  const uint32_t duration = SIM_HOURS * 3600000UL;
+  const uint32_t start = MockClient::getTime();
+
+  // Users messages: exponential distribution of intervals
+  randomSeed(1);
+  messageCount = 0;
+  for (uint32_t t = start; messageCount < MAX_MESSAGES; messageCount++) {
+    float u = random(1, 10000) / 10000.0;
+    t += (uint32_t)(-log(u) * MESSAGE_INTERVAL);
+    if (t - start > duration)
+      break;
+    arrival[messageCount] = t;
+    latency[messageCount] = 0;
+  }
+
+  myBot.setUpdateTime(pollingTime);
+  myBot.setPrewarm(prewarm);
+  myBot.reset();
+  const uint32_t requests = mock.getRequestCount();
+  const uint32_t handshakes = mock.getConnectCount();
+  const uint32_t critical = myBot.getStats().criticalHandshakes;
+  const uint32_t mallocs = HostHeap::getAllocations();
+  const uint32_t realTime = millis();
+
+  static TBMessage msg;
+  uint32_t nextAlert = start + random(ALERT_INTERVAL);
+  while (MockClient::getTime() - start < duration) {
+    if (myBot.getNewMessage(msg) == MessageText) {
+      char reply[32];
+      snprintf(reply, sizeof(reply), "reply %s", msg.text.c_str() + 4);
+      myBot.sendMessage(msg, reply);
+    }
+    // Alert of the sketch (ex. a sensor), not triggered by users
+    else if ((int32_t)(MockClient::getTime() - nextAlert) >= 0 && myBot.getStats().pendingReplies == 0) {
+      myBot.sendTo((int64_t)123456789, "alert");
+      nextAlert += ALERT_INTERVAL / 2 + random(ALERT_INTERVAL);
+    }
+    // Requests are not needed, don't let them grow for a whole day
+    mock.clearRequests();
+    MockClient::advanceTime(LOOP_PERIOD);
+  }
+  const uint32_t runMallocs = HostHeap::getAllocations() - mallocs;
+  const uint32_t runRequests = mock.getRequestCount() - requests;
+  // Next run starts with new update IDs
+  firstUpdateId += messageCount;
+
+  // Latency percentiles of replied messages
+  uint16_t replied = 0;
+  for (uint16_t i = 0; i < messageCount; i++)
+    if (latency[i])
+      latency[replied++] = latency[i];
+  qsort(latency, replied, sizeof(uint32_t), compareLatency);
+
+  const float hours = duration / 3600000.0;
+  Serial.printf("%6lu ms%s | %5u/%-5u | %6lu %6lu %6lu ms | %8.0f req/h | %6lu handshakes | %5lu | %10.2f | %lu ms\n",
+                (unsigned long)pollingTime, prewarm ? " " : "*", replied, messageCount,
+                replied ? (unsigned long)latency[replied / 2] : 0UL,
+                replied ? (unsigned long)latency[replied * 99 / 100] : 0UL,
+                replied ? (unsigned long)latency[replied - 1] : 0UL,
+                runRequests / hours,
+                (unsigned long)(mock.getConnectCount() - handshakes),
+                (unsigned long)(myBot.getStats().criticalHandshakes - critical),
+                runRequests ? (float)runMallocs / runRequests : 0.0f,
+                (unsigned long)(millis() - realTime));
+}
+
+int main()
+{
+  Serial.println("\nAsyncTelegramBot latency simulation");
+
+  // The whole simulation runs in virtual time
+  myBot.setClock(MockClient::getTime);
+  mock.setLatency(NETWORK_RTT, HANDSHAKE_TIME, RESUMED_HANDSHAKE);
+  mock.setIdleClose(SERVER_IDLE_CLOSE);
+  myBot.setTLSSession(&mock);
+  mock.onRequest(serverReply);
+  myBot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  mock.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Sim\",\"username\":\"sim_bot\"}}");
+  if (!myBot.begin()) {
+    Serial.println("Bot initialization failed");
+    return 1;
+  }
+
+  Serial.printf("%d hours, RTT %d ms, handshake %d ms, a message every %d ms\n\n",
+                SIM_HOURS, NETWORK_RTT, HANDSHAKE_TIME, MESSAGE_INTERVAL);
+  Serial.println("polling    | replied     |    p50    p99    max    | requests     | connections       | crit. | malloc/req | real time");
+  for (uint32_t pollingTime : pollingTimes)
+    simulate(pollingTime, true);
+  // Same traffic, without pre-warming (marked with *)
+  simulate(pollingTimes[sizeof(pollingTimes) / sizeof(pollingTimes[0]) - 1], false);
+
+  const TBStats &stats = myBot.getStats();
+  Serial.printf("\n%lu handshakes (%lu resumed): full %lu ms, resumed %lu ms on average\n",
+                (unsigned long)stats.handshakes, (unsigned long)stats.resumedHandshakes,
+                (unsigned long)stats.fullHandshakeAvg(), (unsigned long)stats.resumedHandshakeAvg());
+  Serial.printf("%lu connections pre-warmed, server idle timeout estimated %lu ms\n",
+                (unsigned long)stats.prewarms, (unsigned long)stats.idleClose);
+  return 0;
+}
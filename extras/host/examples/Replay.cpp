@@ -0,0 +1,144 @@
+/*
+  Name:        Replay.cpp
+  Created:     18/10/2026
+  Description: replay on host a capture made on a board with RecordingClient
+               (see examples/advanced/RecordReplay): the bot receives again the same replies, without
+               network, and the updates are printed. Useful as benchmark corpus or to reproduce a bug.
+                 Replay capture.bin
+               Without arguments, a session with a MockClient (network delays, a failed connection and
+               connections closed by the server) is recorded to replay_capture.bin and replayed: the test
+               fails if the replayed bot doesn't see the same updates, at the same virtual time.
+*/
+
+#include <AsyncTelegramBot.h>
+#include <ReplayClient.h>
+#include <FS.h>
+
+#define CAPTURE_FILE  "replay_capture.bin"
+#define UPDATES       20
+
+static unsigned long sessionStart = 0;    // virtual time of begin()
+static const char *token = "123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr";
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Replay\",\"username\":\"replay_bot\"}}";
+
+// Poll the bot as the sketch of the recorded session (echo bot), until messages are received
+// (replay: until recorded replies are consumed, or a request is not in capture).
+// Text and virtual time of received messages are appended to log
+static void runEcho(AsyncTelegramBot &bot, String &log, uint16_t messages, ReplayClient *replay = nullptr)
+{
+  static TBMessage msg;
+  uint16_t received = 0;
+  while (replay != nullptr ? replay->remainingReplies() && !replay->getUnmatchedRequests() : received < messages) {
+    MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+    const MessageType type = bot.getNewMessage(msg);
+    if (type == MessageNoData)
+      continue;
+    received++;
+    Serial.printf("Update type %d from %lld: %s\n", (int)type, (long long)msg.sender.id, msg.text.c_str());
+    log += msg.text;
+    log += " at ";
+    log += MockClient::getTime() - sessionStart;
+    log += "\n";
+    bot.sendMessage(msg, msg.text);
+  }
+}
+
+// Server of the recorded session: UPDATES text messages, one for each getUpdates.
+// Every fifth update, the connection is closed after the reply
+static void serverReply(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  static uint16_t sent = 0;
+  char reply[320];
+  if (strstr(request, "/getUpdates ") != nullptr && sent < UPDATES) {
+    sent++;
+    snprintf(reply, sizeof(reply),
+             "{\"ok\":true,\"result\":[{\"update_id\":%u,\"message\":{\"message_id\":%u,"
+             "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+             "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"},"
+             "\"date\":1620000000,\"text\":\"message %u\"}}]}",
+             sent, sent, sent);
+  }
+  else if (strstr(request, "/getUpdates ") != nullptr)
+    snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":[]}");
+  else
+    snprintf(reply, sizeof(reply), "{\"ok\":true,\"result\":{\"message_id\":1}}");
+  client.addJsonReply(reply, 200, strstr(request, "/getUpdates ") != nullptr && sent % 5 == 0);
+}
+
+static bool record(String &log)
+{
+  static TBMessage msg;
+  File capture = HostFS.open(CAPTURE_FILE, "w");
+  if (!capture)
+    return false;
+  MockClient server;
+  RecordingClient recorder(server, &capture);
+  recorder.setClock(MockClient::getTime);
+  AsyncTelegramBot bot(recorder);
+  bot.setClock(MockClient::getTime);
+  bot.setTelegramToken(token);
+  server.setLatency(120, 400);
+  sessionStart = MockClient::getTime();
+  server.addJsonReply(getMeReply);
+  server.onRequest(serverReply);
+  if (!bot.begin())
+    return false;
+  // A connection refused: reconnection after the backoff delay
+  server.disconnect();
+  server.failConnect(1);
+  runEcho(bot, log, UPDATES);
+  // Reply to the last message
+  MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+  bot.getNewMessage(msg);
+  recorder.flushCapture();
+  Serial.printf("Recorded %lu bytes\n", (unsigned long)recorder.getCaptureSize());
+  return true;
+}
+
+static bool replay(File &capture, String &log)
+{
+  ReplayClient client;
+  // Delays of replies are recorded, handshake time is the same of recorded session
+  client.setLatency(0, 400);
+  const size_t replies = client.load(capture);
+  Serial.printf("Capture: %u replies, %lu requests, %lu connections\n", (unsigned)replies,
+                (unsigned long)client.getRecordedRequests(), (unsigned long)client.getRecordedConnections());
+  if (replies == 0)
+    return false;
+  // Virtual time: no wait between requests
+  AsyncTelegramBot bot(client);
+  bot.setClock(MockClient::getTime);
+  bot.setTelegramToken(token);
+  sessionStart = MockClient::getTime();
+  if (!bot.begin())
+    return false;
+  runEcho(bot, log, 0, &client);
+  Serial.printf("Replay completed: %u requests not in capture, %u replies not requested\n",
+                (unsigned)client.getUnmatchedRequests(), (unsigned)client.remainingReplies());
+  return client.getUnmatchedRequests() == 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc > 1) {
+    File capture(fopen(argv[1], "rb"), argv[1]);
+    if (!capture) {
+      Serial.printf("Capture %s not found\n", argv[1]);
+      return 1;
+    }
+    String log;
+    return replay(capture, log) ? 0 : 1;
+  }
+
+  String recorded, replayed;
+  if (!record(recorded)) {
+    Serial.println("Recording failed");
+    return 1;
+  }
+  File capture = HostFS.open(CAPTURE_FILE, "r");
+  const bool pass = replay(capture, replayed) && recorded.length() && replayed == recorded;
+  Serial.println(pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
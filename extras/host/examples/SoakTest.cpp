@@ -0,0 +1,196 @@
+/*
+  Name:        SoakTest.cpp
+  Created:     18/10/2026
+  Description: long run of poll/parse/send/keyboard cycles, in order to find heap fragmentation
+               before it shows up after days of uptime.
+               Bot buffers and keyboards use an ArenaAllocator (first-fit, sized like the free heap
+               of an ESP8266) and the bot is connected to a MockClient: the test runs on host
+               (see extras/host/README.md).
+               Free memory, largest free block and allocations are sampled during the run: the test
+               fails if the largest free block trends down, if an allocation fails or if memory is
+               not released at the end.
+               String objects (ex. TBMessage::text), keyboard objects and the MockClient buffers use
+               the system heap, counted with HostHeap: the test fails also if it grows after the first
+               sample.
+               With the library compiled with -DTB_HEAP_SCOPE_ENABLE=true, heap usage of each library
+               function is printed at the end.
+*/
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <HostHeap.h>
+
+#define ARENA_SIZE        (40 * 1024)   // ESP8266 free heap with WiFi connected
+#define SOAK_CYCLES       200000
+#define SAMPLES           100
+#define LIVE_KEYBOARDS    4             // keyboards alive at the same time, with random lifetime
+#define TREND_LIMIT       64            // max decrease of largest free block over the run (bytes)
+#define SYSTEM_LEAK_LIMIT 0             // max growth of system heap after the first sample (bytes)
+
+ArenaAllocator arena(ARENA_SIZE);
+TrackingAllocator heap(arena);      // peak usage of library functions (see TBHeapScope)
+MockClient mock;
+AsyncTelegramBotDynamic myBot(mock, heap);
+InlineKeyboard *keyboards[LIVE_KEYBOARDS];
+
+#define FROM  "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\",\"username\":\"johndoe\"}"
+#define CHAT  "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"}"
+#define MSG   "\"message_id\":1234," FROM "," CHAT ",\"date\":1620000000"
+
+const char *updates[] = {
+  "{\"ok\":true,\"result\":[{\"update_id\":%lu,\"message\":{" MSG ",\"text\":\"/status %lu\"}}]}",
+  "{\"ok\":true,\"result\":[{\"update_id\":%lu,\"callback_query\":{\"id\":\"4382bfdwdsb323b2d9\"," FROM
+  ",\"message\":{" MSG ",\"text\":\"Choose\"},\"chat_instance\":\"-7654321987654321\",\"data\":\"BTN_%lu\"}}]}",
+  "{\"ok\":true,\"result\":[]}",
+};
+
+struct Sample {
+  uint32_t cycle;
+  uint32_t free;
+  uint32_t largest;
+  uint32_t blocks;
+  uint32_t allocations;
+  uint32_t system;      // bytes of system heap
+};
+Sample samples[SAMPLES];
+
+char nextUpdate[512];           // reply to next getUpdates (empty result when already sent)
+uint32_t texts = 0, queries = 0;
+
+// Server: getUpdates gets the update of current cycle, the other methods a message or true
+void serverReply(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  if (strstr(request, "/getUpdates ") != nullptr) {
+    client.addJsonReply(nextUpdate[0] ? nextUpdate : "{\"ok\":true,\"result\":[]}");
+    nextUpdate[0] = '\0';
+  }
+  else if (strstr(request, "/answerCallbackQuery ") != nullptr)
+    client.addJsonReply("{\"ok\":true,\"result\":true}");
+  else
+    client.addJsonReply("{\"ok\":true,\"result\":{\"message_id\":1}}");
+}
+
+// New keyboard with a random number of buttons (the JSON buffer is grown while adding buttons)
+InlineKeyboard *newKeyboard()
+{
+  InlineKeyboard *kbd = new InlineKeyboard(heap);
+  uint8_t buttons = random(1, 13);
+  for (uint8_t i = 0; i < buttons; i++) {
+    char label[16];
+    snprintf(label, sizeof(label), "BTN_%u", i);
+    if (i % 3 == 0)
+      kbd->addRow();
+    kbd->addButton(label, label, i % 4 ? KeyboardButtonQuery : KeyboardButtonURL);
+  }
+  return kbd;
+}
+
+void cycle(uint32_t n)
+{
+  static TBMessage msg;
+  snprintf(nextUpdate, sizeof(nextUpdate), updates[n % 3], (unsigned long)n + 1, (unsigned long)n);
+  // The reply to the message sent in previous cycle (non-blocking send) is read first
+  MessageType type = MessageNoData;
+  for (uint8_t i = 0; i < 3 && type == MessageNoData && nextUpdate[0]; i++) {
+    MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+    type = myBot.getNewMessage(msg);
+  }
+
+  switch (type) {
+    case MessageText: {
+      texts++;
+      // Replace a keyboard: lifetimes of blocks are mixed, as in a real application
+      uint8_t k = random(LIVE_KEYBOARDS);
+      delete keyboards[k];
+      keyboards[k] = newKeyboard();
+      myBot.sendMessage(msg, msg.text.c_str(), *keyboards[k]);
+      break;
+    }
+    case MessageQuery:
+      queries++;
+      // endQuery() waits for the reply
+      myBot.endQuery(msg, "OK");
+      myBot.editMessage(msg, "Updated", *keyboards[n % LIVE_KEYBOARDS]);
+      break;
+    default:
+      break;
+  }
+  mock.clearRequests();
+}
+
+int main()
+{
+  Serial.println("\nAsyncTelegramBot soak test");
+
+  myBot.setClock(MockClient::getTime);
+#if TB_HEAP_SCOPE_ENABLE
+  TBHeapScope::setAllocator(&heap, arena.getSize(), &arena);
+#endif
+  myBot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  mock.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Soak\",\"username\":\"soak_bot\"}}");
+  mock.onRequest(serverReply);
+  if (!myBot.begin()) {
+    Serial.println("Bot initialization failed");
+    return 1;
+  }
+  const uint32_t baseFree = arena.getFreeHeap();
+  const uint32_t baseBlocks = arena.getBlocks();
+  Serial.printf("Arena %u bytes, free after begin() %lu bytes\n", (unsigned)arena.getSize(), (unsigned long)baseFree);
+
+  randomSeed(1);
+  for (uint8_t k = 0; k < LIVE_KEYBOARDS; k++)
+    keyboards[k] = newKeyboard();
+
+  Serial.println("   cycle      free   largest   blocks   allocations    system");
+  const uint32_t period = SOAK_CYCLES / SAMPLES;
+  for (uint32_t n = 0; n < SOAK_CYCLES; n++) {
+    cycle(n);
+    if ((n + 1) % period == 0) {
+      Sample &s = samples[n / period];
+      s = {n + 1, (uint32_t)arena.getFreeHeap(), (uint32_t)arena.getLargestFreeBlock(), arena.getBlocks(),
+           arena.getAllocations(), (uint32_t)HostHeap::getUsed()};
+      if ((n / period) % 10 == 0 || n + 1 == SOAK_CYCLES)
+        Serial.printf("%8lu  %8lu  %8lu  %7lu  %12lu  %8lu\n", (unsigned long)s.cycle, (unsigned long)s.free,
+                      (unsigned long)s.largest, (unsigned long)s.blocks, (unsigned long)s.allocations,
+                      (unsigned long)s.system);
+    }
+    yield();
+  }
+
+  // Linear trend of largest free block (least squares), warm-up sample excluded
+  float sx = 0, sy = 0, sxx = 0, sxy = 0;
+  const uint16_t count = SAMPLES - 1;
+  for (uint16_t i = 1; i < SAMPLES; i++) {
+    sx += i;
+    sy += samples[i].largest;
+    sxx += (float)i * i;
+    sxy += (float)i * samples[i].largest;
+  }
+  const float slope = (count * sxy - sx * sy) / (count * sxx - sx * sx);
+  const float trend = slope * (SAMPLES - 2);
+  // Same objects are alive in both samples
+  const long systemGrowth = (long)samples[SAMPLES - 1].system - (long)samples[0].system;
+
+  for (uint8_t k = 0; k < LIVE_KEYBOARDS; k++) {
+    delete keyboards[k];
+    keyboards[k] = nullptr;
+  }
+  const bool leak = arena.getFreeHeap() != baseFree || arena.getBlocks() != baseBlocks;
+
+  // Every cycle has handled its update (text, query or none)
+  const bool handled = texts == (SOAK_CYCLES + 2) / 3 && queries == (SOAK_CYCLES + 1) / 3;
+
+  Serial.printf("\nMessages handled: %lu text, %lu queries\n", (unsigned long)texts, (unsigned long)queries);
+  Serial.printf("Largest free block trend: %+.0f bytes over the run\n", trend);
+  Serial.printf("Failed allocations: %lu\n", (unsigned long)arena.getFailures());
+  Serial.printf("Memory released at the end: %s\n", leak ? "NO" : "yes");
+  Serial.printf("System heap growth: %+ld bytes\n", systemGrowth);
+#if TB_HEAP_SCOPE_ENABLE
+  Serial.println();
+  TBHeapScope::printTo(Serial);
+#endif
+  const bool pass = handled && trend > -TREND_LIMIT && arena.getFailures() == 0 && !leak && systemGrowth <= SYSTEM_LEAK_LIMIT;
+  Serial.println(pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
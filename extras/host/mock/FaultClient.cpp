@@ -0,0 +1,196 @@
+#include "FaultClient.h"
+
+bool FaultClient::addFault(uint32_t request, FaultType fault, uint32_t param)
+{
+  if (m_scheduled >= MAX_SCHEDULED_FAULTS)
+    return false;
+  m_schedule[m_scheduled++] = {request, fault, param};
+  return true;
+}
+
+void FaultClient::setFaultRate(FaultType fault, uint16_t permille, uint32_t param)
+{
+  if (fault <= FaultNone || fault >= FaultTypes)
+    return;
+  m_rate[fault] = permille;
+  m_rateParam[fault] = param;
+}
+
+uint32_t FaultClient::getFaultCount(FaultType fault) const
+{
+  if (fault > FaultNone && fault < FaultTypes)
+    return m_counters[fault];
+  uint32_t count = 0;
+  for (uint8_t i = FaultNone + 1; i < FaultTypes; i++)
+    count += m_counters[i];
+  return count;
+}
+
+// xorshift32: same sequence of faults on every platform
+uint32_t FaultClient::random()
+{
+  m_seed ^= m_seed << 13;
+  m_seed ^= m_seed >> 17;
+  m_seed ^= m_seed << 5;
+  return m_seed;
+}
+
+void FaultClient::inject(FaultType fault, uint32_t param)
+{
+  m_fault = fault;
+  m_counters[fault]++;
+  m_lastFaultTime = now();
+  switch (fault) {
+    case FaultShortRead:
+      m_param = param ? param : 1;
+      break;
+    case FaultStall:
+      m_param = m_lastFaultTime + param;
+      break;
+    case FaultDrop:
+      m_param = param ? param : 200;
+      break;
+    case FaultConnect:
+      // Connection is lost and next connection attempts fail
+      m_param = param ? param : 1;
+      m_client.stop();
+      break;
+    default:
+      m_param = param;
+      break;
+  }
+}
+
+void FaultClient::startRequest()
+{
+  m_requestStarted = true;
+  m_requestCount++;
+  m_fault = FaultNone;
+  m_received = 0;
+
+  for (uint8_t i = 0; i < m_scheduled; i++) {
+    if (m_schedule[i].request == m_requestCount) {
+      inject(m_schedule[i].fault, m_schedule[i].param);
+      m_schedule[i] = m_schedule[--m_scheduled];
+      return;
+    }
+  }
+  // Connection faults are drawn when connecting
+  for (uint8_t fault = FaultNone + 1; fault < FaultConnect; fault++) {
+    if (m_rate[fault] && random() % 1000 < m_rate[fault]) {
+      inject((FaultType)fault, m_rateParam[fault]);
+      return;
+    }
+  }
+}
+
+bool FaultClient::stalled()
+{
+  if (m_fault != FaultStall || (int32_t)(now() - m_param) >= 0)
+    return false;
+  // Waiting for reply: time is running
+  if (m_advance != nullptr)
+    m_advance(1);
+  return true;
+}
+
+int FaultClient::readable(size_t size)
+{
+  if (m_fault == FaultDrop && m_received >= m_param) {
+    m_client.stop();
+    return -1;
+  }
+  if (stalled())
+    return 0;
+  int n = m_client.available();
+  if (n <= 0)
+    return n;
+  if ((size_t)n > size)
+    n = size;
+  if (m_fault == FaultShortRead && (uint32_t)n > m_param)
+    n = m_param;
+  if (m_fault == FaultDrop && (uint32_t)n > m_param - m_received)
+    n = m_param - m_received;
+  return n;
+}
+
+bool FaultClient::connectFault()
+{
+  m_requestStarted = false;
+  if (m_fault == FaultConnect && m_param) {
+    m_param--;
+    return true;
+  }
+  if (m_rate[FaultConnect] && random() % 1000 < m_rate[FaultConnect]) {
+    m_counters[FaultConnect]++;
+    m_lastFaultTime = now();
+    return true;
+  }
+  // Faults of previous request were on the old connection (ex. a drop would close the new one)
+  m_fault = FaultNone;
+  m_received = 0;
+  return false;
+}
+
+int FaultClient::connect(IPAddress ip, uint16_t port)
+{
+  return connectFault() ? 0 : m_client.connect(ip, port);
+}
+
+int FaultClient::connect(const char *host, uint16_t port)
+{
+  return connectFault() ? 0 : m_client.connect(host, port);
+}
+
+size_t FaultClient::write(const uint8_t *buf, size_t size)
+{
+  // First write after the previous reply: this is a new request
+  if (!m_requestStarted)
+    startRequest();
+  if (m_fault == FaultWriteError || m_fault == FaultConnect)
+    return 0;
+  return m_client.write(buf, size);
+}
+
+int FaultClient::available()
+{
+  int n = readable(INT16_MAX);
+  return n > 0 ? n : 0;
+}
+
+int FaultClient::read()
+{
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int FaultClient::read(uint8_t *buf, size_t size)
+{
+  int n = readable(size);
+  if (n <= 0)
+    return -1;
+  n = m_client.read(buf, n);
+  if (n > 0) {
+    m_received += n;
+    m_requestStarted = false;
+  }
+  return n;
+}
+
+int FaultClient::peek()
+{
+  return readable(1) > 0 ? m_client.peek() : -1;
+}
+
+void FaultClient::stop()
+{
+  m_requestStarted = false;
+  m_client.stop();
+}
+
+uint8_t FaultClient::connected()
+{
+  if (m_fault == FaultDrop && m_received >= m_param)
+    m_client.stop();
+  return m_client.connected();
+}
@@ -0,0 +1,114 @@
+
+#ifndef FAULT_CLIENT
+#define FAULT_CLIENT
+
+#include <Arduino.h>
+#include "Client.h"
+
+#define MAX_SCHEDULED_FAULTS  16
+
+enum FaultType {
+  FaultNone,
+  FaultShortRead,     // reply is read in small pieces (param: max bytes for each read, default 1)
+  FaultStall,         // reply is delayed (param: delay in ms)
+  FaultWriteError,    // request can't be written (write() returns 0)
+  FaultDrop,          // connection drops in the middle of reply (param: bytes received before drop)
+  FaultConnect,       // connection attempt fails
+  FaultTypes
+};
+
+// Client decorator that injects network faults in the traffic of the wrapped client,
+// on a schedule (n-th request) or at random with a fixed seed, so runs can be repeated.
+// Use it to check that the bot recovers from faults and how much time it takes
+class FaultClient : public Client
+{
+public:
+  using ClockFunction = unsigned long (*)(void);
+  using AdvanceFunction = void (*)(uint32_t);
+
+  FaultClient(Client &client) : m_client(client) {}
+
+  // inject a fault in the request number request (counted from 1, see getRequestCount())
+  // returns
+  //   false if schedule is full
+  bool addFault(uint32_t request, FaultType fault, uint32_t param = 0);
+
+  // inject a fault at random in permille of the requests
+  void setFaultRate(FaultType fault, uint16_t permille, uint32_t param = 0);
+
+  // seed of random faults
+  inline void setSeed(uint32_t seed) { m_seed = seed ? seed : 1; }
+
+  // time source used for stalls (default millis). With a virtual clock (ex. MockClient::getTime),
+  // advance is called while the bot waits a stalled reply
+  inline void setClock(ClockFunction clock, AdvanceFunction advance = nullptr) {
+    m_clock = clock;
+    m_advance = advance;
+  }
+
+  // requests written by the bot
+  inline uint32_t getRequestCount() const { return m_requestCount; }
+
+  // faults injected (all types or only one type)
+  uint32_t getFaultCount(FaultType fault = FaultNone) const;
+
+  // fault applied to the current request and time of last fault
+  inline FaultType getCurrentFault() const { return m_fault; }
+  inline unsigned long getLastFaultTime() const { return m_lastFaultTime; }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override { return connectFault() ? 0 : m_client.connect(ip, port, timeout); }
+  int connect(const char *host, uint16_t port, int32_t timeout) override { return connectFault() ? 0 : m_client.connect(host, port, timeout); }
+#endif
+  size_t write(uint8_t data) override { return write(&data, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override { m_client.flush(); }
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return m_client; }
+
+private:
+  struct ScheduledFault {
+    uint32_t  request;
+    FaultType fault;
+    uint32_t  param;
+  };
+
+  Client          &m_client;
+  ClockFunction   m_clock = nullptr;
+  AdvanceFunction m_advance = nullptr;
+  ScheduledFault  m_schedule[MAX_SCHEDULED_FAULTS];
+  uint8_t         m_scheduled = 0;
+  uint16_t        m_rate[FaultTypes] = {0};
+  uint32_t        m_rateParam[FaultTypes] = {0};
+  uint32_t        m_counters[FaultTypes] = {0};
+  uint32_t        m_seed = 1;
+  uint32_t        m_requestCount = 0;
+  bool            m_requestStarted = false;
+  bool            m_connectFault = false;
+
+  // fault of current request
+  FaultType       m_fault = FaultNone;
+  uint32_t        m_param = 0;
+  uint32_t        m_received = 0;       // bytes of current reply
+  unsigned long   m_lastFaultTime = 0;
+
+  inline unsigned long now() { return m_clock != nullptr ? m_clock() : millis(); }
+  uint32_t random(void);
+  void startRequest(void);
+  void inject(FaultType fault, uint32_t param);
+  // true if this connection attempt must fail
+  bool connectFault(void);
+  // true while a stalled reply must not be readable
+  bool stalled(void);
+  // bytes that can be read now (-1 if connection dropped)
+  int readable(size_t size);
+};
+
+#endif
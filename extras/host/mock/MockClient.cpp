@@ -0,0 +1,149 @@
+#include "MockClient.h"
+
+unsigned long MockClient::s_time = 0;
+
+void MockClient::addReply(const char *raw)
+{
+  addReply((const uint8_t *)raw, strlen(raw));
+}
+
+void MockClient::addReply(const uint8_t *raw, size_t len, int32_t delay, bool close)
+{
+  m_replies.push_back(Reply{std::string((const char *)raw, len), delay, close});
+}
+
+void MockClient::addJsonReply(const char *body, int status, bool close)
+{
+  char header[160];
+  snprintf(header, sizeof(header),
+           "HTTP/1.1 %d %s\r\nServer: nginx/1.18.0\r\nContent-Type: application/json\r\n"
+           "Content-Length: %u\r\nConnection: %s\r\n\r\n",
+           status, status == 200 ? "OK" : "Error", (unsigned)strlen(body), close ? "close" : "keep-alive");
+  std::string reply(header);
+  reply += body;
+  addReply((const uint8_t *)reply.data(), reply.size());
+}
+
+void MockClient::disconnect()
+{
+  m_connected = false;
+  m_rx.clear();
+  m_rxPos = 0;
+}
+
+int MockClient::connect(IPAddress ip, uint16_t port)
+{
+  (void)ip;
+  return connect("", port);
+}
+
+int MockClient::connect(const char *host, uint16_t port)
+{
+  (void)host;
+  (void)port;
+  if (m_failConnect) {
+    m_failConnect--;
+    return 0;
+  }
+  disconnect();
+  m_resumed = m_resumedHandshake && m_sessionSaved;
+  s_time += m_resumed ? m_resumedHandshake : m_handshake + (m_checkChain ? m_chainTime : 0);
+  m_sessionSaved = true;
+  m_lastTraffic = s_time;
+  m_connected = true;
+  m_closeAfterReply = false;
+  m_requestStarted = false;
+  m_connectCount++;
+  return 1;
+}
+
+size_t MockClient::write(const uint8_t *buf, size_t size)
+{
+  if (!connected())
+    return 0;
+  m_tx.append((const char *)buf, size);
+  m_lastTraffic = s_time;
+
+  // First write after the previous reply: this is a new request
+  if (!m_requestStarted) {
+    m_requestStarted = true;
+    m_requestCount++;
+    if (m_replies.empty() && m_onRequest != nullptr)
+      m_onRequest(*this, (const char *)buf, size);
+    if (m_rxPos >= m_rx.size() && !m_replies.empty()) {
+      const Reply &reply = m_replies.front();
+      m_rx = reply.data;
+      m_rxPos = 0;
+      m_replyTime = s_time + (reply.delay >= 0 ? reply.delay : m_rtt);
+      size_t headerEnd = m_rx.find("\r\n\r\n");
+      m_closeAfterReply = reply.close || m_rx.substr(0, headerEnd).find("Connection: close") != std::string::npos;
+      m_replies.pop_front();
+    }
+  }
+  return size;
+}
+
+bool MockClient::inFlight()
+{
+  return m_rxPos < m_rx.size() && (int32_t)(s_time - m_replyTime) < 0;
+}
+
+int MockClient::available()
+{
+  if (!m_connected)
+    return 0;
+  // Polling for data: time is running (also when no reply is queued, so timeouts expire)
+  if (inFlight() || (m_requestStarted && m_rxPos >= m_rx.size())) {
+    s_time++;
+    return 0;
+  }
+  return m_rx.size() - m_rxPos;
+}
+
+int MockClient::read()
+{
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int MockClient::read(uint8_t *buf, size_t size)
+{
+  // Blocking read: wait for reply
+  if (m_connected && inFlight())
+    s_time = m_replyTime;
+  int n = available();
+  if (n <= 0)
+    return -1;
+  if (size < (size_t)n)
+    n = size;
+  memcpy(buf, m_rx.data() + m_rxPos, n);
+  m_rxPos += n;
+  m_lastTraffic = s_time;
+  m_requestStarted = false;
+  return n;
+}
+
+int MockClient::peek()
+{
+  if (m_connected && inFlight())
+    s_time = m_replyTime;
+  return available() > 0 ? (uint8_t)m_rx[m_rxPos] : -1;
+}
+
+void MockClient::stop()
+{
+  disconnect();
+}
+
+uint8_t MockClient::connected()
+{
+  // Like a real socket: unread data can be read even if server has closed the connection
+  if (m_connected && m_closeAfterReply && m_rxPos >= m_rx.size())
+    disconnect();
+  // Server closes idle connections (nothing to be read, no request in progress)
+  if (m_connected && m_idleTimeout && m_rxPos >= m_rx.size() && s_time - m_lastTraffic >= m_idleTimeout) {
+    disconnect();
+    m_idleCloseCount++;
+  }
+  return m_connected;
+}
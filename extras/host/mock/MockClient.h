@@ -0,0 +1,151 @@
+
+#ifndef MOCK_CLIENT
+#define MOCK_CLIENT
+
+#include <Arduino.h>
+#include "Client.h"
+#include "TLSSession.h"
+#include "KeyPinning.h"
+#include <deque>
+#include <functional>
+#include <string>
+
+// In-memory scriptable Client: no network is used.
+// Queued replies are returned one for each request sent by the bot, while requests are recorded,
+// so the library can be run (and measured) without hardware, Telegram server or TLS.
+// TLS session resumption and certificate verification are simulated too (see setLatency(),
+// setCertificate(), AsyncTelegramBot::setTLSSession() and PinnedClient)
+class MockClient : public Client, public TLSSession, public TLSPinning
+{
+public:
+  // queue a raw reply (status line, headers and body).
+  // Reply becomes readable when the next request is written
+  // params:
+  //   delay: ms from request to reply (-1: the rtt of setLatency())
+  //   close: server closes connection after this reply (as with a "Connection: close" header)
+  void addReply(const char *raw);
+  void addReply(const uint8_t *raw, size_t len, int32_t delay = -1, bool close = false);
+
+  // queue a JSON reply with the headers sent by Telegram server
+  // params:
+  //   body     : JSON body
+  //   status   : HTTP status code
+  //   close    : server will close connection after this reply
+  void addJsonReply(const char *body, int status = 200, bool close = false);
+
+  // Callback function called when a request starts and no reply is queued,
+  // so the reply can be generated according to the request (first chunk written)
+  using RequestCallback = std::function<void(MockClient &client, const char *request, size_t len)>;
+  inline void onRequest(RequestCallback callback) { m_onRequest = callback; }
+
+  // simulate network delays in virtual time: a reply is readable rtt ms after its request
+  // and each connection costs handshake ms (resumedHandshake ms if the session of previous
+  // connection is resumed, 0 no resumption). Waiting for a reply lets virtual time run
+  inline void setLatency(uint32_t rtt, uint32_t handshake, uint32_t resumedHandshake = 0) {
+    m_rtt = rtt;
+    m_handshake = handshake;
+    m_resumedHandshake = resumedHandshake;
+  }
+
+  // public key of server certificate (SubjectPublicKeyInfo, DER), ex. a self-signed test key.
+  // Validation of certificate chain adds chainTime ms to full handshakes (not in pins mode)
+  inline void setCertificate(const uint8_t *spki, size_t len, uint32_t chainTime = 0) {
+    m_serverKey = spki;
+    m_serverKeyLen = len;
+    m_chainTime = chainTime;
+  }
+
+  // virtual time of simulated network (use MockClient::getTime as bot clock)
+  static unsigned long getTime(void) { return s_time; }
+  static void advanceTime(uint32_t ms) { s_time += ms; }
+
+  // server closes connections idle (no request, reply read) for timeout ms (0 never)
+  inline void setIdleClose(uint32_t timeout) { m_idleTimeout = timeout; }
+
+  // connections closed by server for idle timeout
+  inline uint32_t getIdleCloseCount() const { return m_idleCloseCount; }
+
+  // next count connection attempts will fail
+  inline void failConnect(uint16_t count) { m_failConnect = count; }
+
+  // drop connection now (the unread part of current reply is lost)
+  void disconnect(void);
+
+  // number of successful connect() (handshakes with a real client)
+  inline uint32_t getConnectCount() const { return m_connectCount; }
+
+  // number of requests received
+  inline uint32_t getRequestCount() const { return m_requestCount; }
+
+  // all bytes written since last clearRequests()
+  inline const std::string &getRequests() const { return m_tx; }
+  inline void clearRequests() { m_tx.clear(); }
+
+  // replies still queued
+  inline size_t pendingReplies() const { return m_replies.size(); }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  // connections never wait in real time: timeout is not used
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override { (void)timeout; return connect(ip, port); }
+  int connect(const char *host, uint16_t port, int32_t timeout) override { (void)timeout; return connect(host, port); }
+#endif
+  size_t write(uint8_t data) override { return write(&data, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return m_connected; }
+
+  bool resumed(void) override { return m_resumed; }
+  void clear(void) override { m_sessionSaved = false; }
+
+  bool usePins(const KeyPinSet &) override { m_checkChain = false; return true; }
+  void useChain(void) override { m_checkChain = true; }
+  bool verifyPins(const KeyPinSet &pins) override { return pins.matchKey(m_serverKey, m_serverKeyLen); }
+
+private:
+  struct Reply
+  {
+    std::string data;
+    int32_t     delay;
+    bool        close;
+  };
+
+  std::deque<Reply> m_replies;
+  std::string   m_rx;               // reply being read
+  size_t        m_rxPos = 0;
+  std::string   m_tx;
+  bool          m_connected = false;
+  bool          m_closeAfterReply = false;
+  bool          m_requestStarted = false;
+  uint16_t      m_failConnect = 0;
+  uint32_t      m_connectCount = 0;
+  uint32_t      m_requestCount = 0;
+  uint32_t      m_rtt = 0;
+  uint32_t      m_handshake = 0;
+  uint32_t      m_resumedHandshake = 0;
+  bool          m_sessionSaved = false;
+  bool          m_resumed = false;      // last connection resumed the saved session
+  bool          m_checkChain = true;
+  uint32_t      m_chainTime = 0;
+  uint32_t      m_idleTimeout = 0;
+  uint32_t      m_idleCloseCount = 0;
+  unsigned long m_lastTraffic = 0;
+  const uint8_t *m_serverKey = nullptr;
+  size_t        m_serverKeyLen = 0;
+  unsigned long m_replyTime = 0;    // virtual time when current reply becomes readable
+  RequestCallback m_onRequest = nullptr;
+
+  static unsigned long s_time;
+
+  // true if current reply has not yet reached the client
+  bool inFlight(void);
+};
+
+#endif
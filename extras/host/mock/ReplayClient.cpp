@@ -0,0 +1,109 @@
+#include "ReplayClient.h"
+
+ReplayClient::ReplayClient()
+{
+  onRequest([this](MockClient &, const char *request, size_t len) { replyTo(request, len); });
+}
+
+std::string ReplayClient::requestKey(const char *text, size_t len)
+{
+  // Request line: method and path, where only the last segment is kept (the token is dropped)
+  const char *end = (const char *)memchr(text, '\n', len);
+  const std::string line(text, end != nullptr ? end - text : len);
+  const size_t method = line.find(' ');
+  if (method == std::string::npos)
+    return line;
+  const size_t pathEnd = line.find(' ', method + 1);
+  const std::string path = line.substr(method + 1, pathEnd == std::string::npos ? std::string::npos : pathEnd - method - 1);
+  return line.substr(0, method) + " " + path.substr(path.rfind('/') + 1);
+}
+
+size_t ReplayClient::load(Stream &capture)
+{
+  char header[sizeof(CAPTURE_HEADER) - 1];
+  if (capture.readBytes(header, sizeof(header)) != sizeof(header) || memcmp(header, CAPTURE_HEADER, sizeof(header)))
+    return 0;
+
+  const size_t loaded = m_exchanges.size();
+  std::string request;
+  uint32_t requestEnd = 0;
+  uint8_t lastType = 0;
+  uint8_t head[7];
+  uint8_t data[CAPTURE_RECORD_SIZE];
+  while (capture.readBytes((char *)head, sizeof(head)) == sizeof(head)) {
+    const uint32_t time = head[1] | (head[2] << 8) | (head[3] << 16) | ((uint32_t)head[4] << 24);
+    const uint16_t len = head[5] | (head[6] << 8);
+    if (len > sizeof(data) || capture.readBytes((char *)data, len) != len)
+      break;
+    switch (head[0]) {
+      case CaptureConnect:
+        if (len) {
+          m_connects.push_back(data[0] != 0);
+          if (data[0])
+            m_recordedConnections++;
+        }
+        break;
+      case CaptureWrite:
+        // A new request (the reply to previous one is complete)
+        if (lastType != CaptureWrite) {
+          m_recordedRequests++;
+          request.clear();
+        }
+        request.append((const char *)data, len);
+        requestEnd = time;
+        break;
+      case CaptureRead:
+        // First bytes of the reply to last request
+        if (lastType == CaptureWrite)
+          m_exchanges.push_back(Exchange{requestKey(request.data(), request.size()), "", time - requestEnd, false, false});
+        if (!m_exchanges.empty())
+          m_exchanges.back().reply.append((const char *)data, len);
+        break;
+      case CaptureDisconnect:
+        // Server closed the connection: after the last reply read
+        if (!m_exchanges.empty())
+          m_exchanges.back().close = true;
+        break;
+      default:
+        break;
+    }
+    lastType = head[0];
+  }
+  return m_exchanges.size() - loaded;
+}
+
+size_t ReplayClient::remainingReplies() const
+{
+  size_t count = 0;
+  for (const Exchange &exchange : m_exchanges)
+    count += !exchange.replayed;
+  return count;
+}
+
+void ReplayClient::replyTo(const char *request, size_t len)
+{
+  const std::string key = requestKey(request, len);
+  for (Exchange &exchange : m_exchanges) {
+    if (!exchange.replayed && exchange.key == key) {
+      exchange.replayed = true;
+      addReply((const uint8_t *)exchange.reply.data(), exchange.reply.size(), exchange.delay, exchange.close);
+      return;
+    }
+  }
+  // No reply: the bot will time out
+  m_unmatchedRequests++;
+}
+
+bool ReplayClient::nextConnect()
+{
+  if (m_connects.empty())
+    return true;
+  const bool result = m_connects.front();
+  m_connects.pop_front();
+  return result;
+}
+
+int ReplayClient::connect(const char *host, uint16_t port)
+{
+  return nextConnect() ? MockClient::connect(host, port) : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef REPLAY_CLIENT
+#define REPLAY_CLIENT
+
+#include "MockClient.h"
+#include "TrafficCapture.h"
+#include <vector>
+
+// MockClient that plays back a capture made with RecordingClient: each request of the bot gets
+// the reply recorded for the same request (method and file, ex. "POST getUpdates"), in recording
+// order, with the recorded delay. Failed connections and connections closed by the server are
+// replayed too, so the bot receives exactly the same bytes of the recorded session
+class ReplayClient : public MockClient
+{
+public:
+  ReplayClient();
+
+  // read the capture
+  // returns:
+  //    number of replies loaded (0 if capture is not valid)
+  size_t load(Stream &capture);
+
+  // requests recorded in capture
+  inline uint32_t getRecordedRequests() const { return m_recordedRequests; }
+
+  // connections recorded in capture
+  inline uint32_t getRecordedConnections() const { return m_recordedConnections; }
+
+  // requests of the bot without a recorded reply (replay diverged from recorded session)
+  inline uint32_t getUnmatchedRequests() const { return m_unmatchedRequests; }
+
+  // recorded replies not yet requested
+  size_t remainingReplies(void) const;
+
+  // (MockClient connects to an address as to a host)
+  using MockClient::connect;
+  int connect(const char *host, uint16_t port) override;
+
+private:
+  // A request of recorded session and the reply of server
+  struct Exchange
+  {
+    std::string key;        // request line without path, ex. "POST getUpdates"
+    std::string reply;
+    uint32_t    delay;      // ms from last byte of request to first byte of reply
+    bool        close;      // server closed connection after reply
+    bool        replayed;
+  };
+
+  std::vector<Exchange> m_exchanges;
+  std::deque<bool> m_connects;        // results of recorded connection attempts
+  uint32_t m_recordedRequests = 0;
+  uint32_t m_recordedConnections = 0;
+  uint32_t m_unmatchedRequests = 0;
+
+  // key of the request that starts with text
+  static std::string requestKey(const char *text, size_t len);
+
+  // queue the reply recorded for request (first chunk)
+  void replyTo(const char *request, size_t len);
+
+  // consume the next recorded connection attempt
+  // returns:
+  //    false if it failed
+  bool nextConnect(void);
+};
+
+#endif
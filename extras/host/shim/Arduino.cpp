@@ -0,0 +1,419 @@
+#include "Arduino.h"
+#include "FS.h"
+#include <chrono>
+#include <thread>
+
+HostSerial Serial;
+fs::FS HostFS;
+
+static const auto s_start = std::chrono::steady_clock::now();
+static uint32_t s_seed = 1;
+
+unsigned long millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+unsigned long micros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+}
+
+// xorshift32: same sequence on every host
+long random(long max)
+{
+  if (max <= 0)
+    return 0;
+  s_seed ^= s_seed << 13;
+  s_seed ^= s_seed >> 17;
+  s_seed ^= s_seed << 5;
+  return s_seed % max;
+}
+
+long random(long min, long max)
+{
+  return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+  s_seed = seed ? seed : 1;
+}
+
+
+static std::string toBase(unsigned long long value, unsigned char base, bool negative)
+{
+  if (base < 2 || base > 36)
+    base = 10;
+  char digits[72];
+  char *p = digits + sizeof(digits);
+  *--p = '\0';
+  do {
+    const unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative)
+    *--p = '-';
+  return p;
+}
+
+String::String(int value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(long value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long)value, base) {}
+
+String::String(long long value, unsigned char base)
+{
+  const bool negative = value < 0 && base == 10;
+  m_str = toBase(negative ? 0ULL - (unsigned long long)value : (unsigned long long)value, base, negative);
+}
+
+String::String(unsigned long long value, unsigned char base)
+{
+  m_str = toBase(value, base, false);
+}
+
+String::String(double value, unsigned char decimals)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", decimals, value);
+  m_str = text;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  const size_t pos = m_str.find(c, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const char *text, unsigned int from) const
+{
+  const size_t pos = m_str.find(text, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char c) const
+{
+  const size_t pos = m_str.rfind(c);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+  return m_str.size() >= suffix.m_str.size() &&
+         m_str.compare(m_str.size() - suffix.m_str.size(), suffix.m_str.size(), suffix.m_str) == 0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (from > to) {
+    const unsigned int swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from >= m_str.size())
+    return String();
+  return String(m_str.substr(from, to - from).c_str());
+}
+
+void String::replace(const String &from, const String &to)
+{
+  if (from.m_str.empty())
+    return;
+  for (size_t pos = m_str.find(from.m_str); pos != std::string::npos; pos = m_str.find(from.m_str, pos + to.m_str.size()))
+    m_str.replace(pos, from.m_str.size(), to.m_str);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+  if (index < m_str.size())
+    m_str.erase(index, count);
+}
+
+void String::trim()
+{
+  const size_t first = m_str.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) {
+    m_str.clear();
+    return;
+  }
+  m_str = m_str.substr(first, m_str.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+void String::toLowerCase()
+{
+  for (char &c : m_str)
+    c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase()
+{
+  for (char &c : m_str)
+    c = toupper((unsigned char)c);
+}
+
+StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+  StringSumHelper sum(lhs);
+  sum.concat(rhs);
+  return sum;
+}
+
+StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+  StringSumHelper sum(lhs);
+  sum.concat(rhs);
+  return sum;
+}
+
+StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+  StringSumHelper sum(lhs);
+  sum.concat(rhs);
+  return sum;
+}
+
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (n < size && write(buffer[n]))
+    n++;
+  return n;
+}
+
+size_t Print::print(long long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(double value, int digits)
+{
+  return print(String(value, digits));
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  const int len = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (len < 0)
+    return 0;
+  if ((size_t)len < sizeof(text))
+    return write((const uint8_t *)text, len);
+
+  std::string longText(len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&longText[0], len + 1, format, args);
+  va_end(args);
+  return write((const uint8_t *)longText.data(), len);
+}
+
+
+int Stream::timedRead()
+{
+  const unsigned long start = millis();
+  do {
+    const int c = read();
+    if (c >= 0)
+      return c;
+    yield();
+  } while (millis() - start < m_timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length) {
+    const int c = timedRead();
+    if (c < 0)
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length) {
+    const int c = timedRead();
+    if (c < 0 || c == terminator)
+      break;
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString()
+{
+  String text;
+  for (int c = timedRead(); c >= 0; c = timedRead())
+    text += (char)c;
+  return text;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  String text;
+  for (int c = timedRead(); c >= 0 && c != terminator; c = timedRead())
+    text += (char)c;
+  return text;
+}
+
+bool Stream::find(const char *target)
+{
+  const size_t len = strlen(target);
+  size_t matched = 0;
+  while (matched < len) {
+    const int c = timedRead();
+    if (c < 0)
+      return false;
+    matched = (c == target[matched]) ? matched + 1 : (c == target[0] ? 1 : 0);
+  }
+  return true;
+}
+
+
+bool IPAddress::fromString(const char *text)
+{
+  unsigned value[4];
+  char end;
+  if (sscanf(text, "%u.%u.%u.%u%c", &value[0], &value[1], &value[2], &value[3], &end) != 4)
+    return false;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (value[i] > 255)
+      return false;
+    m_bytes[i] = value[i];
+  }
+  return true;
+}
+
+String IPAddress::toString() const
+{
+  char text[16];
+  snprintf(text, sizeof(text), "%u.%u.%u.%u", m_bytes[0], m_bytes[1], m_bytes[2], m_bytes[3]);
+  return String(text);
+}
+
+
+namespace fs {
+
+File::File(FILE *file, const char *name) : m_file(file, fclose), m_name(name) {}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+  return m_file ? fwrite(buffer, 1, size, m_file.get()) : 0;
+}
+
+int File::available()
+{
+  if (!m_file)
+    return 0;
+  const size_t total = size();
+  const size_t pos = position();
+  return pos < total ? total - pos : 0;
+}
+
+int File::read()
+{
+  return m_file ? fgetc(m_file.get()) : -1;
+}
+
+int File::read(uint8_t *buffer, size_t size)
+{
+  return m_file ? (int)fread(buffer, 1, size, m_file.get()) : -1;
+}
+
+int File::peek()
+{
+  if (!m_file)
+    return -1;
+  const int c = fgetc(m_file.get());
+  if (c >= 0)
+    ungetc(c, m_file.get());
+  return c;
+}
+
+void File::flush()
+{
+  if (m_file)
+    fflush(m_file.get());
+}
+
+bool File::seek(uint32_t position)
+{
+  return m_file && fseek(m_file.get(), position, SEEK_SET) == 0;
+}
+
+size_t File::position() const
+{
+  return m_file ? ftell(m_file.get()) : 0;
+}
+
+size_t File::size() const
+{
+  if (!m_file)
+    return 0;
+  const long pos = ftell(m_file.get());
+  fseek(m_file.get(), 0, SEEK_END);
+  const long end = ftell(m_file.get());
+  fseek(m_file.get(), pos, SEEK_SET);
+  return end;
+}
+
+void File::close()
+{
+  m_file.reset();
+}
+
+String FS::fullPath(const char *path) const
+{
+  String full(m_root);
+  if (*path != '/')
+    full += "/";
+  full += path;
+  return full;
+}
+
+File FS::open(const char *path, const char *mode)
+{
+  char fileMode[4];
+  snprintf(fileMode, sizeof(fileMode), "%cb", *mode);
+  const String full = fullPath(path);
+  FILE *file = fopen(full.c_str(), fileMode);
+  return file != nullptr ? File(file, path) : File();
+}
+
+bool FS::exists(const char *path)
+{
+  FILE *file = fopen(fullPath(path).c_str(), "rb");
+  if (file != nullptr)
+    fclose(file);
+  return file != nullptr;
+}
+
+bool FS::remove(const char *path)
+{
+  return ::remove(fullPath(path).c_str()) == 0;
+}
+
+} // namespace fs
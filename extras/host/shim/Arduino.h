@@ -0,0 +1,215 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal Arduino core for host builds (Linux): only what the library, its tests and the
+// host programs use. Time is real (millis, micros), Serial writes to stdout.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+
+#define PROGMEM
+#define PSTR(s)               (s)
+#define F(s)                  (s)
+#define pgm_read_byte(addr)   (*(const uint8_t *)(addr))
+#define strlen_P              strlen
+#define strcmp_P              strcmp
+#define memcpy_P              memcpy
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+
+class String
+{
+public:
+  String(const char *text = "") { if (text) m_str = text; }
+  String(const String &other) = default;
+  String(String &&other) = default;
+  explicit String(char c) : m_str(1, c) {}
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(double value, unsigned char decimals = 2);
+
+  String &operator=(const String &other) = default;
+  String &operator=(String &&other) = default;
+  String &operator=(const char *text) { m_str = text ? text : ""; return *this; }
+
+  const char *c_str() const { return m_str.c_str(); }
+  unsigned int length() const { return m_str.size(); }
+  bool isEmpty() const { return m_str.empty(); }
+  unsigned char reserve(unsigned int size) { m_str.reserve(size); return 1; }
+
+  unsigned char concat(const String &other) { m_str += other.m_str; return 1; }
+  unsigned char concat(const char *text) { if (text) m_str += text; return 1; }
+  unsigned char concat(const char *text, unsigned int len) { m_str.append(text, len); return 1; }
+  unsigned char concat(char c) { m_str += c; return 1; }
+  template <typename T> unsigned char concat(T value) { return concat(String(value)); }
+
+  template <typename T> String &operator+=(const T &value) { concat(value); return *this; }
+  String &operator+=(const char *text) { concat(text); return *this; }
+
+  bool equals(const String &other) const { return m_str == other.m_str; }
+  bool equals(const char *text) const { return m_str == (text ? text : ""); }
+  bool operator==(const String &other) const { return equals(other); }
+  bool operator==(const char *text) const { return equals(text); }
+  bool operator!=(const String &other) const { return !equals(other); }
+  bool operator!=(const char *text) const { return !equals(text); }
+  bool operator<(const String &other) const { return m_str < other.m_str; }
+
+  char charAt(unsigned int index) const { return index < m_str.size() ? m_str[index] : 0; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index) { return m_str[index]; }
+
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const char *text, unsigned int from = 0) const;
+  int indexOf(const String &text, unsigned int from = 0) const { return indexOf(text.c_str(), from); }
+  int lastIndexOf(char c) const;
+  bool startsWith(const String &prefix) const { return m_str.compare(0, prefix.m_str.size(), prefix.m_str) == 0; }
+  bool endsWith(const String &suffix) const;
+  String substring(unsigned int from) const { return substring(from, length()); }
+  String substring(unsigned int from, unsigned int to) const;
+
+  void replace(const String &from, const String &to);
+  void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+  void trim(void);
+  void toLowerCase(void);
+  void toUpperCase(void);
+  long toInt(void) const { return atol(m_str.c_str()); }
+  float toFloat(void) const { return atof(m_str.c_str()); }
+
+private:
+  std::string m_str;
+};
+
+// Result of String concatenation (ArduinoJson checks for it)
+class StringSumHelper : public String
+{
+public:
+  StringSumHelper(const String &text) : String(text) {}
+};
+
+StringSumHelper operator+(const String &lhs, const String &rhs);
+StringSumHelper operator+(const String &lhs, const char *rhs);
+StringSumHelper operator+(const char *lhs, const String &rhs);
+
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *text) { return text ? write((const uint8_t *)text, strlen(text)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+  int getWriteError() { return m_writeError; }
+  void clearWriteError() { m_writeError = 0; }
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(const String &text) { return write(text.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value, int base = 10) { return print((long long)value, base); }
+  size_t print(unsigned int value, int base = 10) { return print((unsigned long long)value, base); }
+  size_t print(long value, int base = 10) { return print((long long)value, base); }
+  size_t print(unsigned long value, int base = 10) { return print((unsigned long long)value, base); }
+  size_t print(long long value, int base = 10);
+  size_t print(unsigned long long value, int base = 10);
+  size_t print(double value, int digits = 2);
+
+  size_t println(void) { return write("\r\n"); }
+  template <typename T> size_t println(const T &value) { return print(value) + println(); }
+  template <typename T> size_t println(const T &value, int format) { return print(value, format) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+protected:
+  void setWriteError(int error = 1) { m_writeError = error; }
+
+private:
+  int m_writeError = 0;
+};
+
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { m_timeout = timeout; }
+  unsigned long getTimeout(void) const { return m_timeout; }
+
+  // read functions wait each byte up to timeout ms, like Arduino Stream
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+  size_t readBytesUntil(char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *)buffer, length); }
+  String readString(void);
+  String readStringUntil(char terminator);
+  bool find(const char *target);
+
+protected:
+  unsigned long m_timeout = 1000;
+  int timedRead(void);
+};
+
+
+class IPAddress
+{
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : m_bytes{a, b, c, d} {}
+  IPAddress(uint32_t address) { memcpy(m_bytes, &address, 4); }
+
+  bool fromString(const char *text);
+  String toString(void) const;
+  operator uint32_t() const { uint32_t address; memcpy(&address, m_bytes, 4); return address; }
+  uint8_t operator[](int index) const { return m_bytes[index]; }
+  uint8_t &operator[](int index) { return m_bytes[index]; }
+  bool operator==(const IPAddress &other) const { return memcmp(m_bytes, other.m_bytes, 4) == 0; }
+
+private:
+  uint8_t m_bytes[4] = {0, 0, 0, 0};
+};
+
+
+// Serial port: output goes to stdout (line buffered, also when redirected), nothing is ever received
+class HostSerial : public Stream
+{
+public:
+  HostSerial() { setvbuf(stdout, nullptr, _IOLBF, BUFSIZ); }
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t data) override { return fwrite(&data, 1, 1, stdout); }
+  size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+  void flush() override { fflush(stdout); }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  operator bool() const { return true; }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include "Arduino.h"
+#include <memory>
+
+// Filesystem of host builds: paths are relative to a root directory on disk
+namespace fs {
+
+class File : public Stream
+{
+public:
+  File() {}
+  File(FILE *file, const char *name);
+
+  size_t write(uint8_t data) override { return write(&data, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buffer, size_t size);
+  int peek() override;
+  void flush() override;
+
+  bool seek(uint32_t position);
+  size_t position() const;
+  size_t size() const;
+  const char *name() const { return m_name.c_str(); }
+  void close();
+  operator bool() const { return m_file != nullptr; }
+
+  using Print::write;
+
+private:
+  std::shared_ptr<FILE> m_file;
+  String m_name;
+};
+
+class FS
+{
+public:
+  FS(const char *root = ".") : m_root(root) {}
+
+  bool begin() { return true; }
+  // mode: "r", "w" or "a" as fopen
+  File open(const char *path, const char *mode = "r");
+  bool exists(const char *path);
+  bool remove(const char *path);
+
+private:
+  String m_root;
+  String fullPath(const char *path) const;
+};
+
+} // namespace fs
+
+using fs::File;
+
+// Current directory
+extern fs::FS HostFS;
+
+#endif
@@ -0,0 +1,100 @@
+#include "HostHeap.h"
+#include <malloc.h>
+
+// Allocator functions of glibc, called by the replacements below
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+static uint32_t s_allocations = 0;
+static uint32_t s_frees = 0;
+static size_t s_used = 0;
+static size_t s_peak = 0;
+static bool s_paused = false;
+
+static void *allocated(void *ptr)
+{
+  if (ptr != nullptr) {
+    s_allocations += !s_paused;
+    s_used += malloc_usable_size(ptr);
+    if (s_used > s_peak)
+      s_peak = s_used;
+  }
+  return ptr;
+}
+
+static void released(void *ptr)
+{
+  if (ptr != nullptr) {
+    s_frees += !s_paused;
+    s_used -= malloc_usable_size(ptr);
+  }
+}
+
+extern "C" {
+
+void *malloc(size_t size)
+{
+  return allocated(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size)
+{
+  return allocated(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  // Like glibc: size 0 releases the block
+  if (size == 0) {
+    free(ptr);
+    return nullptr;
+  }
+  const size_t old = ptr != nullptr ? malloc_usable_size(ptr) : 0;
+  void *block = __libc_realloc(ptr, size);
+  if (block == nullptr)
+    return nullptr;
+  s_used -= old;
+  return allocated(block);
+}
+
+void free(void *ptr)
+{
+  released(ptr);
+  __libc_free(ptr);
+}
+
+}
+
+uint32_t HostHeap::getAllocations()
+{
+  return s_allocations;
+}
+
+uint32_t HostHeap::getFrees()
+{
+  return s_frees;
+}
+
+size_t HostHeap::getUsed()
+{
+  return s_used;
+}
+
+size_t HostHeap::getPeak()
+{
+  return s_peak;
+}
+
+void HostHeap::resetPeak()
+{
+  s_peak = s_used;
+}
+
+void HostHeap::setPaused(bool paused)
+{
+  s_paused = paused;
+}
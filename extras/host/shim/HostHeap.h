@@ -0,0 +1,66 @@
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Client.h"
+
+// System heap usage of a host program: malloc, calloc, realloc and free are replaced (glibc),
+// so operator new/delete and the containers of the C++ library are counted too.
+// Only the programs built with HostHeap.cpp are measured
+class HostHeap
+{
+public:
+  // number of successful allocations since start (reallocations included)
+  static uint32_t getAllocations(void);
+
+  // number of blocks released
+  static uint32_t getFrees(void);
+
+  // bytes currently allocated (usable size of blocks)
+  static size_t getUsed(void);
+
+  // max value of bytes allocated at the same time
+  static size_t getPeak(void);
+
+  // restart peak measuring from current usage
+  static void resetPeak(void);
+
+  // allocations and frees are not counted while paused (ex. by a simulated server),
+  // bytes allocated are always tracked
+  static void setPaused(bool paused);
+};
+
+// Client decorator: allocations made by the wrapped client (ex. a MockClient that stores
+// requests and replies) are not counted, so only the allocations of the bot are measured
+class UncountedClient : public Client
+{
+public:
+  UncountedClient(Client &client) : m_client(client) {}
+
+  int connect(IPAddress ip, uint16_t port) override { Pause p; return m_client.connect(ip, port); }
+  int connect(const char *host, uint16_t port) override { Pause p; return m_client.connect(host, port); }
+  size_t write(uint8_t data) override { Pause p; return m_client.write(data); }
+  size_t write(const uint8_t *buf, size_t size) override { Pause p; return m_client.write(buf, size); }
+  int available() override { Pause p; return m_client.available(); }
+  int read() override { Pause p; return m_client.read(); }
+  int read(uint8_t *buf, size_t size) override { Pause p; return m_client.read(buf, size); }
+  int peek() override { Pause p; return m_client.peek(); }
+  void flush() override { Pause p; m_client.flush(); }
+  void stop() override { Pause p; m_client.stop(); }
+  uint8_t connected() override { Pause p; return m_client.connected(); }
+  operator bool() override { Pause p; return (bool)m_client; }
+
+  using Client::write;
+
+private:
+  struct Pause
+  {
+    Pause() { HostHeap::setPaused(true); }
+    ~Pause() { HostHeap::setPaused(false); }
+  };
+
+  Client &m_client;
+};
+
+#endif
@@ -0,0 +1,113 @@
+// downloadFile() over a FaultClient: connection dropped in the middle of the download
+// (body and headers), the download is resumed with HTTP Range requests
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <FaultClient.h>
+#include "HostTest.h"
+
+#define FILE_SIZE   20000
+
+static uint8_t content[FILE_SIZE];
+
+// Destination of the download
+struct MemoryStream : public Stream
+{
+  std::string data;
+  size_t write(uint8_t c) override { data += (char)c; return 1; }
+  size_t write(const uint8_t *buf, size_t size) override { data.append((const char *)buf, size); return size; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+// File server: replies to range requests with 206 and the requested part of content
+static void fileServer(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  const char *range = strstr(request, "Range: bytes=");
+  if (strncmp(request, "GET /file/bot", 13) != 0 || range == nullptr) {
+    client.addJsonReply("{\"ok\":true,\"result\":[]}");
+    return;
+  }
+  const size_t from = strtoul(range + 13, nullptr, 10);
+  const size_t size = from < FILE_SIZE ? FILE_SIZE - from : 0;
+  char header[160];
+  snprintf(header, sizeof(header),
+           "HTTP/1.1 206 Partial Content\r\nContent-Length: %u\r\nContent-Range: bytes %u-%u/%u\r\n"
+           "Connection: keep-alive\r\n\r\n", (unsigned)size, (unsigned)from, FILE_SIZE - 1, FILE_SIZE);
+  std::string reply(header);
+  reply.append((const char *)content + from, size);
+  client.addReply((const uint8_t *)reply.data(), reply.size());
+}
+
+struct DownloadBot
+{
+  MockClient server;
+  FaultClient network;
+  AsyncTelegramBot bot;
+  TBDocument doc;
+  MemoryStream file;
+
+  DownloadBot() : network(server), bot(network) {
+    for (size_t i = 0; i < FILE_SIZE; i++)
+      content[i] = (uint8_t)(i * 7 + (i >> 8));
+    bot.setClock(MockClient::getTime);
+    network.setClock(MockClient::getTime, MockClient::advanceTime);
+    server.setLatency(50, 200);
+    bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+    server.addJsonReply("{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Dl\",\"username\":\"dl_bot\"}}");
+    CHECK(bot.begin());
+    server.onRequest(fileServer);
+    doc.file_exists = true;
+    doc.file_size = FILE_SIZE;
+    doc.file_path = "https://api.telegram.org/file/bot123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr/documents/file_1.bin";
+  }
+
+  bool complete() const {
+    return file.data.size() == FILE_SIZE && memcmp(file.data.data(), content, FILE_SIZE) == 0;
+  }
+};
+
+TEST(downloadWithoutFaults)
+{
+  DownloadBot d;
+  CHECK(d.bot.downloadFile(d.doc, d.file));
+  CHECK(d.complete());
+}
+
+TEST(downloadResumedAfterDrop)
+{
+  DownloadBot d;
+  // Request 2 is the first download request (request 1 is getMe)
+  d.network.addFault(2, FaultDrop, 8000);
+  CHECK(d.bot.downloadFile(d.doc, d.file));
+  CHECK(d.complete());
+  CHECK(d.network.getRequestCount() == 3);
+}
+
+TEST(downloadResumedAfterFailedRetry)
+{
+  DownloadBot d;
+  // Body dropped, then the resume request drops before its headers: that failure starts
+  // the reconnection backoff, and the next retry must not be refused by it
+  d.network.addFault(2, FaultDrop, 8000);
+  d.network.addFault(3, FaultDrop, 1);
+  CHECK(d.bot.downloadFile(d.doc, d.file));
+  CHECK(d.complete());
+  CHECK(d.network.getRequestCount() == 4);
+  CHECK(d.bot.getHealth().consecutiveFailures == 0);
+}
+
+TEST(downloadStopsWhenServerIsDown)
+{
+  DownloadBot d;
+  // Body dropped, then no connection is possible: every retry tries to reconnect, no more than DOWNLOAD_RETRY
+  d.network.addFault(2, FaultDrop, 8000);
+  d.server.failConnect(100);
+  const uint32_t connects = d.server.getConnectCount();
+  CHECK(!d.bot.downloadFile(d.doc, d.file));
+  CHECK(d.server.getConnectCount() == connects);
+  CHECK(d.file.data.size() < FILE_SIZE);
+  CHECK(d.bot.getStats().connectFailures == DOWNLOAD_RETRY);
+}
@@ -0,0 +1,70 @@
+// Dual connection mode (setSendClient): polling and sending connections keep their own state,
+// so a stalled polling connection is reset even while messages are sent on the other one
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include "HostTest.h"
+
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Dual\",\"username\":\"dual_bot\"}}";
+
+static const char *sentReply =
+  "{\"ok\":true,\"result\":{\"message_id\":1236,\"chat\":{\"id\":123456789,\"type\":\"private\"},"
+  "\"date\":1620000000,\"text\":\"world\"}}";
+
+struct DualBot
+{
+  MockClient pollMock;
+  MockClient sendMock;
+  AsyncTelegramBot bot;
+  TBMessage msg;
+
+  DualBot() : bot(pollMock) {
+    bot.setClock(MockClient::getTime);
+    bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+    pollMock.addJsonReply(getMeReply);
+    CHECK(bot.begin());
+    bot.setSendClient(sendMock);
+    // Every request on sending connection is answered
+    sendMock.onRequest([](MockClient &client, const char *request, size_t len) {
+      (void)request;
+      (void)len;
+      client.addJsonReply(sentReply);
+    });
+  }
+};
+
+TEST(sendsAnsweredOnSendingConnection)
+{
+  DualBot d;
+  d.bot.sendTo(123456789, "hello");
+  CHECK(d.sendMock.getRequests().find("/sendMessage ") != std::string::npos);
+  CHECK(d.pollMock.getRequests().find("/sendMessage ") == std::string::npos);
+}
+
+TEST(stalledPollingResetWhileSending)
+{
+  DualBot d;
+  // Polling request is never answered (stalled socket), while a message is sent every second
+  const uint32_t start = MockClient::getTime();
+  const uint32_t watchdog = 10 * MIN_UPDATE_TIME + LONG_POLL_TIMEOUT * 1000UL;
+  for (uint32_t i = 1; d.bot.getStats().reconnects == 0 && MockClient::getTime() - start < watchdog + 2000; i++) {
+    MockClient::advanceTime(MIN_UPDATE_TIME);
+    CHECK(d.bot.getNewMessage(d.msg) == MessageNoData);
+    if (i % 2 == 0)
+      d.bot.sendTo(123456789, "still alive");
+  }
+
+  // Watchdog of polling connection is not postponed by the replies on sending connection
+  CHECK(d.bot.getStats().reconnects == 1);
+  CHECK((int32_t)(MockClient::getTime() - start - watchdog) <= (int32_t)MIN_UPDATE_TIME);
+  CHECK(d.sendMock.getRequestCount() >= watchdog / 1000);
+  CHECK(d.sendMock.getConnectCount() == 1);
+
+  // A new polling request is sent on a new connection
+  d.pollMock.clearRequests();
+  d.pollMock.addJsonReply("{\"ok\":true,\"result\":[]}");
+  MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+  CHECK(d.bot.getNewMessage(d.msg) == MessageNoData);
+  CHECK(d.pollMock.getRequests().find("/getUpdates ") != std::string::npos);
+}
@@ -0,0 +1,104 @@
+// Queued getFile requests (requestFile): resolved by getNewMessage(), or failed on error reply,
+// missing reply and connection reset, so a new request can always be queued
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include "HostTest.h"
+
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"File\",\"username\":\"file_bot\"}}";
+
+struct FileBot
+{
+  MockClient mock;
+  AsyncTelegramBot bot;
+  TBMessage msg;
+  TBDocument doc;
+
+  FileBot() : bot(mock) {
+    bot.setClock(MockClient::getTime);
+    bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+    mock.addJsonReply(getMeReply);
+    CHECK(bot.begin());
+    doc.file_id = "BQACAgQAAxkBAAIBY2CJ8Ks4kL7G9sbVx0YmzBz3NJm5AAJ0CAACdPhQUGmB3T2q8YyXHwQ";
+  }
+
+  // next polling, in place of getUpdates
+  MessageType poll() {
+    MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+    return bot.getNewMessage(msg);
+  }
+};
+
+TEST(fileRequestResolved)
+{
+  FileBot f;
+  CHECK(f.bot.requestFile(f.doc));
+  CHECK(f.bot.fileRequestPending());
+  f.mock.addJsonReply("{\"ok\":true,\"result\":{\"file_id\":\"BQAC\",\"file_unique_id\":\"AgAD\","
+                      "\"file_size\":412345,\"file_path\":\"documents/file_1.bin\"}}");
+  f.mock.clearRequests();
+  CHECK(f.poll() == MessageNoData);
+  CHECK(f.mock.getRequests().find("/getFile ") != std::string::npos);
+  CHECK(!f.bot.fileRequestPending());
+  CHECK(f.doc.file_exists);
+  CHECK(f.doc.file_size == 412345);
+  CHECK(f.doc.file_path.endsWith("/documents/file_1.bin"));
+}
+
+TEST(fileRequestErrorReply)
+{
+  FileBot f;
+  CHECK(f.bot.requestFile(f.doc));
+  f.mock.addJsonReply("{\"ok\":false,\"error_code\":400,\"description\":\"Bad Request: file is too big\"}", 400);
+  CHECK(f.poll() == MessageNoData);
+  CHECK(!f.bot.fileRequestPending());
+  CHECK(!f.doc.file_exists);
+  const TBResult &result = f.bot.getLastResult();
+  CHECK(!result.ok);
+  CHECK(result.errorCode == 400);
+  CHECK(strcmp(result.description, "Bad Request: file is too big") == 0);
+
+  // Polling goes on, and the request can be queued again
+  f.mock.clearRequests();
+  f.mock.addJsonReply("{\"ok\":true,\"result\":[]}");
+  CHECK(f.poll() == MessageNoData);
+  CHECK(f.mock.getRequests().find("/getUpdates ") != std::string::npos);
+  CHECK(f.bot.requestFile(f.doc));
+}
+
+TEST(fileRequestOkWithoutPath)
+{
+  FileBot f;
+  CHECK(f.bot.requestFile(f.doc));
+  f.mock.addJsonReply("{\"ok\":true,\"result\":{\"file_id\":\"BQAC\",\"file_unique_id\":\"AgAD\"}}");
+  CHECK(f.poll() == MessageNoData);
+  CHECK(!f.bot.fileRequestPending());
+  CHECK(!f.doc.file_exists);
+}
+
+TEST(fileRequestTimeout)
+{
+  FileBot f;
+  f.bot.setReplyTimeout(2000);
+  CHECK(f.bot.requestFile(f.doc));
+  // No reply is queued: the request is sent and the reply never comes
+  CHECK(f.poll() == MessageNoData);
+  CHECK(f.bot.fileRequestPending());
+  for (int i = 0; i < 10 && f.bot.fileRequestPending(); i++)
+    f.poll();
+  CHECK(!f.bot.fileRequestPending());
+  CHECK(!f.doc.file_exists);
+  CHECK(f.bot.getLastResult().status == 0);
+  CHECK(f.bot.requestFile(f.doc));
+}
+
+TEST(fileRequestReset)
+{
+  FileBot f;
+  CHECK(f.bot.requestFile(f.doc));
+  f.bot.reset();
+  CHECK(!f.bot.fileRequestPending());
+  CHECK(!f.doc.file_exists);
+  CHECK(f.bot.requestFile(f.doc));
+}
@@ -0,0 +1,131 @@
+// System heap used by the bot after begin(): polling, parsing updates, sending text messages,
+// answering queries and editing messages are run with the malloc functions counted (HostHeap)
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include <HostHeap.h>
+#include "HostTest.h"
+
+#define CYCLES  20
+
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Heap\",\"username\":\"heap_bot\"}}";
+
+static const char *textUpdate =
+  "{\"ok\":true,\"result\":[{\"update_id\":100001,\"message\":{\"message_id\":1234,"
+  "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+  "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"},"
+  "\"date\":1620000000,\"text\":\"hello from a user of the bot\"}}]}";
+
+static const char *queryUpdate =
+  "{\"ok\":true,\"result\":[{\"update_id\":100002,\"callback_query\":{\"id\":\"4382\","
+  "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+  "\"message\":{\"message_id\":1235,\"chat\":{\"id\":123456789,\"type\":\"private\"},\"date\":1620000000,\"text\":\"menu\"},"
+  "\"chat_instance\":\"1\",\"data\":\"ON\"}}]}";
+
+static const char *sentReply =
+  "{\"ok\":true,\"result\":{\"message_id\":1236,\"chat\":{\"id\":123456789,\"type\":\"private\"},"
+  "\"date\":1620000000,\"text\":\"world\"}}";
+
+// Client that serves fixed replies without allocating (MockClient queues and records with std::string):
+// getUpdates gets the next update, any other request sentReply
+class FixedClient : public Client
+{
+public:
+  const char *nextUpdate = textUpdate;
+
+  int connect(IPAddress ip, uint16_t port) override { (void)ip; return connect("", port); }
+  int connect(const char *host, uint16_t port) override { (void)host; (void)port; m_connected = true; return 1; }
+  size_t write(uint8_t data) override { return write(&data, 1); }
+  size_t write(const uint8_t *buf, size_t size) override {
+    // First chunk of a new request: its reply becomes readable
+    if (m_pos == m_len) {
+      const bool updates = strstr((const char *)buf, "/getUpdates ") != nullptr;
+      const char *body = m_begun ? (updates ? nextUpdate : sentReply) : getMeReply;
+      m_begun = true;
+      m_len = snprintf(m_reply, sizeof(m_reply), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %u\r\nConnection: keep-alive\r\n\r\n%s", (unsigned)strlen(body), body);
+      m_pos = 0;
+    }
+    return size;
+  }
+  int available() override { return m_len - m_pos; }
+  int read() override { return m_pos < m_len ? (uint8_t)m_reply[m_pos++] : -1; }
+  int read(uint8_t *buf, size_t size) override {
+    size_t n = 0;
+    while (n < size && m_pos < m_len)
+      buf[n++] = m_reply[m_pos++];
+    return n ? (int)n : -1;
+  }
+  int peek() override { return m_pos < m_len ? (uint8_t)m_reply[m_pos] : -1; }
+  void flush() override {}
+  void stop() override { m_connected = false; m_pos = m_len; }
+  uint8_t connected() override { return m_connected; }
+  operator bool() override { return m_connected; }
+
+private:
+  char    m_reply[1024];
+  size_t  m_len = 0;
+  size_t  m_pos = 0;
+  bool    m_connected = false;
+  bool    m_begun = false;
+};
+
+struct HeapBot
+{
+  FixedClient client;
+  AsyncTelegramBot bot;
+  InlineKeyboard keyboard;
+  TBMessage msg;
+
+  HeapBot() : bot(client) {
+    bot.setClock(MockClient::getTime);
+    bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+    CHECK(bot.begin());
+    keyboard.addButton("ON", "ON", KeyboardButtonQuery);
+    keyboard.addButton("OFF", "OFF", KeyboardButtonQuery);
+  }
+
+  // first message received (the reply to a previous request is read before)
+  MessageType poll(const char *update) {
+    client.nextUpdate = update;
+    MessageType type = MessageNoData;
+    for (int i = 0; i < 4 && type == MessageNoData; i++) {
+      MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+      type = bot.getNewMessage(msg);
+    }
+    return type;
+  }
+
+  // one cycle of a bot with a menu: text message, reply with keyboard, query answered and message edited.
+  // Requests are not blocking (result false): their replies are read by the next poll
+  bool cycle() {
+    bool ok = poll(textUpdate) == MessageText && msg.text == "hello from a user of the bot";
+    bot.sendMessage(msg, "world", keyboard);
+    ok = poll(queryUpdate) == MessageQuery && strcmp(msg.callbackQueryData, "ON") == 0 && ok;
+    bot.endQuery(msg, "done");
+    bot.editMessage(msg, "menu", keyboard);
+    return ok;
+  }
+};
+
+TEST(noAllocationsAfterBegin)
+{
+  HeapBot b;
+  // First cycle sizes the storage of msg.text (kept between calls)
+  const uint32_t first = HostHeap::getAllocations();
+  CHECK(b.cycle());
+  CHECK(HostHeap::getAllocations() > first);
+
+  const uint32_t allocations = HostHeap::getAllocations();
+  const size_t used = HostHeap::getUsed();
+  bool ok = true;
+  for (int i = 0; i < CYCLES; i++)
+    ok = b.cycle() && ok;
+  const uint32_t newAllocations = HostHeap::getAllocations() - allocations;
+  const long change = (long)HostHeap::getUsed() - (long)used;
+  CHECK(ok);
+  printf("allocations in %d cycles: %u, heap change: %ld bytes\n", CYCLES, (unsigned)newAllocations, change);
+  CHECK(newAllocations == 0);
+  CHECK(change == 0);
+}
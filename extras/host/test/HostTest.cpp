@@ -0,0 +1,33 @@
+#include "HostTest.h"
+
+namespace {
+  struct Entry { const char *name; void (*test)(void); };
+  Entry    s_tests[64];
+  unsigned s_count = 0;
+  unsigned s_failures = 0;
+}
+
+HostTest::HostTest(const char *name, void (*test)(void))
+{
+  if (s_count < sizeof(s_tests) / sizeof(s_tests[0]))
+    s_tests[s_count++] = {name, test};
+}
+
+bool HostTest::check(bool condition, const char *text, const char *file, int line)
+{
+  if (!condition) {
+    printf("%s:%d: CHECK(%s) failed\n", file, line, text);
+    s_failures++;
+  }
+  return condition;
+}
+
+int main()
+{
+  for (unsigned i = 0; i < s_count; i++) {
+    const unsigned failures = s_failures;
+    s_tests[i].test();
+    printf("%s %s\n", s_failures == failures ? "PASS" : "FAIL", s_tests[i].name);
+  }
+  return s_failures ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <Arduino.h>
+
+// Minimal test runner of host tests: each TEST() is a function run once by main(),
+// a failed CHECK() prints file and line and makes the program exit with 1
+
+struct HostTest
+{
+  HostTest(const char *name, void (*test)(void));
+  static bool check(bool condition, const char *text, const char *file, int line);
+};
+
+#define TEST(name)                                        \
+  static void name(void);                                 \
+  static HostTest name##_registration(#name, name);       \
+  static void name(void)
+
+#define CHECK(condition) HostTest::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,67 @@
+// Keyboards built with many buttons: the JSON document grows with the keyboard,
+// and when memory is exhausted addButton() fails leaving the keyboard unchanged
+
+#include <AsyncTelegramBot.h>
+#include "HostTest.h"
+
+#define BUTTONS   100
+
+static bool hasButton(const String &json, int index)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "\"Button %d\"", index);
+  return json.indexOf(text) >= 0;
+}
+
+TEST(inlineKeyboardGrows)
+{
+  InlineKeyboard keyboard;
+  bool ok = true;
+  for (int i = 0; i < BUTTONS; i++) {
+    char text[16];
+    snprintf(text, sizeof(text), "Button %d", i);
+    if (i % 4 == 0 && i > 0)
+      ok = keyboard.addRow() && ok;
+    ok = keyboard.addButton(text, "query", KeyboardButtonQuery) && ok;
+  }
+  CHECK(ok);
+  CHECK(keyboard.getButtonsNumber() == BUTTONS);
+  CHECK(keyboard.getJSON().startsWith("{\"inline_keyboard\":[[{\"text\":\"Button 0\""));
+  CHECK(hasButton(keyboard.getJSON(), BUTTONS - 1));
+  CHECK(keyboard.getJSON().endsWith("]]}"));
+}
+
+TEST(replyKeyboardGrows)
+{
+  ReplyKeyboard keyboard;
+  bool ok = true;
+  for (int i = 0; i < BUTTONS; i++) {
+    char text[16];
+    snprintf(text, sizeof(text), "Button %d", i);
+    if (i % 4 == 0 && i > 0)
+      ok = keyboard.addRow() && ok;
+    ok = keyboard.addButton(text) && ok;
+  }
+  keyboard.enableResize();
+  CHECK(ok);
+  CHECK(hasButton(keyboard.getJSON(), BUTTONS - 1));
+  CHECK(keyboard.getJSON().indexOf("\"resize_keyboard\":true") > 0);
+}
+
+TEST(addButtonFailsWithoutMemory)
+{
+  ArenaAllocator arena(4096);
+  InlineKeyboard keyboard(arena);
+  int added = 0;
+  while (added < BUTTONS && keyboard.addButton("Button", "query", KeyboardButtonQuery))
+    added++;
+  CHECK(added > 0 && added < BUTTONS);
+  CHECK(keyboard.getButtonsNumber() == added);
+
+  // Failed button is not in the JSON either
+  const String json = keyboard.getJSON();
+  int count = 0;
+  for (int pos = json.indexOf("\"Button\""); pos >= 0; pos = json.indexOf("\"Button\"", pos + 1))
+    count++;
+  CHECK(count == added);
+}
@@ -0,0 +1,106 @@
+// TBLog ring: records formatted on the board (TBLog::print()) and dumps for extras/log_decoder.
+// The dumps and the text printed on the board are left in the working directory: test/log_decoder_test.py
+// decodes the dumps with this source file and compares them with the text
+
+#include <TBLog.h>
+#include <FS.h>
+#include "HostTest.h"
+
+#define BIN_DUMP      "log_dump.bin"
+#define HEX_DUMP      "log_dump.txt"
+#define PRINTED_LOG   "log_printed.txt"
+
+static uint32_t logTime = 1000;
+
+static unsigned long logClock(void)
+{
+  return logTime;
+}
+
+// Print to memory
+class TextPrint : public Print
+{
+public:
+  size_t write(uint8_t data) override { text += (char)data; return 1; }
+  std::string text;
+};
+
+static void writeRecords(void)
+{
+  logTime = 1000;
+  TBLog::clear();
+  TBLog::setClock(logClock);
+  TB_LOG('I', "connected in %lu ms", (unsigned long)1234);
+  logTime += 250;
+  TB_LOG('E', "HTTP %d: %s", -404, "Not Found");
+  TB_LOG('D', "update %lld, file %llx", (long long)1234567890123LL, (unsigned long long)0xabcdef12345ULL);
+  logTime += 1000;
+  TB_LOG('I', "temperature %.2f, ratio %5.1f%%", 21.456, 0.5);
+  TB_LOG('I', "name [%-8s] [%5d] [%04x]", "abc", 42, 255u);
+  TB_LOG('W', "\nlevel %c, code %u", 'W', 7u);
+  TB_LOG('I', "long %s", "0123456789012345678901234567890123456789");
+}
+
+TEST(recordsPrintedOnBoard)
+{
+  writeRecords();
+  TextPrint out;
+  CHECK(TBLog::print(out) == 7);
+  CHECK(out.text ==
+        "[I][1000] connected in 1234 ms\r\n"
+        "[E][1250] HTTP -404: Not Found\r\n"
+        "[D][1250] update 1234567890123, file abcdef12345\r\n"
+        "[I][2250] temperature 21.46, ratio   0.5%\r\n"
+        "[I][2250] name [abc     ] [   42] [00ff]\r\n"
+        "[W][2250] level W, code 7\r\n"
+        "[I][2250] long 01234567890123456789012345678901\r\n");
+
+  // Only the records of last second
+  out.text.clear();
+  CHECK(TBLog::print(out, 1000) == 6);
+}
+
+TEST(unknownFormatPrintsId)
+{
+  TBLog::clear();
+  logTime = 3000;
+  TBLog::write('I', 0x1234abcdUL, 5);
+  TextPrint out;
+  CHECK(TBLog::print(out) == 1);
+  CHECK(out.text == "[I][3000] <format 1234abcd>\n");
+}
+
+TEST(hexDumpMatchesBinary)
+{
+  writeRecords();
+  TextPrint bin, hex;
+  TBLog::dump(bin);
+  TBLog::dump(hex, true);
+  CHECK(bin.text.compare(0, 7, "TBLOG1\n") == 0);
+
+  std::string digits;
+  for (char c : hex.text) {
+    if (isxdigit((unsigned char)c))
+      digits += c;
+  }
+  std::string decoded;
+  for (size_t i = 0; i + 1 < digits.size(); i += 2)
+    decoded += (char)strtoul(digits.substr(i, 2).c_str(), nullptr, 16);
+  CHECK(decoded == bin.text);
+}
+
+// Input of log_decoder_test.py
+TEST(dumpsWritten)
+{
+  writeRecords();
+  File bin = HostFS.open(BIN_DUMP, "w");
+  File hex = HostFS.open(HEX_DUMP, "w");
+  File printed = HostFS.open(PRINTED_LOG, "w");
+  CHECK(bin && hex && printed);
+  TBLog::dump(bin);
+  TBLog::dump(hex, true);
+  CHECK(TBLog::print(printed) == 7);
+  bin.close();
+  hex.close();
+  printed.close();
+}
@@ -0,0 +1,139 @@
+// Bot connected to a MockClient: requests sent to the server and updates received, in virtual time
+
+#include <AsyncTelegramBot.h>
+#include <MockClient.h>
+#include "HostTest.h"
+
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Mock\",\"username\":\"mock_bot\"}}";
+
+static const char *textUpdate =
+  "{\"ok\":true,\"result\":[{\"update_id\":100001,\"message\":{\"message_id\":1234,"
+  "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+  "\"chat\":{\"id\":123456789,\"first_name\":\"John\",\"type\":\"private\"},"
+  "\"date\":1620000000,\"text\":\"hello\"}}]}";
+
+static bool startBot(AsyncTelegramBotBase &bot, MockClient &mock)
+{
+  bot.setClock(MockClient::getTime);
+  bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+  mock.addJsonReply(getMeReply);
+  return bot.begin();
+}
+
+TEST(beginSendsGetMe)
+{
+  MockClient mock;
+  AsyncTelegramBot bot(mock);
+  CHECK(startBot(bot, mock));
+  CHECK(strcmp(bot.getBotName(), "mock_bot") == 0);
+  CHECK(mock.getRequests().find("POST /bot123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr/getMe HTTP/1.0") == 0);
+  CHECK(mock.getConnectCount() == 1);
+}
+
+TEST(textUpdateIsParsed)
+{
+  MockClient mock;
+  AsyncTelegramBot bot(mock);
+  CHECK(startBot(bot, mock));
+  mock.clearRequests();
+
+  TBMessage msg;
+  mock.addJsonReply(textUpdate);
+  MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+  CHECK(bot.getNewMessage(msg) == MessageText);
+  CHECK(msg.text == "hello");
+  CHECK(msg.chatId == 123456789);
+  CHECK(msg.messageID == 1234);
+  CHECK(mock.getRequests().find("/getUpdates ") != std::string::npos);
+
+  // Next poll asks for the following update
+  mock.clearRequests();
+  mock.addJsonReply("{\"ok\":true,\"result\":[]}");
+  MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+  CHECK(bot.getNewMessage(msg) == MessageNoData);
+  CHECK(mock.getRequests().find("\"offset\":100002") != std::string::npos);
+}
+
+TEST(latencyRunsInVirtualTime)
+{
+  MockClient mock;
+  AsyncTelegramBot bot(mock);
+  mock.setLatency(100, 500);
+  const unsigned long start = MockClient::getTime();
+  const unsigned long realStart = millis();
+  CHECK(startBot(bot, mock));
+  // Handshake and round trip of getMe, without waiting for them
+  CHECK(MockClient::getTime() - start >= 600);
+  CHECK(millis() - realStart < 500);
+}
+
+TEST(failedConnectionIsReported)
+{
+  MockClient mock;
+  AsyncTelegramBot bot(mock);
+  mock.failConnect(10);
+  CHECK(!startBot(bot, mock));
+  CHECK(mock.getConnectCount() == 0);
+  CHECK(bot.getStats().connectFailures >= 1);
+  CHECK(bot.getHealth().consecutiveFailures == bot.getStats().connectFailures);
+}
+
+TEST(longMessageSentInChunks)
+{
+  MockClient mock;
+  AsyncTelegramBot bot(mock);
+  CHECK(startBot(bot, mock));
+  mock.clearRequests();
+
+  // Payload larger than the chunk buffer (BLOCK_SIZE) is serialized there a chunk at a time
+  std::string text(3 * BLOCK_SIZE, 'a');
+  text.back() = 'z';
+  mock.addJsonReply("{\"ok\":true,\"result\":{\"message_id\":1235}}");
+  bot.sendTo(123456789, text.c_str());
+  const std::string &request = mock.getRequests();
+  const size_t body = request.find("\n\n") + 2;
+  CHECK(request.find("\"text\":\"" + text + "\"") != std::string::npos);
+  char length[40];
+  snprintf(length, sizeof(length), "Content-Length: %u\n", (unsigned)(request.size() - body));
+  CHECK(request.find(length) != std::string::npos);
+}
+
+TEST(overflowedPayloadIsNotSent)
+{
+  MockClient mock;
+  AsyncTelegramBotT<BUFFER_BIG, BUFFER_SMALL, BUFFER_BIG> bot(mock);
+  CHECK(startBot(bot, mock));
+  mock.clearRequests();
+  const uint32_t requests = mock.getRequestCount();
+
+  // Keyboard is copied in the payload document, too small to hold it
+  std::string keyboard = "{\"inline_keyboard\":[[";
+  for (int i = 0; i < 20; i++)
+    keyboard += std::string(i ? "," : "") + "{\"text\":\"button with a long label\",\"callback_data\":\"data\"}";
+  keyboard += "]]}";
+  TBMessage msg;
+  msg.chatId = 123456789;
+  CHECK(!bot.sendMessage(msg, "menu", keyboard.c_str()));
+  CHECK(mock.getRequestCount() == requests);
+  CHECK(bot.getLastResult().status == -1);
+  CHECK(strstr(bot.getLastResult().description, "capacity") != nullptr);
+}
+
+TEST(truncatedReplyIsReported)
+{
+  MockClient mock;
+  AsyncTelegramBotT<BUFFER_SMALL> bot(mock);
+  CHECK(startBot(bot, mock));
+  CHECK(!bot.getLastResult().truncated);
+
+  // Update longer than the receive buffer: the rest is discarded
+  std::string update = textUpdate;
+  update.replace(update.find("hello"), 5, std::string(BUFFER_SMALL, 'a'));
+  mock.addJsonReply(update.c_str());
+  MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+  TBMessage msg;
+  CHECK(bot.getNewMessage(msg) == MessageNoData);
+  CHECK(bot.getStats().truncatedReplies == 1);
+  CHECK(bot.getLastResult().truncated);
+}
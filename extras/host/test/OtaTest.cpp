@@ -0,0 +1,174 @@
+// TelegramOTA writing the image to a file (StreamUpdateSink on HostFS): firmware received as document,
+// downloaded in segments, verified with the SHA-256 in caption before the last chunk is written
+
+#include <AsyncTelegramBot.h>
+#include <TelegramOTA.h>
+#include <MockClient.h>
+#include <FS.h>
+#include "HostTest.h"
+
+#define IMAGE_SIZE    150000      // three download segments
+#define IMAGE_FILE    "ota_image.bin"
+
+// sha256sum of image
+#define IMAGE_SHA256  "8b194882fd4c9ac21acde9b27f7fcc891f2e2a65844ecea7eceea46fd3c19142"
+
+static uint8_t image[IMAGE_SIZE];
+
+static const char *getMeReply =
+  "{\"ok\":true,\"result\":{\"id\":123456789,\"is_bot\":true,\"first_name\":\"Ota\",\"username\":\"ota_bot\"}}";
+
+// File server and Bot API methods used by TelegramOTA
+static void otaServer(MockClient &client, const char *request, size_t len)
+{
+  (void)len;
+  const char *range = strstr(request, "Range: bytes=");
+  if (strncmp(request, "GET /file/bot", 13) == 0 && range != nullptr) {
+    const size_t from = strtoul(range + 13, nullptr, 10);
+    const char *dash = strchr(range + 13, '-');
+    size_t to = dash != nullptr && dash[1] != '\r' ? strtoul(dash + 1, nullptr, 10) : IMAGE_SIZE - 1;
+    if (to >= IMAGE_SIZE)
+      to = IMAGE_SIZE - 1;
+    char header[160];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 206 Partial Content\r\nContent-Length: %u\r\nContent-Range: bytes %u-%u/%u\r\n"
+             "Connection: keep-alive\r\n\r\n", (unsigned)(to + 1 - from), (unsigned)from, (unsigned)to, IMAGE_SIZE);
+    std::string reply(header);
+    reply.append((const char *)image + from, to + 1 - from);
+    client.addReply((const uint8_t *)reply.data(), reply.size());
+  }
+  else if (strstr(request, "/getFile ") != nullptr) {
+    char body[160];
+    snprintf(body, sizeof(body), "{\"ok\":true,\"result\":{\"file_id\":\"BQACAgQ\",\"file_unique_id\":\"AgAD\","
+             "\"file_size\":%u,\"file_path\":\"documents/file_12.bin\"}}", IMAGE_SIZE);
+    client.addJsonReply(body);
+  }
+  else if (strstr(request, "/sendMessage ") != nullptr)
+    client.addJsonReply("{\"ok\":true,\"result\":{\"message_id\":77,\"chat\":{\"id\":123456789,\"type\":\"private\"},\"date\":1620000000}}");
+  else
+    client.addJsonReply("{\"ok\":true,\"result\":true}");
+}
+
+struct OtaBot
+{
+  MockClient server;
+  AsyncTelegramBot bot;
+  TBMessage msg;
+
+  OtaBot() : bot(server) {
+    for (size_t i = 0; i < IMAGE_SIZE; i++)
+      image[i] = (uint8_t)(i * 7 + (i >> 8));
+    HostFS.remove(IMAGE_FILE);
+    bot.setClock(MockClient::getTime);
+    bot.setTelegramToken("123456789:AAbbccddeeffgghhiijjkkllmmnnooppqqr");
+    server.addJsonReply(getMeReply);
+    CHECK(bot.begin());
+  }
+
+  // receive the firmware as document message
+  bool receive(const char *fileName, const char *caption) {
+    char update[512];
+    snprintf(update, sizeof(update),
+             "{\"ok\":true,\"result\":[{\"update_id\":100001,\"message\":{\"message_id\":1234,"
+             "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+             "\"chat\":{\"id\":123456789,\"type\":\"private\"},\"date\":1620000000,"
+             "\"document\":{\"file_name\":\"%s\",\"file_id\":\"BQACAgQ\",\"file_unique_id\":\"AgAD\",\"file_size\":%u},"
+             "\"caption\":\"%s\"}}]}", fileName, IMAGE_SIZE, caption);
+    server.addJsonReply(update);
+    MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+    const bool received = bot.getNewMessage(msg) == MessageDocument;
+    server.onRequest(otaServer);
+    return received;
+  }
+
+  // next update is a callback query (ex. the confirmation button of the OTA examples)
+  bool receiveQuery(TBMessage &query) {
+    server.addJsonReply("{\"ok\":true,\"result\":[{\"update_id\":100002,\"callback_query\":{\"id\":\"4382bfdwdsb323b2d9\","
+                        "\"from\":{\"id\":123456789,\"is_bot\":false,\"first_name\":\"John\"},"
+                        "\"message\":{\"message_id\":1235,\"chat\":{\"id\":123456789,\"type\":\"private\"},"
+                        "\"date\":1620000001,\"text\":\"Start firmware update?\"},"
+                        "\"chat_instance\":\"-7654321987654321\",\"data\":\"CONFIRM_UPDATE\"}}]}");
+    MockClient::advanceTime(MIN_UPDATE_TIME + 1);
+    return bot.getNewMessage(query) == MessageQuery;
+  }
+
+  OTAResult update() { return update(msg); }
+
+  OTAResult update(TBMessage &document) {
+    File file = HostFS.open(IMAGE_FILE, "w");
+    StreamUpdateSink sink(file);
+    TelegramOTA ota(bot, sink);
+    const OTAResult result = ota.update(document);
+    file.close();
+    return result;
+  }
+
+  // bytes of image written to file (size if the whole image)
+  size_t imageWritten() {
+    File file = HostFS.open(IMAGE_FILE, "r");
+    size_t n = 0;
+    for (int c = file.read(); c >= 0 && n < IMAGE_SIZE && c == image[n]; c = file.read())
+      n++;
+    return file.size() == n ? n : 0;
+  }
+};
+
+TEST(imageWrittenToFile)
+{
+  OtaBot o;
+  CHECK(o.receive("firmware.bin", "v2.1 sha256 " IMAGE_SHA256));
+  CHECK(o.update() == OTA_OK);
+  CHECK(o.imageWritten() == IMAGE_SIZE);
+  // getFile, three segments, progress message and its edits
+  CHECK(o.server.getRequests().find("Range: bytes=131072-149999") != std::string::npos);
+  CHECK(o.server.getRequests().find("verified SHA-256") != std::string::npos);
+}
+
+TEST(updateAfterConfirmation)
+{
+  // Document message saved, update started when the next update confirms it
+  OtaBot o;
+  CHECK(o.receive("firmware.bin", "v2.1 sha256 " IMAGE_SHA256));
+  TBMessage document = o.msg;
+  TBMessage query;
+  CHECK(o.receiveQuery(query));
+  CHECK(strcmp(document.document.file_name, "firmware.bin") == 0);
+  CHECK(o.update(document) == OTA_OK);
+  CHECK(o.imageWritten() == IMAGE_SIZE);
+}
+
+TEST(longNameKeepsExtension)
+{
+  OtaBot o;
+  CHECK(o.receive("firmware_of_the_weather_station_in_the_garden_built_on_2026_10_18_release.bin", IMAGE_SHA256));
+  CHECK(strlen(o.msg.document.file_name) == TB_FILE_NAME_SIZE - 1);
+  CHECK(strncmp(o.msg.document.file_name, "firmware_of_the", 15) == 0);
+  CHECK(o.update() == OTA_OK);
+}
+
+TEST(hashMismatchIsNotCompleted)
+{
+  OtaBot o;
+  CHECK(o.receive("firmware.bin", "0000000000000000000000000000000000000000000000000000000000000000"));
+  CHECK(o.update() == OTA_HASH_MISMATCH);
+  // Last chunks are never written
+  CHECK(o.imageWritten() < IMAGE_SIZE);
+}
+
+TEST(missingHashIsRefused)
+{
+  OtaBot o;
+  CHECK(o.receive("firmware.bin", "new firmware"));
+  CHECK(o.update() == OTA_NO_HASH);
+  CHECK(o.server.getRequests().find("/getFile ") == std::string::npos);
+}
+
+TEST(documentNameMustBeBin)
+{
+  // Server path ends with .bin, the name of document doesn't
+  OtaBot o;
+  CHECK(o.receive("notes.txt", IMAGE_SHA256));
+  o.server.clearRequests();
+  CHECK(o.update() == OTA_NO_FIRMWARE);
+  CHECK(o.server.getRequests().empty());
+}
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""Round trip of TBLog dumps: the dumps written by LogTest (binary and hex text), decoded by
+extras/log_decoder with the source of LogTest, must give the text printed on the board.
+
+    log_decoder_test.py <log_decoder.py> <LogTest.cpp>      (run in the working directory of LogTest)
+"""
+
+import subprocess
+import sys
+
+
+def decode(decoder, dump, source):
+    result = subprocess.run([sys.executable, decoder, dump, source], stdout=subprocess.PIPE, check=True)
+    return result.stdout.decode().splitlines()
+
+
+def main():
+    decoder, source = sys.argv[1:3]
+    with open("log_printed.txt", "rb") as f:
+        printed = f.read().decode().splitlines()
+    if not printed:
+        sys.exit("log_printed.txt is empty: run LogTest first")
+
+    failed = False
+    for dump in ("log_dump.bin", "log_dump.txt"):
+        decoded = decode(decoder, dump, source)
+        if decoded != printed:
+            failed = True
+            print("%s decoded differently from the board:" % dump)
+            for board, host in zip(printed, decoded):
+                if board != host:
+                    print("  board: %s\n  host:  %s" % (board, host))
+            if len(decoded) != len(printed):
+                print("  %d records on the board, %d decoded" % (len(printed), len(decoded)))
+    print("FAIL" if failed else "%d records decoded as printed on the board" % len(printed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Decode the ring log written by TBLog (library compiled with TB_LOG_ENABLE true).
+
+Records store only the id of the format string (FNV-1a hash): formats are found in
+the source files (library and sketch) given on command line.
+
+    log_decoder.py dump.bin ../../src MySketch/           decode a dump (binary or hex text)
+    log_decoder.py dump.txt ../../src --last 30           only the last 30 seconds
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"TBLOG1\n"
+HEADER_SIZE = 10
+SOURCE_EXT = (".c", ".cpp", ".h", ".hpp", ".ino")
+CALL_RE = re.compile(rb"\b(?:log_debug|log_error|log_info)\s*\(|\bTB_LOG\s*\(\s*'[^']+'\s*,")
+LITERAL_RE = re.compile(rb'\s*"((?:[^"\\\n]|\\.)*)"', re.S)
+SPEC_RE = re.compile(r"%([-+ #0]*)(\d*)(\.\d+)?(?:hh|h|ll|l|L|q|j|z|t)?([diouxXcsfFeEgGaAp%])")
+ESCAPES = {b"n": b"\n", b"t": b"\t", b"r": b"\r", b"0": b"\0", b"\\": b"\\", b'"': b'"', b"'": b"'",
+           b"a": b"\a", b"b": b"\b", b"f": b"\f", b"v": b"\v", b"?": b"?"}
+
+
+def fnv1a(data):
+    h = 2166136261
+    for c in data:
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    out = bytearray()
+    i = 0
+    while i < len(literal):
+        c = literal[i:i + 1]
+        if c != b"\\":
+            out += c
+            i += 1
+            continue
+        e = literal[i + 1:i + 2]
+        if e == b"x":
+            m = re.match(rb"[0-9a-fA-F]+", literal[i + 2:])
+            out.append(int(m.group(0), 16) & 0xFF)
+            i += 2 + len(m.group(0))
+        elif e in b"01234567" and e:
+            m = re.match(rb"[0-7]{1,3}", literal[i + 1:])
+            out.append(int(m.group(0), 8) & 0xFF)
+            i += 1 + len(m.group(0))
+        else:
+            out += ESCAPES.get(e, e)
+            i += 2
+    return bytes(out)
+
+
+def load_formats(paths):
+    """Map format id -> format string, for every log call with a string literal"""
+    formats = {}
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                files += [os.path.join(root, n) for n in names if n.endswith(SOURCE_EXT)]
+        else:
+            files.append(path)
+    for name in files:
+        with open(name, "rb") as f:
+            source = f.read()
+        for call in CALL_RE.finditer(source):
+            # Adjacent literals are joined by compiler. log_debug() has an empty format
+            pos = call.end()
+            text = b""
+            while True:
+                m = LITERAL_RE.match(source, pos)
+                if not m:
+                    break
+                text += unescape(m.group(1))
+                pos = m.end()
+            formats[fnv1a(text)] = text.decode("utf-8", "replace")
+    return formats
+
+
+def read_dump(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data.startswith(MAGIC):
+        # Hexadecimal text copied from serial monitor
+        data = bytes.fromhex(re.sub(rb"[^0-9a-fA-F]", b"", data).decode())
+    if not data.startswith(MAGIC):
+        sys.exit("%s: not a TBLog dump" % path)
+    return data[len(MAGIC):]
+
+
+def records(data):
+    pos = 0
+    while pos + HEADER_SIZE <= len(data):
+        size = data[pos]
+        if size < HEADER_SIZE:
+            break
+        level, ms, fid = struct.unpack_from("<cII", data, pos + 1)
+        yield level.decode("latin-1"), ms, fid, parse_args(data[pos + HEADER_SIZE:pos + size])
+        pos += size
+
+
+def parse_args(data):
+    args = []
+    pos = 0
+    while pos < len(data):
+        kind = chr(data[pos])
+        pos += 1
+        if kind in "iuIUf":
+            fmt = {"i": "<i", "u": "<I", "I": "<q", "U": "<Q", "f": "<d"}[kind]
+            args.append(struct.unpack_from(fmt, data, pos)[0])
+            pos += struct.calcsize(fmt)
+        elif kind == "s":
+            n = data[pos]
+            args.append(data[pos + 1:pos + 1 + n].decode("utf-8", "replace"))
+            pos += 1 + n
+        else:
+            break
+    return args
+
+
+def format_record(fmt, args):
+    args = list(args)
+
+    def convert(m):
+        flags, width, precision, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if not args:
+            return "?"
+        value = args.pop(0)
+        if conv in "fFeEgGaA":
+            return ("%" + flags + width + (precision or "") + {"a": "g", "A": "G"}.get(conv, conv)) % float(value)
+        if conv == "s":
+            return ("%" + flags + width + (precision or "") + "s") % value
+        if conv == "c":
+            return chr(int(value) & 0xFF)
+        if conv == "p":
+            return "%x" % int(value)
+        value = int(value) if not isinstance(value, str) else 0
+        if conv in "uxXo" and value < 0:
+            value &= 0xFFFFFFFF
+        return ("%" + flags + width + (precision or "") + {"i": "d", "u": "d"}.get(conv, conv)) % value
+
+    return SPEC_RE.sub(convert, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="output of TBLog::dump() (binary or hex text)")
+    parser.add_argument("sources", nargs="+", help="source files or folders with log calls")
+    parser.add_argument("--last", type=float, default=0, help="only records of last seconds")
+    args = parser.parse_args()
+
+    formats = load_formats(args.sources)
+    entries = list(records(read_dump(args.dump)))
+    end = entries[-1][1] if entries else 0
+    for level, ms, fid, values in entries:
+        if args.last and end - ms > args.last * 1000:
+            continue
+        fmt = formats.get(fid)
+        if fmt is None:
+            text = "<format %08x> %s" % (fid, " ".join(str(v) for v in values))
+        else:
+            text = format_record(fmt.lstrip("\n"), values).rstrip("\n")
+        print("[%s][%d] %s" % (level, ms, text))
+
+
+if __name__ == "__main__":
+    main()
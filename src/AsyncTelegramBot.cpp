@@ -1,4 +1,10 @@
 #include "AsyncTelegramBot.h"
+#include <utility>
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#elif defined(ESP32)
+#include <WiFi.h>
+#endif
 
 #if DEBUG_ENABLE
 #define debugJson(X, Y)            \
@@ -19,19 +25,84 @@
 #define errorJson(E)
 #endif
 
-#define HEADERS_END "\r\n\r\n"
+// Print that collects data in a buffer and writes it to client when the buffer is full
+class BlockWriter : public Print
+{
+public:
+    BlockWriter(Client &client, uint8_t *block, size_t size, size_t used) :
+        m_client(client), m_block(block), m_size(size), m_used(used) {}
 
-AsyncTelegramBot::AsyncTelegramBot(Client &client)
+    size_t write(uint8_t data) override { return write(&data, 1); }
+    size_t write(const uint8_t *data, size_t len) override
+    {
+        for (size_t done = 0; done < len;)
+        {
+            if (m_used == m_size && !writeBlock())
+                return done;
+            size_t n = m_size - m_used;
+            if (n > len - done)
+                n = len - done;
+            memcpy(m_block + m_used, data + done, n);
+            m_used += n;
+            done += n;
+        }
+        return len;
+    }
+
+    // write data collected (if any)
+    bool writeBlock()
+    {
+        if (m_used && m_client.write(m_block, m_used) != m_used)
+            return false;
+        m_sent += m_used;
+        m_used = 0;
+        return true;
+    }
+    inline size_t sent() const { return m_sent; }
+
+private:
+    Client     &m_client;
+    uint8_t    *m_block;
+    size_t      m_size;
+    size_t      m_used;
+    size_t      m_sent = 0;
+};
+
+AsyncTelegramBotBase::AsyncTelegramBotBase(Client &client, JsonDocument &rxDoc, JsonDocument &txDoc, JsonDocument &auxDoc,
+                                           char *rxBuffer, size_t rxSize, uint8_t *block, size_t blockSize,
+                                           InlineKeyboard **keyboards, uint8_t maxKeyboards,
+                                           TBAllocator &allocator) :
+    m_allocator(allocator), m_rxbuffer(rxBuffer), m_rxSize(rxSize), m_block(block), m_blockSize(blockSize),
+    m_rxDoc(rxDoc), m_txDoc(txDoc), m_auxDoc(auxDoc),
+    m_keyboards(keyboards), m_maxKeyboards(maxKeyboards)
 {
-    m_botusername.reserve(32); // Telegram username is 5-32 chars lenght
-    m_rxbuffer.reserve(BUFFER_BIG);
+    m_botusername[0] = '\0';
     this->telegramClient = &client;
     m_minUpdateTime = MIN_UPDATE_TIME;
 }
 
-AsyncTelegramBot::~AsyncTelegramBot(){};
+AsyncTelegramBotBase::~AsyncTelegramBotBase(){};
 
-bool AsyncTelegramBot::checkConnection()
+TBAllocatedStorage::TBAllocatedStorage(TBAllocator &allocator, size_t rxSize, size_t docSize, size_t auxDocSize,
+                                       size_t chunkSize, uint8_t maxKeyboards) :
+    m_storageAllocator(allocator),
+    m_rxDocStorage(docSize, TBJsonAllocator(allocator)),
+    m_txDocStorage(docSize, TBJsonAllocator(allocator)),
+    m_auxDocStorage(auxDocSize, TBJsonAllocator(allocator))
+{
+    m_rxStorage = (char *)allocator.allocate(rxSize);
+    m_blockStorage = (uint8_t *)allocator.allocate(chunkSize);
+    m_keyboardStorage = (InlineKeyboard **)allocator.allocate(maxKeyboards * sizeof(InlineKeyboard *));
+}
+
+TBAllocatedStorage::~TBAllocatedStorage()
+{
+    m_storageAllocator.deallocate(m_rxStorage);
+    m_storageAllocator.deallocate(m_blockStorage);
+    m_storageAllocator.deallocate(m_keyboardStorage);
+}
+
+bool AsyncTelegramBotBase::checkConnection(bool resume)
 {
 #if DEBUG_ENABLE
     static uint32_t lastCTime;
@@ -39,111 +110,440 @@ bool AsyncTelegramBot::checkConnection()
     // Start connection with Telegramn server (if necessary)
     if (!telegramClient->connected())
     {
+        // Server unreachable: don't hammer it with handshakes.
+        // An interrupted transfer retries at once (its attempts are already limited) until the breaker opens
+        if (!connectAllowed() && !(resume && m_health.state != BreakerOpen))
+            return false;
         telegramClient->flush();
         telegramClient->clearWriteError();
         telegramClient->stop();
         telegramClient->stop();
-        m_lastmsg_timestamp = millis();
+        m_lastmsg_timestamp = now();
         log_debug("Start handshaking...");
-        if (!telegramClient->connect(TELEGRAM_HOST, TELEGRAM_PORT))
+        TB_TRACE_START(t);
+        IPAddress ip;
+        const bool byAddress = serverAddress(ip);
+        TLSSession *session = sendingConnection() ? m_sendSession : m_session;
+        if (session != nullptr)
+            session->beforeConnect();
+        const uint32_t start = now();
+        if (!(byAddress ? telegramClient->connect(ip, m_port) : telegramClient->connect(m_host, m_port)))
         {
+            m_stats.connectFailures++;
+            connectionFailed();
+            // Address could be stale: resolve it again (or try next fallback IP) at next connection
+            if (byAddress)
+            {
+                m_dnsValid = false;
+                m_fallbackIndex++;
+            }
+            // Saved session could be the cause (ex. expired on server): next handshake is a full one
+            if (session != nullptr)
+                session->clear();
             Serial.printf("\n\nUnable to connect to Telegram server\n");
         }
-#if DEBUG_ENABLE
         else
         {
+            const uint32_t elapsed = now() - start;
+            m_stats.handshakes++;
+            if (!m_background)
+                m_stats.criticalHandshakes++;
+            m_stats.handshakeTime += elapsed;
+            if (elapsed > m_stats.handshakeTimeMax)
+                m_stats.handshakeTimeMax = elapsed;
+            if (session != nullptr && session->resumed())
+            {
+                m_stats.resumedHandshakes++;
+                m_stats.resumedHandshakeTime += elapsed;
+                log_debug("TLS session resumed in %lu ms", (unsigned long)elapsed);
+            }
+            TB_TRACE(TraceConnect, t);
+#if TB_TRACE_ENABLE
+            // Request phases that follow are timed from here (handshake excluded)
+            m_traceTime = t;
+#endif
+#if DEBUG_ENABLE
             log_debug("Connected using Telegram hostname\n"
                       "Last connection was %d seconds ago\n",
-                      (int)(millis() - lastCTime) / 1000);
-            lastCTime = millis();
-        }
+                      (int)(now() - lastCTime) / 1000);
+            lastCTime = now();
 #endif
+        }
     }
     return telegramClient->connected();
 }
 
-bool AsyncTelegramBot::begin()
+bool AsyncTelegramBotBase::begin()
 {
+    // Storage provided by an allocator could be missing
+    if (m_rxbuffer == nullptr || m_block == nullptr || m_keyboards == nullptr ||
+        !m_rxDoc.capacity() || !m_txDoc.capacity() || !m_auxDoc.capacity())
+    {
+        log_error("Unable to allocate bot buffers");
+        return false;
+    }
     checkConnection();
     return getMe();
 }
 
-bool AsyncTelegramBot::reset(void)
+bool AsyncTelegramBotBase::reset(void)
 {
     log_debug("Restart Telegram connection\n");
     telegramClient->stop();
-    m_lastmsg_timestamp = millis();
+    m_stats.reconnects++;
+    m_statsMethod = -1;
+#if TB_TRACE_ENABLE
+    m_traceMethod = -1;
+#endif
+    m_lastmsg_timestamp = now();
     m_waitingReply = false;
+    m_idleConnected = false;
+    // Queued getFile request (if any) fails: its reply is lost with the connection
+    if (!sendingConnection())
+        endFileRequest(JsonVariant());
     return checkConnection();
 }
 
-bool AsyncTelegramBot::sendCommand(const char *const &command, const char *payload, bool blocking)
+bool AsyncTelegramBotBase::sendCommand(const char *const &command, const char *payload, bool blocking)
 {
+    return sendRequest(command, payload, nullptr, blocking);
+}
+
+bool AsyncTelegramBotBase::sendCommand(const char *const &command, const JsonDocument &payload, bool blocking)
+{
+    debugJson(payload, Serial);
+    // Part of the payload was lost: don't send it truncated
+    if (payload.overflowed())
+    {
+        log_error("Payload of %s exceeds JSON document capacity", command);
+        m_result = {};
+        m_result.status = -1;
+        m_result.errorCode = -1;
+        snprintf(m_result.description, sizeof(m_result.description), "Payload exceeds JSON document capacity");
+        return false;
+    }
+    return sendRequest(command, nullptr, &payload, blocking);
+}
+
+bool AsyncTelegramBotBase::sendRequest(const char *command, const char *payload, const JsonDocument *doc, bool blocking)
+{
+    // Dual connection mode: one request at a time on sending connection
+    readSendReply(true);
+    // Connection (if needed) is traced as a phase of this request
+    TB_TRACE_METHOD(command);
     if (checkConnection())
     {
-        String httpBuffer((char *)0);
-        httpBuffer.reserve(BUFFER_BIG);
-        httpBuffer = "POST https://" TELEGRAM_HOST "/bot";
-        httpBuffer += m_token;
-        httpBuffer += "/";
-        httpBuffer += command;
+        // Request is built in chunk buffer (no heap allocation).
         // Let's use 1.0 protocol in order to avoid chunked transfer encoding
-        httpBuffer += " HTTP/1.0"
-                      "\nHost: api.telegram.org"
-                      "\nConnection: keep-alive"
-                      "\nContent-Type: application/json";
-        httpBuffer += "\nContent-Length: ";
-        httpBuffer += strlen(payload);
-        httpBuffer += "\n\n";
-        httpBuffer += payload;
+        const size_t payloadLen = doc != nullptr ? measureJson(*doc) : strlen(payload);
+        char *request = (char *)m_block;
+        size_t len = snprintf(request, m_blockSize,
+                              "POST /bot%s/%s HTTP/1.0"
+                              "\nHost: %s"
+                              "\nConnection: keep-alive"
+                              "\nContent-Type: application/json"
+                              "\nContent-Length: %u\n\n",
+                              m_token, command, m_host, (unsigned)payloadLen);
         // Send the whole request in one go is much faster
-        telegramClient->print(httpBuffer);
-        //Serial.println(httpBuffer);
+        bool sent;
+        if (doc != nullptr)
+        {
+            // Payload is serialized after the header, a chunk buffer at a time
+            BlockWriter writer(*telegramClient, m_block, m_blockSize, len);
+            serializeJson(*doc, writer);
+            sent = writer.writeBlock() && writer.sent() == len + payloadLen;
+            TB_TRACE(TraceBodyWrite, m_traceTime);
+        }
+        else if (len + payloadLen < m_blockSize)
+        {
+            memcpy(request + len, payload, payloadLen);
+            sent = telegramClient->write(m_block, len + payloadLen) == len + payloadLen;
+            TB_TRACE(TraceHeaderWrite, m_traceTime);
+        }
+        else
+        {
+            sent = telegramClient->write(m_block, len) == len;
+            TB_TRACE(TraceHeaderWrite, m_traceTime);
+            sent = sent && telegramClient->write((const uint8_t *)payload, payloadLen) == payloadLen;
+            TB_TRACE(TraceBodyWrite, m_traceTime);
+        }
+        statsRequest(command, len + payloadLen);
+        if (!sent)
+        {
+            log_error("Request not sent, write error");
+            statsReply(-1);
+            telegramClient->stop();
+            return false;
+        }
 
         m_waitingReply = true;
+        m_requestTime = now();
         // Blocking mode
         if (blocking)
+            return readReply();
+    }
+    return false;
+}
+
+bool AsyncTelegramBotBase::readReply()
+{
+    size_t contentLength;
+    bool closed;
+    const int status = readHeaders(contentLength, closed, m_replyTimeout);
+    m_waitingReply = false;
+    statsReply(status);
+    if (status == 0)
+    {
+        telegramClient->stop();
+        return false;
+    }
+    readBody(contentLength);
+    if (closed)
+        telegramClient->stop();
+    return decodeResult();
+}
+
+void AsyncTelegramBotBase::readSendReply(bool wait)
+{
+    if (!sendingConnection() || !m_waitingReply)
+        return;
+    if (wait || (telegramClient->connected() && telegramClient->available()))
+        readReply();
+    else if (!telegramClient->connected() || now() - m_requestTime > m_replyTimeout)
+    {
+        log_error("No reply from server in %lu ms", (unsigned long)m_replyTimeout);
+        m_waitingReply = false;
+        statsReply(0);
+        telegramClient->stop();
+    }
+}
+
+void AsyncTelegramBotBase::setSendClient(Client &client, TLSSession *session)
+{
+    m_sendSession = session;
+    if (m_otherClient != nullptr)
+    {
+        telegramClient->stop();
+        telegramClient = &client;
+        m_waitingReply = false;
+        return;
+    }
+    // Telegram client becomes the polling connection, parked until next polling
+    m_otherClient = &client;
+    m_otherLastMsg = now();
+    m_polling = true;
+    selectConnection(false);
+}
+
+void AsyncTelegramBotBase::selectConnection(bool polling)
+{
+    if (m_otherClient == nullptr || polling == m_polling)
+        return;
+    std::swap(telegramClient, m_otherClient);
+    std::swap(m_waitingReply, m_otherWaiting);
+    std::swap(m_requestTime, m_otherRequestTime);
+    std::swap(m_statsMethod, m_otherStatsMethod);
+    std::swap(m_idleConnected, m_otherIdleConnected);
+    std::swap(m_lastActivity, m_otherActivity);
+    std::swap(m_lastmsg_timestamp, m_otherLastMsg);
+#if TB_TRACE_ENABLE
+    std::swap(m_traceMethod, m_otherTraceMethod);
+    std::swap(m_traceTime, m_otherTraceTime);
+#endif
+    m_polling = polling;
+}
+
+int AsyncTelegramBotBase::readHeaders(size_t &contentLength, bool &closed, uint32_t timeout)
+{
+    int status = 0;
+    contentLength = 0;
+    closed = false;
+    char line[128];
+    uint32_t startTime = now();
+    bool firstByte = true;
+    while (telegramClient->connected() && now() - startTime < timeout)
+    {
+        if (!telegramClient->available())
+        {
+            yield();
+            continue;
+        }
+        if (firstByte)
+        {
+            TB_TRACE(TraceFirstByte, m_traceTime);
+            firstByte = false;
+        }
+        size_t len = telegramClient->readBytesUntil('\n', line, sizeof(line) - 1);
+        line[len] = '\0';
+        m_stats.bytesReceived += len + 1;
+        // Empty line: end of headers
+        if (len == 0 || (len == 1 && line[0] == '\r'))
+            return status;
+        if (status == 0 && strncmp(line, "HTTP/1.", 7) == 0)
+            status = atoi(line + 9);
+        else if (strncasecmp(line, "Content-Length:", 15) == 0)
+            contentLength = strtoul(line + 15, nullptr, 10);
+        else if (strncasecmp(line, "Connection:", 11) == 0 && strstr(line + 11, "close") != nullptr)
+            closed = true;
+    }
+    log_error("Invalid HTTP response");
+    return 0;
+}
+
+size_t AsyncTelegramBotBase::readBody(size_t contentLength)
+{
+    m_rxLen = 0;
+    size_t received = 0;
+    uint32_t lastByteTime = now();
+    while (!contentLength || received < contentLength)
+    {
+        const int avail = telegramClient->available();
+        size_t n = avail > 0 ? avail : 0;
+        if (n == 0)
         {
-            if (!telegramClient->find((char *)HEADERS_END))
+            // Without Content-Length, only bytes already received are read
+            if (!contentLength)
+                break;
+            // Body arrives in more segments: wait for the rest, but not forever
+            if (!telegramClient->connected() || now() - lastByteTime > m_replyTimeout)
             {
-                log_error("Invalid HTTP response");
+                log_error("Reply incomplete (%u of %u bytes)", (unsigned)received, (unsigned)contentLength);
                 telegramClient->stop();
-                return false;
-            }
-            // If there are incoming bytes available from the server, read them and print them:
-            m_rxbuffer = "";
-            while (telegramClient->available())
-            {
-                yield();
-                m_rxbuffer += (char)telegramClient->read();
+                break;
             }
-            m_waitingReply = false;
-            if (m_rxbuffer.indexOf("ok") > -1)
-                return true;
+            yield();
+            continue;
+        }
+        if (contentLength && n > contentLength - received)
+            n = contentLength - received;
+
+        // Keep space for string terminator, exceeding bytes are discarded (chunk buffer is free now)
+        int len;
+        if (m_rxLen < m_rxSize - 1)
+        {
+            n = n < m_rxSize - 1 - m_rxLen ? n : m_rxSize - 1 - m_rxLen;
+            len = telegramClient->read((uint8_t *)m_rxbuffer + m_rxLen, n);
+            if (len > 0)
+                m_rxLen += len;
+        }
+        else
+            len = telegramClient->read(m_block, n < m_blockSize ? n : m_blockSize);
+        if (len > 0)
+        {
+            received += len;
+            lastByteTime = now();
         }
     }
-    return false;
+    m_stats.bytesReceived += received;
+    TB_TRACE(TraceBodyRead, m_traceTime);
+    m_rxbuffer[m_rxLen] = '\0';
+    if (received > m_rxLen)
+    {
+        log_error("Reply exceeds buffer size (%u bytes)", (unsigned)m_rxSize);
+        m_stats.truncatedReplies++;
+        m_result.truncated = true;
+    }
+    return m_rxLen;
+}
+
+void AsyncTelegramBotBase::prewarm()
+{
+    if (!m_prewarm || m_waitingReply || m_lastActivity == 0)
+        return;
+    const uint32_t idle = now() - m_lastActivity;
+    const bool connected = telegramClient->connected();
+    if (connected)
+    {
+        m_idleConnected = true;
+        // Server is going to close this idle connection: replace it before a request finds it closed
+        if (m_idleClose == 0 || idle < m_idleClose - m_idleClose / 8)
+            return;
+    }
+    // Closed by server while idle: learn its idle timeout (short times are network errors)
+    else if (m_idleConnected && idle >= PREWARM_MIN_IDLE)
+    {
+        m_idleClose = m_idleClose ? (3 * m_idleClose + idle) / 4 : idle;
+        m_idleConnected = false;
+        log_debug("Connection closed by server after %lu ms idle", (unsigned long)idle);
+    }
+
+    // The new connection must last until next polling request, otherwise it would be closed
+    // again while idle: at most one handshake for each polling interval.
+    // Sending connection (dual mode) has no such bound, it's kept ready for the sketch
+    const int32_t nextPoll = (int32_t)(m_lastUpdateTime + m_minUpdateTime - now());
+    if (!sendingConnection() && m_idleClose && nextPoll > (int32_t)(m_idleClose - m_idleClose / 8))
+        return;
+    if (connected)
+    {
+        log_debug("Idle for %lu ms, renew connection", (unsigned long)idle);
+        telegramClient->stop();
+    }
+    m_idleConnected = false;
+#if TB_TRACE_ENABLE
+    m_traceMethod = -1;
+#endif
+    if (checkConnection())
+    {
+        m_stats.prewarms++;
+        m_lastActivity = now();
+    }
+}
+
+bool AsyncTelegramBotBase::getUpdates()
+{
+    // Dual connection mode: polling requests and their replies use the polling connection
+    selectConnection(true);
+    const bool updates = pollUpdates();
+    selectConnection(false);
+
+    // Sending connection is prepared for next request of the sketch too
+    if (!updates && m_otherClient != nullptr)
+        prewarm();
+    return updates;
 }
 
-bool AsyncTelegramBot::getUpdates()
+bool AsyncTelegramBotBase::pollUpdates()
 {
+    // Long polling (dual connection mode): server holds the request until an update arrives
+    const uint16_t longPoll = m_otherClient != nullptr ? m_longPoll : 0;
+    const uint32_t holdTime = longPoll * 1000UL;
+
     // No response from Telegram server for a long time
-    if (millis() - m_lastmsg_timestamp > 10 * m_minUpdateTime)
+    if (now() - m_lastmsg_timestamp > 10 * m_minUpdateTime + holdTime)
     {
+        if (m_waitingReply)
+            statsReply(0);
+        reset();
+    }
+    // Reply to last request is lost (ex. stalled socket)
+    else if (m_waitingReply && now() - m_requestTime > m_replyTimeout + holdTime)
+    {
+        log_error("No reply from server in %lu ms", (unsigned long)m_replyTimeout);
+        statsReply(0);
         reset();
     }
 
     // Send message to Telegram server only if enough time has passed since last
-    if (millis() - m_lastUpdateTime > m_minUpdateTime)
+    if (now() - m_lastUpdateTime > m_minUpdateTime)
     {
-        m_lastUpdateTime = millis();
+        m_lastUpdateTime = now();
 
         // If previuos reply from server was received (and parsed)
         if (m_waitingReply == false)
         {
             char payload[BUFFER_SMALL];
-            snprintf(payload, BUFFER_SMALL, "{\"limit\":1,\"timeout\":0,\"offset\":%ld}", m_lastUpdateId);
-            sendCommand("getUpdates", payload);
+            // A queued file request takes the place of this polling request
+            if (m_fileRequest != nullptr && !m_fileRequestSent)
+            {
+                snprintf(payload, BUFFER_SMALL, "{\"file_id\":\"%s\"}", m_fileRequest->file_id.c_str());
+                sendCommand("getFile", payload);
+                m_fileRequestSent = m_waitingReply;
+            }
+            else
+            {
+                snprintf(payload, BUFFER_SMALL, "{\"limit\":1,\"timeout\":%u,\"offset\":%ld}", (unsigned)longPoll, (long)m_lastUpdateId);
+                sendCommand("getUpdates", payload);
+            }
         }
     }
 
@@ -151,26 +551,21 @@ bool AsyncTelegramBot::getUpdates()
     {
         // We have a message, parse data received
         bool close_connection = false;
+        size_t contentLength;
 
         // Skip headers
-        while (telegramClient->connected())
+        const int status = readHeaders(contentLength, close_connection, m_replyTimeout);
+        statsReply(status);
+        if (status == 0)
         {
-            String line = telegramClient->readStringUntil('\n');
-            if (line == "\r")
-                break;
-            if (line.indexOf("close") > -1)
-                close_connection = true;
+            reset();
+            return false;
         }
 
-        // If there are incoming bytes available from the server, read them and store:
-        m_rxbuffer = "";
-        while (telegramClient->available())
-        {
-            yield();
-            m_rxbuffer += (char)telegramClient->read();
-        }
+        // Read the whole body (Content-Length), even if it arrives in more segments
+        readBody(contentLength);
         m_waitingReply = false;
-        m_lastmsg_timestamp = millis();
+        m_lastmsg_timestamp = now();
 
         if (close_connection)
         {
@@ -178,27 +573,52 @@ bool AsyncTelegramBot::getUpdates()
             log_debug("Connection closed from server");
         }
 
-        if (m_rxbuffer.indexOf("ok") < 0)
+        if (!decodeResult())
         {
-            log_error("%s", m_rxbuffer.c_str());
+            // Error reply to getFile: document is not resolved (error is kept in m_result)
+            if (m_fileRequestSent)
+                endFileRequest(JsonVariant());
             return false;
         }
         return true;
     }
+
+    // Nothing to do: time to prepare the connection for next request
+    prewarm();
     return false;
 }
 
 // Parse message received from Telegram server
-MessageType AsyncTelegramBot::getNewMessage(TBMessage &message)
+MessageType AsyncTelegramBotBase::getNewMessage(TBMessage &message)
 {
+    TB_HEAP_SCOPE("getNewMessage");
     message.messageType = MessageNoData;
 
+    // Dual connection mode: reply to last request of the sketch (reply buffer is free now)
+    readSendReply();
+
+    // Connections opened while polling are not on the critical path of sketch requests
+    m_background = true;
+    const bool updates = getUpdates();
+    m_background = false;
+
     // We have a message, parse data received
-    if (getUpdates())
+    if (updates)
     {
-        DynamicJsonDocument updateDoc(BUFFER_BIG);
-        deserializeJson(updateDoc, m_rxbuffer);
-        m_rxbuffer = "";
+        // Parse a const buffer: strings are copied in document, so buffer can be reused
+        JsonDocument &updateDoc = m_rxDoc;
+        TB_TRACE_START(t);
+        if (deserializeJson(updateDoc, (const char *)m_rxbuffer, m_rxLen))
+            m_stats.parseFailures++;
+        TB_TRACE(TraceParse, t);
+        m_rxLen = 0;
+
+        // This is the reply to a queued getFile request (without file_path the request failed)
+        if (m_fileRequestSent)
+        {
+            endFileRequest(updateDoc["result"]);
+            return MessageNoData;
+        }
 
         if (!updateDoc.containsKey("result"))
         {
@@ -227,12 +647,14 @@ MessageType AsyncTelegramBot::getNewMessage(TBMessage &message)
             message.chatInstance = updateDoc["result"][0]["callback_query"]["chat_instance"];
             message.callbackQueryID = updateDoc["result"][0]["callback_query"]["id"];
             message.callbackQueryData = updateDoc["result"][0]["callback_query"]["data"];
-            message.text = updateDoc["result"][0]["callback_query"]["message"]["text"].as<String>();
+            message.text = updateDoc["result"][0]["callback_query"]["message"]["text"] | "";
             message.messageType = MessageQuery;
 
             // Check if callback function is defined for this button query
+            TB_TRACE_START(tc);
             for (uint8_t i = 0; i < m_keyboardCount; i++)
                 m_keyboards[i]->checkCallback(message);
+            TB_TRACE(TraceCallback, tc);
         }
         else if (updateDoc["result"][0]["message"]["message_id"])
         {
@@ -267,33 +689,47 @@ MessageType AsyncTelegramBot::getNewMessage(TBMessage &message)
             }
             else if (updateDoc["result"][0]["message"]["document"])
             {
-                // this is a document message
-                message.document.file_id = updateDoc["result"][0]["message"]["document"]["file_id"];
-                message.document.file_name = updateDoc["result"][0]["message"]["document"]["file_name"];
-                message.text = updateDoc["result"][0]["message"]["caption"].as<String>();
-                message.document.file_exists = getFile(message.document);
+                // this is a document message (file link is resolved on demand with getFile/requestFile)
+                message.document.file_id = updateDoc["result"][0]["message"]["document"]["file_id"] | "";
+                // Name is copied, so a saved message can be used later (ex. OTA after a confirmation)
+                const char *name = updateDoc["result"][0]["message"]["document"]["file_name"] | "";
+                const size_t nameLen = strlen(name), keep = sizeof(message.document.file_name) - 1;
+                if (nameLen > keep)
+                {
+                    memcpy(message.document.file_name, name, keep - 8);
+                    memcpy(message.document.file_name + keep - 8, name + nameLen - 8, 9);
+                }
+                else
+                    memcpy(message.document.file_name, name, nameLen + 1);
+                message.document.file_size = updateDoc["result"][0]["message"]["document"]["file_size"];
+                message.document.file_path = "";
+                message.document.file_exists = false;
+                message.text = updateDoc["result"][0]["message"]["caption"] | "";
                 message.messageType = MessageDocument;
             }
             else if (updateDoc["result"][0]["message"]["reply_to_message"])
             {
                 // this is a reply to message
-                message.text = updateDoc["result"][0]["message"]["text"].as<String>();
+                message.text = updateDoc["result"][0]["message"]["text"] | "";
                 message.messageType = MessageReply;
             }
             else if (updateDoc["result"][0]["message"]["text"])
             {
                 // this is a text message
-                message.text = updateDoc["result"][0]["message"]["text"].as<String>();
+                message.text = updateDoc["result"][0]["message"]["text"] | "";
                 message.messageType = MessageText;
             }
         }
+        // Update of a kind not handled by the library: it's confirmed but never delivered
+        if (message.messageType == MessageNoData)
+            m_stats.droppedUpdates++;
         return message.messageType;
     }
     return MessageNoData; // waiting for reply from server
 }
 
 // Blocking getMe function (we wait for a reply from Telegram server)
-bool AsyncTelegramBot::getMe()
+bool AsyncTelegramBotBase::getMe()
 {
     // getMe has to be blocking (wait server reply)
     if (!sendCommand("getMe", "", true))
@@ -301,36 +737,196 @@ bool AsyncTelegramBot::getMe()
         log_error("getMe error ");
         return false;
     }
-    StaticJsonDocument<BUFFER_SMALL> smallDoc;
-    deserializeJson(smallDoc, m_rxbuffer);
-    debugJson(smallDoc, Serial);
-    m_botusername = smallDoc["result"]["username"].as<String>();
+    deserializeJson(m_txDoc, (const char *)m_rxbuffer, m_rxLen);
+    debugJson(m_txDoc, Serial);
+    snprintf(m_botusername, sizeof(m_botusername), "%s", m_txDoc["result"]["username"] | "");
     return true;
 }
 
-bool AsyncTelegramBot::getFile(TBDocument &doc)
+bool AsyncTelegramBotBase::getFile(TBDocument &doc)
 {
-    char cmd[BUFFER_SMALL];
-    snprintf(cmd, BUFFER_SMALL, "getFile?file_id=%s", doc.file_id);
+    char payload[BUFFER_SMALL];
+    snprintf(payload, BUFFER_SMALL, "{\"file_id\":\"%s\"}", doc.file_id.c_str());
 
-    // getFile has to be blocking (wait server reply
-    if (!sendCommand(cmd, "", true))
+    // getFile has to be blocking (wait server reply)
+    if (!sendCommand("getFile", payload, true))
     {
         log_error("getFile error");
+        doc.file_exists = false;
         return false;
     }
-    StaticJsonDocument<BUFFER_MEDIUM> fileDoc;
-    deserializeJson(fileDoc, m_rxbuffer);
-    debugJson(fileDoc, Serial);
-    doc.file_path = "https://api.telegram.org/file/bot";
+    deserializeJson(m_txDoc, (const char *)m_rxbuffer, m_rxLen);
+    debugJson(m_txDoc, Serial);
+    setFileInfo(doc, m_txDoc["result"]);
+    return doc.file_exists;
+}
+
+bool AsyncTelegramBotBase::requestFile(TBDocument &doc)
+{
+    if (m_fileRequest != nullptr || !doc.file_id.length())
+        return false;
+    doc.file_exists = false;
+    m_fileRequest = &doc;
+    m_fileRequestSent = false;
+    return true;
+}
+
+void AsyncTelegramBotBase::setFileInfo(TBDocument &doc, JsonVariant result)
+{
+    doc.file_exists = !result["file_path"].isNull();
+    if (!doc.file_exists)
+        return;
+    doc.file_path = "https://";
+    doc.file_path += m_host;
+    if (m_port != 443)
+    {
+        doc.file_path += ":";
+        doc.file_path += m_port;
+    }
+    doc.file_path += "/file/bot";
     doc.file_path += m_token;
     doc.file_path += "/";
-    doc.file_path += fileDoc["result"]["file_path"].as<String>();
-    doc.file_size = fileDoc["result"]["file_size"].as<long>();
-    return true;
+    doc.file_path += result["file_path"].as<const char *>();
+    doc.file_size = result["file_size"].as<long>();
+}
+
+void AsyncTelegramBotBase::endFileRequest(JsonVariant result)
+{
+    if (m_fileRequest == nullptr)
+        return;
+    setFileInfo(*m_fileRequest, result);
+    m_fileRequest = nullptr;
+    m_fileRequestSent = false;
+}
+
+int AsyncTelegramBotBase::requestRange(const char *path, size_t from, size_t to, size_t &contentLength, bool resume)
+{
+    contentLength = 0;
+    TB_TRACE_METHOD("downloadFile");
+    if (!checkConnection(resume))
+        return 0;
+
+    char range[24] = "";
+    if (to)
+        snprintf(range, sizeof(range), "%u", (unsigned)to);
+    char request[BUFFER_SMALL];
+    snprintf(request, BUFFER_SMALL,
+             "GET %s HTTP/1.0\r\nHost: %s\r\nConnection: keep-alive\r\nRange: bytes=%u-%s\r\n\r\n",
+             path, m_host, (unsigned)from, range);
+    const size_t len = telegramClient->print(request);
+    TB_TRACE(TraceHeaderWrite, m_traceTime);
+    statsRequest("downloadFile", len);
+    m_requestTime = now();
+
+    bool closed;
+    const int status = readHeaders(contentLength, closed, m_replyTimeout);
+    statsReply(status);
+    return status;
+}
+
+bool AsyncTelegramBotBase::downloadFile(TBDocument &doc, Stream &stream, ProgressCallback onProgress,
+                                    size_t offset, size_t length)
+{
+    // Server path of file (link without scheme and host)
+    const char *path = strstr(doc.file_path.c_str(), "/file/bot");
+    if (!doc.file_exists || path == nullptr)
+        return false;
+
+    // A polling request is still waiting for reply: drop it (offset of updates is unchanged, nothing is lost).
+    // On sending connection (dual mode) the reply to last request is read instead
+    readSendReply(true);
+    if (m_waitingReply)
+        reset();
+
+    uint8_t *data = m_block;
+    size_t written = offset;
+    size_t total = doc.file_size;
+    // Last byte to download (0 until the end of file)
+    const size_t last = length ? offset + length - 1 : 0;
+    bool done = false;
+    uint32_t t1 = now();
+
+    for (uint8_t attempt = 0; attempt <= DOWNLOAD_RETRY && !done; attempt++)
+    {
+        size_t len = 0;
+        int status = requestRange(path, written, last, len, attempt > 0);
+        if (status != 200 && status != 206)
+        {
+            log_error("Download error, HTTP status %d", status);
+            telegramClient->stop();
+            // Status 0 means connection lost, try again. Otherwise server has refused request
+            if (status == 0)
+                continue;
+            break;
+        }
+
+        // Range not supported by server: whole file is sent again, skip bytes already written
+        size_t toSkip = (status == 200) ? written : 0;
+        if (status == 200)
+        {
+            total = len;
+            // Read only the requested range, then the connection must be dropped
+            if (last && last + 1 < len)
+                len = last + 1;
+        }
+        else if (!last)
+            total = written + len;
+
+        size_t received = 0;
+        uint32_t lastByteTime = now();
+        while (received < len)
+        {
+            size_t chunk = len - received < m_blockSize ? len - received : m_blockSize;
+            int n = telegramClient->read(data, chunk);
+            if (n > 0)
+            {
+                lastByteTime = now();
+                received += n;
+                m_stats.bytesReceived += n;
+                size_t from = 0;
+                if (toSkip)
+                {
+                    from = toSkip < (size_t)n ? toSkip : n;
+                    toSkip -= from;
+                }
+                if ((size_t)n > from)
+                {
+                    if (stream.write(data + from, n - from) != n - from)
+                    {
+                        log_error("Destination stream write error");
+                        telegramClient->stop();
+                        return false;
+                    }
+                    written += n - from;
+                    if (onProgress != nullptr)
+                        onProgress(written, total);
+                }
+                continue;
+            }
+            if (!telegramClient->connected() || now() - lastByteTime > m_replyTimeout)
+                break;
+            yield();
+        }
+        TB_TRACE(TraceBodyRead, m_traceTime);
+
+        done = (received == len);
+        if (done && status == 200 && len < total)
+            telegramClient->stop();
+        if (!done)
+        {
+            log_debug("Connection lost after %u bytes, resume download", (unsigned)written);
+            telegramClient->stop();
+        }
+    }
+
+    uint32_t elapsed = now() - t1;
+    m_downloadRate = elapsed ? (uint32_t)((uint64_t)(written - offset) * 1000 / elapsed) : 0;
+    m_lastmsg_timestamp = now();
+    log_debug("Downloaded %u bytes, %lu bytes/s", (unsigned)written, (unsigned long)m_downloadRate);
+    return done;
 }
 
-bool AsyncTelegramBot::noNewMessage()
+bool AsyncTelegramBotBase::noNewMessage()
 {
 
     TBMessage msg;
@@ -346,12 +942,14 @@ bool AsyncTelegramBot::noNewMessage()
     return true;
 }
 
-bool AsyncTelegramBot::sendMessage(const TBMessage &msg, const char *message, const char *keyboard)
+bool AsyncTelegramBotBase::sendMessage(const TBMessage &msg, const char *message, const char *keyboard)
 {
+    TB_HEAP_SCOPE("sendMessage");
     if (!strlen(message))
         return false;
 
-    DynamicJsonDocument root(BUFFER_BIG);
+    JsonDocument &root = m_txDoc;
+    root.clear();
     // Backward compatibility
     root["chat_id"] = msg.sender.id != 0 ? msg.sender.id : msg.chatId;
     root["text"] = message;
@@ -367,9 +965,8 @@ bool AsyncTelegramBot::sendMessage(const TBMessage &msg, const char *message, co
     {
         if (strlen(keyboard) || msg.force_reply)
         {
-            StaticJsonDocument<BUFFER_MEDIUM> doc;
-            deserializeJson(doc, keyboard);
-            JsonObject myKeyb = doc.as<JsonObject>();
+            deserializeJson(m_auxDoc, keyboard);
+            JsonObject myKeyb = m_auxDoc.as<JsonObject>();
             root["reply_markup"] = myKeyb;
             if (msg.force_reply)
             {
@@ -378,18 +975,11 @@ bool AsyncTelegramBot::sendMessage(const TBMessage &msg, const char *message, co
             }
         }
     }
-    root.shrinkToFit();
-
-    size_t len = measureJson(root);
-    char payload[len];
-    serializeJson(root, payload, len);
-
-    debugJson(root, Serial);
-    const bool result = sendCommand("sendMessage", payload);
+    const bool result = sendCommand("sendMessage", root);
     return result;
 }
 
-bool AsyncTelegramBot::sendTextMessage(int64_t chat_id, String text, String parse_mode = "Default", String entities = "", bool disable_web_page_preview = false, bool disable_notification = false, int32_t reply_to_message_id = 0, bool force_reply = false, bool allow_sending_without_reply = true, String reply_markup = "")
+bool AsyncTelegramBotBase::sendTextMessage(int64_t chat_id, const String &text, const String &parse_mode, const String &entities, bool disable_web_page_preview, bool disable_notification, int32_t reply_to_message_id, bool force_reply, bool allow_sending_without_reply, const String &reply_markup)
 {
     if (!strlen(text.c_str()))
         return false;
@@ -397,14 +987,16 @@ bool AsyncTelegramBot::sendTextMessage(int64_t chat_id, String text, String pars
     if (chat_id == 0)
         return false;
 
-    DynamicJsonDocument root(BUFFER_BIG);
+    JsonDocument &root = m_txDoc;
+    root.clear();
     // Backward compatibility
     root["chat_id"] = chat_id;
-    root["text"] = text;
+    // const char* are stored as pointers in JSON document (no copy)
+    root["text"] = text.c_str();
 
     if (parse_mode != "Default")
         if (parse_mode == "Markdown" || parse_mode == "MarkdownV2" || parse_mode == "HTML")
-            root["parse_mode"] = parse_mode;
+            root["parse_mode"] = parse_mode.c_str();
 
     if (disable_web_page_preview)
         root["disable_web_page_preview"] = disable_web_page_preview;
@@ -420,17 +1012,15 @@ bool AsyncTelegramBot::sendTextMessage(int64_t chat_id, String text, String pars
 
     if (strlen(entities.c_str()))
     {
-        StaticJsonDocument<BUFFER_MEDIUM> doc;
-        deserializeJson(doc, entities);
-        JsonObject myEntities = doc.as<JsonObject>();
+        deserializeJson(m_auxDoc, entities.c_str());
+        JsonObject myEntities = m_auxDoc.as<JsonObject>();
         root["entities"] = myEntities;
     }
 
     if (strlen(reply_markup.c_str()) || force_reply)
     {
-        StaticJsonDocument<BUFFER_MEDIUM> doc;
-        deserializeJson(doc, reply_markup);
-        JsonObject myKeyb = doc.as<JsonObject>();
+        deserializeJson(m_auxDoc, reply_markup.c_str());
+        JsonObject myKeyb = m_auxDoc.as<JsonObject>();
         root["reply_markup"] = myKeyb;
         if (force_reply)
         {
@@ -439,30 +1029,23 @@ bool AsyncTelegramBot::sendTextMessage(int64_t chat_id, String text, String pars
         }
     }
 
-    root.shrinkToFit();
-
-    size_t len = measureJson(root);
-    char payload[len];
-    serializeJson(root, payload, len);
-
-    debugJson(root, Serial);
-    const bool result = sendCommand("sendMessage", payload);
+    const bool result = sendCommand("sendMessage", root);
     return result;
 }
 
-bool AsyncTelegramBot::forwardMessage(const TBMessage &msg, const int32_t to_chatid)
+bool AsyncTelegramBotBase::forwardMessage(const TBMessage &msg, const int32_t to_chatid)
 {
     char payload[BUFFER_SMALL];
     snprintf(payload, BUFFER_SMALL,
              "{\"chat_id\":%ld,\"from_chat_id\":%lld,\"message_id\":%ld}",
-             to_chatid, msg.chatId, msg.messageID);
+             (long)to_chatid, (long long)msg.chatId, (long)msg.messageID);
 
     const bool result = sendCommand("forwardMessage", payload);
     log_debug("%s", payload);
     return result;
 }
 
-bool AsyncTelegramBot::sendPhotoByUrl(const int64_t &chat_id, const char *url, const char *caption)
+bool AsyncTelegramBotBase::sendPhotoByUrl(const int64_t &chat_id, const char *url, const char *caption)
 {
     if (!strlen(url))
         return false;
@@ -470,14 +1053,14 @@ bool AsyncTelegramBot::sendPhotoByUrl(const int64_t &chat_id, const char *url, c
     char payload[BUFFER_SMALL];
     snprintf(payload, BUFFER_SMALL,
              "{\"chat_id\":%lld,\"photo\":\"%s\",\"caption\":\"%s\"}",
-             chat_id, url, caption);
+             (long long)chat_id, url, caption);
 
     const bool result = sendCommand("sendPhoto", payload);
     log_debug("%s", payload);
     return result;
 }
 
-bool AsyncTelegramBot::sendToChannel(const char *channel, const char *message, bool silent)
+bool AsyncTelegramBotBase::sendToChannel(const char *channel, const char *message, bool silent)
 {
     if (!strlen(message))
         return false;
@@ -492,7 +1075,7 @@ bool AsyncTelegramBot::sendToChannel(const char *channel, const char *message, b
     return result;
 }
 
-bool AsyncTelegramBot::endQuery(const TBMessage &msg, const char *message, bool alertMode)
+bool AsyncTelegramBotBase::endQuery(const TBMessage &msg, const char *message, bool alertMode)
 {
     if (!msg.callbackQueryID)
         return false;
@@ -504,7 +1087,7 @@ bool AsyncTelegramBot::endQuery(const TBMessage &msg, const char *message, bool
     return result;
 }
 
-bool AsyncTelegramBot::removeReplyKeyboard(const TBMessage &msg, const char *message, bool selective)
+bool AsyncTelegramBotBase::removeReplyKeyboard(const TBMessage &msg, const char *message, bool selective)
 {
     char payload[BUFFER_SMALL];
     snprintf(payload, BUFFER_SMALL,
@@ -513,107 +1096,348 @@ bool AsyncTelegramBot::removeReplyKeyboard(const TBMessage &msg, const char *mes
     return result;
 }
 
-char *int64_to_string(int64_t input)
+#define BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+#define END_BOUNDARY "\r\n--" BOUNDARY "--\r\n"
+#define FORM_DATA "--" BOUNDARY "\r\nContent-disposition: form-data; name=\"chat_id\"\r\n\r\n%lld"   \
+                  "\r\n--" BOUNDARY "\r\nContent-disposition: form-data; name=\"%s\"; filename=\"image.jpg\"" \
+                  "\r\nContent-Type: %s\r\ncaption: \"image.jpg\"\r\n\r\n"
+
+size_t AsyncTelegramBotBase::setformData(int64_t chat_id, const char *cmd, const char *type,
+                                         const char *propName, size_t size)
+{
+    // Length of form-data is needed for Content-Length header
+    size_t formLen = snprintf(nullptr, 0, FORM_DATA, (long long)chat_id, propName, type);
+    char *request = (char *)m_block;
+    size_t len = snprintf(request, m_blockSize,
+                          "POST /bot%s/%s HTTP/1.0\r\nHost: %s\r\nContent-Length: %u"
+                          "\r\nContent-Type: multipart/form-data; boundary=" BOUNDARY "\r\n\r\n",
+                          m_token, cmd, m_host, (unsigned)(size + formLen + strlen(END_BOUNDARY)));
+    if (len + formLen >= m_blockSize)
+        return 0;
+    snprintf(request + len, m_blockSize - len, FORM_DATA, (long long)chat_id, propName, type);
+    return len + formLen;
+}
+
+const TBStats &AsyncTelegramBotBase::getStats()
 {
-    static char result[21] = "";
-    // Clear result from any leftover digits from previous function call.
-    memset(&result[0], 0, sizeof(result));
-    // temp is used as a temporary result storage to prevent sprintf bugs.
-    char temp[22] = "";
-    char c;
-    uint8_t base = 10;
+    // Queue depths are current values
+    m_stats.pendingReplies = (m_waitingReply ? 1 : 0) + (m_otherWaiting ? 1 : 0);
+    m_stats.queuedRequests = (m_fileRequest != nullptr && !m_fileRequestSent) ? 1 : 0;
+    m_stats.keyboards = m_keyboardCount;
+    m_stats.idleClose = m_idleClose;
+    return m_stats;
+}
 
-    while (input)
+void AsyncTelegramBotBase::resetStats()
+{
+    m_stats = {};
+    m_statsMethod = -1;
+    m_otherStatsMethod = -1;
+}
+
+int8_t AsyncTelegramBotBase::statsSlot(const char *method)
+{
+    for (uint8_t i = 0; i < TB_STATS_METHODS; i++)
     {
-        int num = input % base;
-        input /= base;
-        c = '0' + num;
-        snprintf(temp, sizeof(temp), "%c%s", c, result);
-        strcpy(result, temp);
+        TBMethodStats &stats = m_stats.methods[i];
+        if (stats.method == nullptr)
+            stats.method = method;
+        else if (strcmp(stats.method, method) != 0)
+            continue;
+        return i;
     }
-    return result;
+    return -1;
 }
 
-void AsyncTelegramBot::setformData(int64_t chat_id, const char *cmd, const char *type,
-                                   const char *propName, size_t size, String &formData, String &request)
+void AsyncTelegramBotBase::statsRequest(const char *method, size_t bytes)
 {
+    m_stats.bytesSent += bytes;
+    // Connection is no more idle (a close from now on is not an idle timeout)
+    m_lastActivity = now();
+    m_idleConnected = false;
+    m_statsMethod = statsSlot(method);
+    if (m_statsMethod >= 0)
+        m_stats.methods[m_statsMethod].calls++;
+}
 
-#define BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
-#define END_BOUNDARY "\r\n--" BOUNDARY "--\r\n"
+void AsyncTelegramBotBase::statsReply(int status)
+{
+    m_result = {};
+    m_result.status = status;
+    m_result.errorCode = status;
+    if (status > 0)
+        m_lastActivity = now();
+    if (status == 429)
+        m_stats.rateLimited++;
+    else if (status == 0)
+        m_stats.timeouts++;
+    // Any reply means the server is reachable
+    if (status > 0)
+        connectionSucceeded();
+    else
+        connectionFailed();
+    if (m_statsMethod < 0)
+        return;
+    TBMethodStats &stats = m_stats.methods[m_statsMethod];
+    m_statsMethod = -1;
+    if (status != 200)
+        stats.errors++;
+    if (status <= 0)
+        return;
+    const uint32_t latency = now() - m_requestTime;
+    stats.replies++;
+    stats.latencyTotal += latency;
+    if (stats.replies == 1 || latency < stats.latencyMin)
+        stats.latencyMin = latency;
+    if (latency > stats.latencyMax)
+        stats.latencyMax = latency;
+}
+
+bool AsyncTelegramBotBase::connectAllowed()
+{
+    if (!m_health.consecutiveFailures || (int32_t)(now() - m_health.retryTime) >= 0)
+    {
+        // One probe connection after backoff delay
+        if (m_health.state == BreakerOpen)
+            m_health.state = BreakerHalfOpen;
+        return true;
+    }
+    return false;
+}
+
+void AsyncTelegramBotBase::connectionFailed()
+{
+    TBHealth &health = m_health;
+    health.lastFailure = now();
+    if (health.consecutiveFailures++ == 0)
+    {
+        m_outageStart = health.lastFailure;
+        health.backoff = m_backoffMin;
+    }
+    else
+        health.backoff = health.backoff < m_backoffMax / 2 ? health.backoff * 2 : m_backoffMax;
+
+    // Equal jitter: devices restarted together don't reconnect at the same time
+    const uint32_t half = health.backoff / 2;
+    health.retryTime = health.lastFailure + half + random(half + 1);
+
+    if (health.state == BreakerHalfOpen)
+        health.state = BreakerOpen;
+    else if (health.state == BreakerClosed && health.consecutiveFailures >= m_breakerThreshold)
+    {
+        health.state = BreakerOpen;
+        health.outages++;
+        log_error("Server unreachable, next attempt in %lu ms", (unsigned long)(health.retryTime - health.lastFailure));
+    }
+}
+
+void AsyncTelegramBotBase::connectionSucceeded()
+{
+    TBHealth &health = m_health;
+    health.lastSuccess = now();
+    if (health.consecutiveFailures)
+    {
+        health.lastRecovery = health.lastSuccess - m_outageStart;
+        if (health.lastRecovery > health.maxRecovery)
+            health.maxRecovery = health.lastRecovery;
+        log_debug("Connection recovered in %lu ms", (unsigned long)health.lastRecovery);
+    }
+    health.consecutiveFailures = 0;
+    health.backoff = 0;
+    health.state = BreakerClosed;
+}
+
+bool AsyncTelegramBotBase::hostByName(const char *host, IPAddress &ip, uint32_t timeout)
+{
+#if defined(ESP8266)
+    return WiFi.hostByName(host, ip, timeout) == 1;
+#elif defined(ESP32)
+    (void)timeout;
+    return WiFi.hostByName(host, ip) == 1;
+#else
+    (void)host;
+    (void)ip;
+    (void)timeout;
+    return false;
+#endif
+}
+
+bool AsyncTelegramBotBase::serverAddress(IPAddress &ip)
+{
+    if (m_dnsTtl == 0 || m_resolve == nullptr)
+        return false;
+    if (m_dnsValid && (int32_t)(m_dnsExpire - now()) > 0)
+    {
+        ip = m_serverIP;
+        return true;
+    }
+
+    // Cache expired (or cached address not working): resolve it again
+    IPAddress resolved;
+    const uint32_t start = now();
+    const bool found = m_resolve(m_host, resolved, DNS_TIMEOUT) && (uint32_t)resolved != 0;
+    m_stats.dnsLookups++;
+    m_stats.dnsTime += now() - start;
+    if (found)
+    {
+        m_serverIP = resolved;
+        m_dnsValid = true;
+        m_dnsExpire = now() + m_dnsTtl;
+        ip = resolved;
+        return true;
+    }
+    m_stats.dnsFailures++;
+    log_error("DNS lookup of %s failed", m_host);
+
+    // Keep last working address, or try a fallback IP. Lookup is not repeated at each reconnection
+    if (!m_dnsValid)
+    {
+        if (!fallbackAddress(m_serverIP))
+            return false;
+        m_dnsValid = true;
+    }
+    m_dnsExpire = now() + (m_dnsTtl < DNS_RETRY_TIME ? m_dnsTtl : DNS_RETRY_TIME);
+    ip = m_serverIP;
+    return true;
+}
+
+bool AsyncTelegramBotBase::fallbackAddress(IPAddress &ip)
+{
+    if (m_fallbackIPs == nullptr || *m_fallbackIPs == '\0')
+        return false;
+    uint8_t count = 1;
+    for (const char *p = m_fallbackIPs; *p; p++)
+        count += (*p == ',');
+
+    const char *address = m_fallbackIPs;
+    for (uint8_t i = m_fallbackIndex % count; i > 0; i--)
+        address = strchr(address, ',') + 1;
+    while (*address == ' ')
+        address++;
+    char text[16];
+    size_t len = strcspn(address, ",");
+    if (len >= sizeof(text))
+        return false;
+    memcpy(text, address, len);
+    text[len] = '\0';
+    log_debug("Using fallback address %s", text);
+    return ip.fromString(text);
+}
+
+bool AsyncTelegramBotBase::readUploadReply()
+{
+    size_t contentLength;
+    bool closed;
+    const int status = readHeaders(contentLength, closed, m_uploadTimeout);
+    statsReply(status);
+    if (status == 0)
+        return false;
+    readBody(contentLength);
+    return decodeResult();
+}
 
-    formData = "--" BOUNDARY "\r\nContent-disposition: form-data; name=\"chat_id\"\r\n\r\n";
-    formData += int64_to_string(chat_id);
-    formData += "\r\n--" BOUNDARY "\r\nContent-disposition: form-data; name=\"";
-    formData += propName;
-    formData += "\"; filename=\"image.jpg\"\r\nContent-Type: ";
-    formData += type;
-    formData += "\r\ncaption: \"image.jpg\"";
-    formData += "\r\n\r\n";
-    int contentLength = size + formData.length() + strlen(END_BOUNDARY);
+bool AsyncTelegramBotBase::decodeResult()
+{
+    TBResult &result = m_result;
+    // "ok" is the first field of Bot API replies: a successful reply is not scanned any further
+    if (result.status == 200 && strncmp(m_rxbuffer, "{\"ok\":true", 10) == 0)
+    {
+        result.ok = true;
+        result.errorCode = 0;
+        return true;
+    }
 
-    request = "POST /bot";
-    request += m_token;
-    request += "/";
-    request += cmd;
-    request += " HTTP/1.0\r\nHost: " TELEGRAM_HOST "\r\nContent-Length: ";
-    request += contentLength;
-    request += "\r\nContent-Type: multipart/form-data; boundary=" BOUNDARY "\r\n";
+    // Decode only the fields of result (reply could be large, or not JSON at all, ex. from a proxy).
+    // Filter is sized by slots: the size of a slot depends on the platform (ex. 64 bit hosts)
+    StaticJsonDocument<JSON_OBJECT_SIZE(4)> filter;
+    filter["ok"] = true;
+    filter["error_code"] = true;
+    filter["description"] = true;
+    filter["parameters"] = true;
+    JsonDocument &doc = m_auxDoc;
+    if (!deserializeJson(doc, (const char *)m_rxbuffer, m_rxLen, DeserializationOption::Filter(filter)))
+    {
+        result.ok = result.status == 200 && doc["ok"].as<bool>();
+        if (result.ok)
+        {
+            result.errorCode = 0;
+            return true;
+        }
+        result.errorCode = doc["error_code"] | result.status;
+        snprintf(result.description, sizeof(result.description), "%s", doc["description"] | "");
+        result.retryAfter = doc["parameters"]["retry_after"] | 0;
+        result.migrateToChatId = doc["parameters"]["migrate_to_chat_id"] | 0LL;
+    }
+    log_error("Request failed, error %d: %s", result.errorCode, result.description);
+    return false;
 }
 
-bool AsyncTelegramBot::sendStream(int64_t chat_id, const char *cmd, const char *type, const char *propName, Stream &stream, size_t size)
+bool AsyncTelegramBotBase::sendStream(int64_t chat_id, const char *cmd, const char *type, const char *propName, Stream &stream, size_t size)
 {
+    TB_HEAP_SCOPE("sendStream");
     bool res = false;
+    readSendReply(true);
+    TB_TRACE_METHOD(cmd);
     if (checkConnection())
     {
+        size_t len = setformData(chat_id, cmd, type, propName, size);
+        if (len == 0)
+        {
+            log_error("Upload request exceeds chunk buffer size");
+            return false;
+        }
         m_waitingReply = true;
-        String formData;
-        formData.reserve(512);
-        String request;
-        request.reserve(256);
-        setformData(chat_id, cmd, type, propName, size, formData, request);
 
-#if DEBUG_ENABLE
-        uint32_t t1 = millis();
+#if DEBUG_ENABLE || TB_LOG_ENABLE
+        uint32_t t1 = now();
 #endif
-        // Send POST request to host
-        telegramClient->println(request);
-        // Body of request
-        telegramClient->print(formData);
+        // Send POST request header and form-data (chunk buffer is reused for file content)
+        bool sent = telegramClient->write(m_block, len) == len;
+        TB_TRACE(TraceHeaderWrite, m_traceTime);
 
-        uint8_t data[BLOCK_SIZE];
-        int n_block = trunc(size / BLOCK_SIZE);
-        int lastBytes = size - (n_block * BLOCK_SIZE);
+        uint8_t *data = m_block;
+        int n_block = trunc(size / m_blockSize);
+        int lastBytes = size - (n_block * m_blockSize);
 
-        for (uint16_t pos = 0; pos < n_block; pos++)
+        // Stop at first write error (connection dropped)
+        for (uint16_t pos = 0; pos < n_block && sent; pos++)
         {
-            stream.readBytes(data, BLOCK_SIZE);
-            telegramClient->write(data, BLOCK_SIZE);
+            stream.readBytes(data, m_blockSize);
+            sent = telegramClient->write(data, m_blockSize) == m_blockSize;
             yield();
         }
-        stream.readBytes(data, lastBytes);
-        telegramClient->write(data, lastBytes);
+        if (sent)
+        {
+            stream.readBytes(data, lastBytes);
+            sent = telegramClient->write(data, lastBytes) == (size_t)lastBytes;
+        }
 
         // Close the request form-data
-        telegramClient->println(END_BOUNDARY);
-        telegramClient->flush();
+        if (sent)
+        {
+            telegramClient->println(END_BOUNDARY);
+            telegramClient->flush();
+        }
+        TB_TRACE(TraceBodyWrite, m_traceTime);
 
-#if DEBUG_ENABLE
-        log_debug("Raw upload time: %lums\n", millis() - t1);
-        t1 = millis();
+#if DEBUG_ENABLE || TB_LOG_ENABLE
+        log_debug("Raw upload time: %lums\n", now() - t1);
+        t1 = now();
 #endif
 
-        // Read server reply
-        while (telegramClient->connected())
+        // Read server reply (latency is measured from the end of upload)
+        statsRequest(cmd, len + size + strlen(END_BOUNDARY));
+        m_requestTime = now();
+        if (sent)
+            res = readUploadReply();
+        else
         {
-            if (telegramClient->find((char *)"{\"ok\":true"))
-            {
-                res = true;
-                break;
-            }
+            log_error("Upload interrupted, write error");
+            statsReply(-1);
         }
-        log_debug("Read reply time: %lums\n", millis() - t1);
+        log_debug("Read reply time: %lums\n", now() - t1);
         telegramClient->stop();
-        m_lastmsg_timestamp = millis();
+        m_lastmsg_timestamp = now();
         m_waitingReply = false;
         return res;
     }
@@ -621,59 +1445,68 @@ bool AsyncTelegramBot::sendStream(int64_t chat_id, const char *cmd, const char *
     return res;
 }
 
-bool AsyncTelegramBot::sendBuffer(int64_t chat_id, const char *cmd, const char *type, const char *propName, uint8_t *data, size_t size)
+bool AsyncTelegramBotBase::sendBuffer(int64_t chat_id, const char *cmd, const char *type, const char *propName, uint8_t *data, size_t size)
 {
+    TB_HEAP_SCOPE("sendBuffer");
     bool res = false;
+    readSendReply(true);
+    TB_TRACE_METHOD(cmd);
     if (checkConnection())
     {
+        size_t len = setformData(chat_id, cmd, type, propName, size);
+        if (len == 0)
+        {
+            log_error("Upload request exceeds chunk buffer size");
+            return false;
+        }
         m_waitingReply = true;
-        String formData;
-        formData.reserve(512);
-        String request;
-        request.reserve(256);
-        setformData(chat_id, cmd, type, propName, size, formData, request);
 
-#if DEBUG_ENABLE
-        uint32_t t1 = millis();
+#if DEBUG_ENABLE || TB_LOG_ENABLE
+        uint32_t t1 = now();
 #endif
-        // Send POST request to host
-        telegramClient->println(request);
-        // Body of request
-        telegramClient->print(formData);
+        // Send POST request header and form-data (chunk buffer is reused for file content)
+        bool sent = telegramClient->write(m_block, len) == len;
+        TB_TRACE(TraceHeaderWrite, m_traceTime);
 
-        // Serial.println(telegramClient->write((const uint8_t *) data, size));
         uint16_t pos = 0;
-        int n_block = trunc(size / BLOCK_SIZE);
-        int lastBytes = size - (n_block * BLOCK_SIZE);
+        int n_block = trunc(size / m_blockSize);
+        int lastBytes = size - (n_block * m_blockSize);
 
-        for (pos = 0; pos < n_block; pos++)
+        // Stop at first write error (connection dropped)
+        for (pos = 0; pos < n_block && sent; pos++)
         {
-            telegramClient->write((const uint8_t *)data + pos * BLOCK_SIZE, BLOCK_SIZE);
+            sent = telegramClient->write((const uint8_t *)data + pos * m_blockSize, m_blockSize) == m_blockSize;
             yield();
         }
-        telegramClient->write((const uint8_t *)data + pos * BLOCK_SIZE, lastBytes);
+        if (sent)
+            sent = telegramClient->write((const uint8_t *)data + pos * m_blockSize, lastBytes) == (size_t)lastBytes;
 
         // Close the request form-data
-        telegramClient->println(END_BOUNDARY);
-        telegramClient->flush();
+        if (sent)
+        {
+            telegramClient->println(END_BOUNDARY);
+            telegramClient->flush();
+        }
+        TB_TRACE(TraceBodyWrite, m_traceTime);
 
-#if DEBUG_ENABLE
-        log_debug("Raw upload time: %lums\n", millis() - t1);
-        t1 = millis();
+#if DEBUG_ENABLE || TB_LOG_ENABLE
+        log_debug("Raw upload time: %lums\n", now() - t1);
+        t1 = now();
 #endif
 
-        // Read server reply
-        while (telegramClient->connected())
+        // Read server reply (latency is measured from the end of upload)
+        statsRequest(cmd, len + size + strlen(END_BOUNDARY));
+        m_requestTime = now();
+        if (sent)
+            res = readUploadReply();
+        else
         {
-            if (telegramClient->find((char *)"{\"ok\":true"))
-            {
-                res = true;
-                break;
-            }
+            log_error("Upload interrupted, write error");
+            statsReply(-1);
         }
-        log_debug("Read reply time: %lums\n", millis() - t1);
+        log_debug("Read reply time: %lums\n", now() - t1);
         telegramClient->stop();
-        m_lastmsg_timestamp = millis();
+        m_lastmsg_timestamp = now();
         m_waitingReply = false;
         return res;
     }
@@ -682,25 +1515,24 @@ bool AsyncTelegramBot::sendBuffer(int64_t chat_id, const char *cmd, const char *
     return res;
 }
 
-void AsyncTelegramBot::getMyCommands(String &cmdList)
+void AsyncTelegramBotBase::getMyCommands(String &cmdList)
 {
     if (!sendCommand("getMyCommands", "", true))
     {
         log_error("getMyCommands error ");
         return;
     }
-    StaticJsonDocument<BUFFER_MEDIUM> doc;
-    DeserializationError err = deserializeJson(doc, m_rxbuffer);
+    DeserializationError err = deserializeJson(m_txDoc, (const char *)m_rxbuffer, m_rxLen);
     if (err)
     {
         return;
     }
-    debugJson(doc, Serial);
+    debugJson(m_txDoc, Serial);
     //cmdList = doc["result"].as<String>();
-    serializeJsonPretty(doc["result"], cmdList);
+    serializeJsonPretty(m_txDoc["result"], cmdList);
 }
 
-bool AsyncTelegramBot::deleteMyCommands()
+bool AsyncTelegramBotBase::deleteMyCommands()
 {
     if (!sendCommand("deleteMyCommands", "", true))
     {
@@ -710,7 +1542,7 @@ bool AsyncTelegramBot::deleteMyCommands()
     return true;
 }
 
-bool AsyncTelegramBot::setMyCommands(const String &cmd, const String &desc)
+bool AsyncTelegramBotBase::setMyCommands(const String &cmd, const String &desc)
 {
 
     // get actual list of commands
@@ -719,8 +1551,8 @@ bool AsyncTelegramBot::setMyCommands(const String &cmd, const String &desc)
         log_error("getMyCommands error ");
         return "";
     }
-    DynamicJsonDocument doc(BUFFER_MEDIUM);
-    DeserializationError err = deserializeJson(doc, m_rxbuffer);
+    JsonDocument &doc = m_txDoc;
+    DeserializationError err = deserializeJson(doc, (const char *)m_rxbuffer, m_rxLen);
     if (err)
     {
         return false;
@@ -735,44 +1567,30 @@ bool AsyncTelegramBot::setMyCommands(const String &cmd, const String &desc)
         }
     }
 
-    StaticJsonDocument<256> obj;
+    JsonObject obj = doc["result"].as<JsonArray>().createNestedObject();
     obj["command"] = cmd;
     obj["description"] = desc;
-    doc["result"].as<JsonArray>().add(obj);
 
-    StaticJsonDocument<BUFFER_MEDIUM> doc2;
+    JsonDocument &doc2 = m_auxDoc;
+    doc2.clear();
     doc2["commands"] = doc["result"].as<JsonArray>();
 
-    size_t len = measureJson(doc2);
-    char payload[len];
-    serializeJson(doc2, payload, len);
-    debugJson(doc2, Serial);
-
-    const bool result = sendCommand("setMyCommands", payload, true);
+    const bool result = sendCommand("setMyCommands", doc2, true);
     return result;
 }
 
-bool AsyncTelegramBot::editMessage(int32_t chat_id, int32_t message_id, const String &txt, const String &keyboard)
+bool AsyncTelegramBotBase::editMessage(int32_t chat_id, int32_t message_id, const String &txt, const char *keyboard)
 {
-    String payload = "{\"chat_id\":";
-    payload += chat_id;
-    payload += ",\"message_id\":";
-    payload += message_id;
-    payload += ", \"text\": \"";
-    payload += txt;
-
-    if (keyboard.length())
-    {
-        payload += "\", \"reply_markup\": ";
-        payload += keyboard;
-        payload += "}";
-    }
-    else
-    {
-        payload += "\"}";
-    }
+    JsonDocument &root = m_txDoc;
+    root.clear();
+    root["chat_id"] = chat_id;
+    root["message_id"] = message_id;
+    root["text"] = txt.c_str();
+    // Keyboard is already serialized: insert it as is (no copy, no parsing)
+    if (keyboard != nullptr && strlen(keyboard))
+        root["reply_markup"] = serialized(keyboard);
 
-    const bool result = sendCommand("editMessageText", payload.c_str());
+    const bool result = sendCommand("editMessageText", root);
 
     return result;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -15,9 +15,9 @@
 
 
 #include "Client.h"
+#include <functional>
 #include "time.h"
 
-#define DEBUG_ENABLE        false
 #ifndef DEBUG_ENABLE
     #define DEBUG_ENABLE    false
 #endif
@@ -29,19 +29,44 @@
 */
 #define MAX_INLINEKYB_CB    30
 
-#define SERVER_TIMEOUT      10000
+#define SERVER_TIMEOUT      10000   // Max wait for server reply (and between two chunks of a reply)
+#define UPLOAD_TIMEOUT      30000   // Max wait for the reply of an upload (file is processed by server)
 #define MIN_UPDATE_TIME     500
 
+#define RECONNECT_MIN_DELAY 500     // Backoff delay after first failure, doubled at each consecutive failure
+#define RECONNECT_MAX_DELAY 60000
+#define BREAKER_THRESHOLD   5       // Consecutive failures that open the circuit breaker
+#define PREWARM_MIN_IDLE    1000    // Connections dropped sooner are not taken as server idle timeout
+#define LONG_POLL_TIMEOUT   20      // Dual connection mode: server holds a polling request until an update (s)
+
 #define BLOCK_SIZE          1436    //2872   // 2 * TCP_MSS
+#define DOWNLOAD_RETRY      3       // Resume attempts (HTTP Range) when connection drops while downloading
 
 #include "DataStructures.h"
 #include "InlineKeyboard.h"
 #include "ReplyKeyboard.h"
+#include "TBAllocator.h"
+#include "TLSSession.h"
+#include "TBTrace.h"
+#include "TBHeapScope.h"
 #include "serial_log.h"
 
-#define TELEGRAM_HOST  "api.telegram.org"
-#define TELEGRAM_IP    "149.154.167.220"
-#define TELEGRAM_PORT   443
+// Default Bot API server (use setTelegramServer() to change it at runtime)
+#ifndef TELEGRAM_HOST
+    #define TELEGRAM_HOST  "api.telegram.org"
+#endif
+// Fallback addresses of Telegram server (comma separated), used when DNS resolution fails
+#ifndef TELEGRAM_IP
+    #define TELEGRAM_IP    "149.154.167.220"
+#endif
+#ifndef TELEGRAM_PORT
+    #define TELEGRAM_PORT   443
+#endif
+#ifndef DNS_CACHE_TTL
+    #define DNS_CACHE_TTL   3600000 // Default TTL of setDnsCache(): address is resolved again after this time (ms)
+#endif
+#define DNS_TIMEOUT         2000    // Max time of a DNS lookup (where supported by platform)
+#define DNS_RETRY_TIME      60000   // After a failed lookup, last address is used for this time
 
 /* This is used with ESP8266 platform only */
 static const char telegram_cert[] PROGMEM = R"EOF(
@@ -71,14 +96,14 @@ ReYNnyicsbkqWletNw+vHX/bvZ8=
 -----END CERTIFICATE-----
 )EOF";
 
-class AsyncTelegramBot
+// Bot implementation: buffers are not owned by this class but provided by derived class.
+// Use AsyncTelegramBot (default sizes) or AsyncTelegramBotT<...> in order to customize buffers size.
+class AsyncTelegramBotBase
 {
 
 public:
-    // default constructor
-    AsyncTelegramBot(Client &client);
     // default destructor
-    ~AsyncTelegramBot();
+    ~AsyncTelegramBotBase();
 
     // test the connection between ESP8266 and the telegram server
     // returns
@@ -95,19 +120,174 @@ public:
     //   token: the telegram token
     inline void setTelegramToken(const char* token) { m_token = (char*) token; }
 
+    // set the Bot API server (ex. a local Bot API server or a fake server for tests)
+    // params
+    //   host: server hostname or IP address (must remain valid)
+    //   port: server port
+    inline void setTelegramServer(const char* host, uint16_t port = TELEGRAM_PORT) {
+        m_host = host;
+        m_port = port;
+        // Cached address and fallback IPs belong to previous server
+        m_dnsValid = false;
+        m_fallbackIPs = strcmp(host, TELEGRAM_HOST) == 0 ? TELEGRAM_IP : nullptr;
+    }
+
+    // DNS cache (disabled by default): the server address is resolved once every ttl ms and reconnections
+    // use the cached IP. If a lookup fails (or times out), the last address is kept or the fallback IPs are tried in turn.
+    // Trade-off: connections by IP send no SNI and the TLS client can't check the hostname of the certificate,
+    // so any valid certificate is accepted. Enable it only when the server is identified otherwise (ex. PinnedClient)
+    // params:
+    //    ttl: validity of resolved address (ms), 0 to always connect by hostname
+    inline void setDnsCache(uint32_t ttl = DNS_CACHE_TTL) {
+        m_dnsTtl = ttl;
+        m_dnsValid = false;
+    }
+
+    // Function resolving hostnames for the DNS cache (default WiFi.hostByName() on ESP8266 and ESP32,
+    // none elsewhere: without resolver the bot connects by hostname)
+    using ResolveFunction = bool (*)(const char *host, IPAddress &ip, uint32_t timeout);
+    inline void setResolver(ResolveFunction resolve) {
+        m_resolve = resolve;
+        m_dnsValid = false;
+    }
+
+    // Addresses used when DNS lookup fails (comma separated, must remain valid, nullptr none).
+    // Default TELEGRAM_IP (set again by setTelegramServer())
+    inline void setFallbackIPs(const char *list) { m_fallbackIPs = list; }
+
     // set the interval in milliseconds for polling
     // in order to Avoid query Telegram server to much often (ms)
     // params:
     //    pollingTime: interval time in milliseconds
     void setUpdateTime(uint32_t pollingTime) { m_minUpdateTime = pollingTime;}
 
-    // Get file link and size by unique document ID
+    // set the max time in milliseconds to wait for server reply, and for the rest of a reply
+    // partially received. When expired, connection is dropped and started again
+    inline void setReplyTimeout(uint32_t timeout) { m_replyTimeout = timeout; }
+
+    // set the max time in milliseconds to wait for the reply of a file upload
+    inline void setUploadTimeout(uint32_t timeout) { m_uploadTimeout = timeout; }
+
+    // Reconnection policy: after a failure (connection or missing reply) next connection is attempted
+    // after a delay, doubled at each consecutive failure (with random jitter) from minDelay to maxDelay.
+    // After threshold consecutive failures the circuit breaker opens and requests fail immediately
+    // until a probe connection succeeds
+    inline void setReconnectPolicy(uint32_t minDelay, uint32_t maxDelay, uint8_t threshold = BREAKER_THRESHOLD) {
+        m_backoffMin = minDelay;
+        m_backoffMax = maxDelay;
+        m_breakerThreshold = threshold;
+    }
+
+    // Resume the TLS session of previous connection when reconnecting, if the client supports it.
+    // Full and resumed handshakes are counted (and timed) in getStats()
+    // params:
+    //    session: TLS session of telegram client (ex. BearSSLSession on ESP8266), nullptr to disable
+    inline void setTLSSession(TLSSession *session) { m_session = session; }
+
+    // Pre-warming: while the bot is idle, a connection closed by server is opened again in advance, and
+    // a connection about to reach the idle timeout of server (learned from previous closes) is replaced,
+    // so requests of the sketch rarely wait for a handshake. Enabled by default
+    inline void setPrewarm(bool enable) { m_prewarm = enable; }
+
+    // Dual connection mode: polling requests run on the telegram client, while requests of the sketch
+    // (messages, edits, query answers, uploads and downloads) run on a second client, so they never wait
+    // for a polling request and an upload doesn't drop it. Polling becomes long polling: the server replies
+    // as soon as an update arrives. Costs a second connection (RAM of a TLS client). Call before begin()
+    // params:
+    //    client : second client, configured like the telegram client (certificate, pins...)
+    //    session: TLS session of second client (see setTLSSession()), nullptr to disable
+    void setSendClient(Client &client, TLSSession *session = nullptr);
+
+    // max time in seconds the server holds a polling request in dual connection mode (0 short polling)
+    inline void setLongPoll(uint16_t seconds) { m_longPoll = seconds; }
+
+    // Health of connection with server: breaker state, consecutive failures, last success, recovery time
+    inline const TBHealth &getHealth() const { return m_health; }
+
+    // Time source of the library (millis() as default), ex. a virtual clock used for simulations
+    // params:
+    //    clock: function returning the time in milliseconds (nullptr to restore millis())
+    using ClockFunction = unsigned long (*)(void);
+    inline void setClock(ClockFunction clock) { m_clock = clock; }
+
+    // Get file link and size by unique document ID.
+    // This is a blocking call: the reply from server is waited before return
     // params
     //   doc   : document structure
     // returns
     //   true if no error
     bool getFile(TBDocument &doc);
 
+    // Queue a non-blocking request for file link and size by unique document ID.
+    // The request is sent in place of next polling request and the reply is parsed
+    // by getNewMessage(): when done, doc.file_exists and doc.file_path will be set.
+    // The request fails (doc.file_exists false, reason in getLastResult()) on an error reply,
+    // a reply not received in time or a reset of the connection: queue it again if needed.
+    // Only one file request can be pending at a time.
+    // params
+    //   doc   : document structure (must remain valid until resolved)
+    // returns
+    //   true if request was queued
+    bool requestFile(TBDocument &doc);
+
+    // true until the queued file request is resolved or failed
+    inline bool fileRequestPending() const { return m_fileRequest != nullptr; }
+
+    // Callback function for download progress (bytes written so far, file size)
+    using ProgressCallback = std::function<void(size_t written, size_t total)>;
+
+    // Download a file (link resolved with getFile or requestFile) using the bot connection.
+    // Content is written to stream in chunks (ChunkSize bytes), so file is never fully held in RAM.
+    // If connection drops, download is resumed with an HTTP Range request (up to DOWNLOAD_RETRY times,
+    // reconnecting at once while the circuit breaker is closed)
+    // params
+    //   doc       : document structure
+    //   stream    : destination stream (file, flash updater, serial...)
+    //   onProgress: callback function for download progress (optional)
+    //   offset    : first byte to download (resume a previous partial download)
+    //   length    : number of bytes to download starting from offset (0 until the end of file)
+    // returns
+    //   true if the requested bytes were written to stream
+    bool downloadFile(TBDocument &doc, Stream &stream, ProgressCallback onProgress = nullptr,
+                      size_t offset = 0, size_t length = 0);
+
+    #if FS_SUPPORT == true  // #support for <FS.h> is needed
+    // Download a file and save it on filesystem
+    inline bool downloadFile(TBDocument &doc, const char* filename, fs::FS &fs, ProgressCallback onProgress = nullptr) {
+        File file = fs.open(filename, "w");
+        if (!file)
+            return false;
+        bool res = downloadFile(doc, file, onProgress);
+        file.close();
+        return res;
+    }
+    #endif
+
+    // Average throughput of last download
+    // returns
+    //   bytes per second
+    inline uint32_t getDownloadRate() { return m_downloadRate; }
+
+    // Runtime statistics: calls, errors and latency of each Bot API method, traffic,
+    // connections, timeouts, 429 replies, parse failures, dropped updates and queue depths
+    // returns
+    //   the statistics collected since start (or last resetStats())
+    const TBStats &getStats();
+    void resetStats();
+
+    // Result of last request: HTTP status, "ok", "error_code", "description" and the parameters
+    // of failed requests (retry_after, migrate_to_chat_id). Non-blocking requests are decoded
+    // when the reply is received by getNewMessage()
+    inline const TBResult &getLastResult() const { return m_result; }
+
+#if TB_TRACE_ENABLE
+    // Latency histograms of each phase of requests (connect, write, first byte, read, parse, callback)
+    // for each Bot API method, available when library is compiled with TB_TRACE_ENABLE true.
+    // Print them with getTrace().printTo(Serial, getStats())
+    inline const TBTrace &getTrace() const { return m_trace; }
+    inline void resetTrace() { m_trace.reset(); }
+#endif
+
     // get the first unread message from the queue (text and query from inline keyboard).
     // This is a destructive operation: once read, the message will be marked as read
     // so a new getMessage will read the next message (if any).
@@ -127,22 +307,22 @@ public:
     //             (in json format or using the inlineKeyboard/ReplyKeyboard class helper)
     bool sendMessage(const TBMessage &msg, const char* message, const char* keyboard = nullptr);
 
-    // sendMessage function overloads
-    inline bool sendMessage(const TBMessage &msg, const String &message, String keyboard = "")
+    // sendMessage function overloads (keyboard JSON is used in place, without copies)
+    inline bool sendMessage(const TBMessage &msg, const String &message, const String &keyboard = "")
     {
         return sendMessage(msg, message.c_str(), keyboard.c_str());
     }
 
     inline bool sendMessage(const TBMessage &msg, const char* message, InlineKeyboard &keyboard)
     {
-        return sendMessage(msg, message, keyboard.getJSON().c_str());
+        return sendMessage(msg, message, keyboard.m_json.c_str());
     }
 
     inline bool sendMessage(const TBMessage &msg, const char* message, ReplyKeyboard &keyboard) {
-        return sendMessage(msg, message, keyboard.getJSON().c_str());
+        return sendMessage(msg, message, keyboard.m_json.c_str());
     }
 
-    bool sendTextMessage(int64_t chat_id, String text, String parse_mode = "Default", String entities = "", bool disable_web_page_preview = false, bool disable_notification = false, int32_t reply_to_message_id = 0, bool force_reply = false, bool allow_sending_without_reply = true, String reply_markup = "");
+    bool sendTextMessage(int64_t chat_id, const String &text, const String &parse_mode = "Default", const String &entities = "", bool disable_web_page_preview = false, bool disable_notification = false, int32_t reply_to_message_id = 0, bool force_reply = false, bool allow_sending_without_reply = true, const String &reply_markup = "");
 
     // Forward a specific message to user or chat
     bool forwardMessage(const TBMessage &msg, const int32_t to_chatid);
@@ -163,7 +343,7 @@ public:
         return sendMessage(msg, message, keyboard);
     }
 
-    inline bool sendTo(const int64_t userid, const String &message, String keyboard = "") {
+    inline bool sendTo(const int64_t userid, const String &message, const String &keyboard = "") {
         return sendTo(userid, message.c_str(), keyboard.c_str() );
     }
 
@@ -270,7 +450,7 @@ public:
     // return:
     //   the bot name
     inline const char* getBotName() {
-        return m_botusername.c_str();
+        return m_botusername;
     }
 
     // Check for no new pending message
@@ -293,7 +473,8 @@ public:
     // params: pointer to inline keyboard
     inline void addInlineKeyboard(InlineKeyboard* keyb)
     {
-        m_keyboards[m_keyboardCount++] = keyb;
+        if (m_keyboardCount < m_maxKeyboards)
+            m_keyboards[m_keyboardCount++] = keyb;
     }
 
     // set custom commands for bot
@@ -323,42 +504,138 @@ public:
     //    keyboard: the new inline keyboard (if present)
     // return:
     //    true if success
-	bool editMessage(int32_t chat_id, int32_t message_id, const String& txt, const String &keyboard);
+	bool editMessage(int32_t chat_id, int32_t message_id, const String& txt, const char* keyboard);
+
+    inline bool editMessage(int32_t chat_id, int32_t message_id, const String& txt, const String &keyboard) {
+        return editMessage(chat_id, message_id, txt, keyboard.c_str());
+    }
 
     inline bool editMessage(const TBMessage &msg, const String& txt, const String &keyboard) {
 		return editMessage(msg.sender.id, msg.messageID, txt, keyboard);
 	}
 
     inline bool editMessage(int32_t chat_id, int32_t message_id, const String& txt, InlineKeyboard &keyboard) {
-        return editMessage(chat_id, message_id, txt, keyboard.getJSON());
+        return editMessage(chat_id, message_id, txt, keyboard.m_json.c_str());
     }
 
 	inline bool editMessage(const TBMessage &msg, const String& txt, InlineKeyboard &keyboard) {
-		return editMessage(msg.sender.id, msg.messageID, txt, keyboard.getJSON());
+		return editMessage(msg.sender.id, msg.messageID, txt, keyboard.m_json.c_str());
 	}
 
 	// check if connection with server is active
+    // params
+    //   resume: reconnection of an interrupted transfer, no backoff delay unless circuit breaker is open
     // returns
     //   true on connected
-    bool checkConnection();
+    bool checkConnection(bool resume = false);
+
+    // Allocator used for temporary buffers of this bot (ex. TelegramOTA)
+    inline TBAllocator& getAllocator() { return m_allocator; }
+
+protected:
+    // storage is provided by derived class (it's only stored here, not used while constructing)
+    AsyncTelegramBotBase(Client &client, JsonDocument &rxDoc, JsonDocument &txDoc, JsonDocument &auxDoc,
+                         char *rxBuffer, size_t rxSize, uint8_t *block, size_t blockSize,
+                         InlineKeyboard **keyboards, uint8_t maxKeyboards,
+                         TBAllocator &allocator = TBAllocator::getDefault());
 
 private:
+    friend class TelegramOTA;
     Client*         telegramClient;
+    TBAllocator&    m_allocator;
+    ClockFunction   m_clock = nullptr;
     const char*     m_token;
-    String          m_rxbuffer;
-    String          m_botusername;      // Store only botname, instead TBUser struct
+    const char*     m_host = TELEGRAM_HOST;
+    uint16_t        m_port = TELEGRAM_PORT;
+    char            m_botusername[33];  // Store only botname, instead TBUser struct (5-32 chars)
+
+    // Body of last server reply
+    char*           m_rxbuffer;
+    const size_t    m_rxSize;
+    size_t          m_rxLen = 0;
+
+    // Chunk buffer for uploads and downloads, also used to build requests header
+    uint8_t*        m_block;
+    const size_t    m_blockSize;
+
+    // Long-lived JSON documents: cleared and reused across calls in order
+    // to avoid heap fragmentation caused by repeated malloc/free cycles
+    JsonDocument&   m_rxDoc;            // updates received (TBMessage strings point here until next update)
+    JsonDocument&   m_txDoc;            // payload of requests and reply of blocking requests
+    JsonDocument&   m_auxDoc;           // JSON passed as text (keyboards, entities) to be merged in payload
 
     int32_t         m_lastUpdateId = 0;
     uint32_t        m_lastUpdateTime;
     uint32_t        m_minUpdateTime = MIN_UPDATE_TIME;
+    uint32_t        m_replyTimeout = SERVER_TIMEOUT;
+    uint32_t        m_uploadTimeout = UPLOAD_TIMEOUT;
+    uint32_t        m_requestTime = 0;  // when last request was sent
 
     uint32_t        m_lastmsg_timestamp;
     bool            m_waitingReply;
 
-    InlineKeyboard* m_keyboards[10];
+    InlineKeyboard** m_keyboards;
+    const uint8_t   m_maxKeyboards;
     uint8_t         m_keyboardCount = 0;
 
-    void setformData(int64_t chat_id, const char* cmd, const char* type, const char* propName, size_t size, String &formData, String& request);
+    TBDocument*     m_fileRequest = nullptr;    // Pending non-blocking getFile request
+    bool            m_fileRequestSent = false;
+    uint32_t        m_downloadRate = 0;
+
+    TBStats         m_stats = {};
+    int8_t          m_statsMethod = -1;     // slot of the request waiting for reply
+    TBResult        m_result = {};
+
+    TBHealth        m_health = {};
+    uint32_t        m_backoffMin = RECONNECT_MIN_DELAY;
+    uint32_t        m_backoffMax = RECONNECT_MAX_DELAY;
+    uint8_t         m_breakerThreshold = BREAKER_THRESHOLD;
+    uint32_t        m_outageStart = 0;      // first failure of current streak
+
+    TLSSession*     m_session = nullptr;
+
+#if defined(ESP8266) || defined(ESP32)
+    ResolveFunction m_resolve = hostByName;
+#else
+    ResolveFunction m_resolve = nullptr;
+#endif
+    uint32_t        m_dnsTtl = 0;
+    const char*     m_fallbackIPs = TELEGRAM_IP;
+    IPAddress       m_serverIP;
+    uint32_t        m_dnsExpire = 0;        // m_serverIP is used until this time
+    bool            m_dnsValid = false;     // m_serverIP is a working address
+    uint8_t         m_fallbackIndex = 0;    // next fallback IP
+
+    bool            m_prewarm = true;
+    bool            m_background = false;   // polling: connections are not on the critical path
+    bool            m_idleConnected = false; // connection was open and idle at last prewarm()
+    uint32_t        m_lastActivity = 0;     // last request sent or reply received
+    uint32_t        m_idleClose = 0;        // estimated idle timeout of server (ms)
+
+    // Dual connection mode: the connection not in use and the state of its request are parked here
+    Client*         m_otherClient = nullptr;
+    TLSSession*     m_sendSession = nullptr;
+    bool            m_polling = false;      // telegramClient is the polling connection
+    uint16_t        m_longPoll = LONG_POLL_TIMEOUT;
+    bool            m_otherWaiting = false;
+    uint32_t        m_otherRequestTime = 0;
+    int8_t          m_otherStatsMethod = -1;
+    bool            m_otherIdleConnected = false;
+    uint32_t        m_otherActivity = 0;
+    uint32_t        m_otherLastMsg = 0;     // watchdog of each connection (m_lastmsg_timestamp)
+
+#if TB_TRACE_ENABLE
+    TBTrace         m_trace;
+    int8_t          m_traceMethod = -1;     // slot of last request
+    uint32_t        m_traceTime = 0;        // end of last traced phase of request (us)
+    int8_t          m_otherTraceMethod = -1;
+    uint32_t        m_otherTraceTime = 0;
+#endif
+
+    // build header and form-data of a multipart upload request in m_block
+    // returns
+    //   the number of bytes to be sent (0 if m_block is too small)
+    size_t setformData(int64_t chat_id, const char* cmd, const char* type, const char* propName, size_t size);
     bool sendStream( int64_t chat_id, const char* command, const char* contentType, const char* binaryPropertyName, Stream& stream, size_t size);
     bool sendBuffer(int64_t chat_id, const char* cmd, const char* type, const char* propName, uint8_t *data, size_t size);
 
@@ -371,6 +648,92 @@ private:
     //   a string containing the Telegram JSON response
 
     bool sendCommand(const char* const &command, const char* payload, bool blocking = false);
+    // payload is a JSON document, serialized in m_block and sent a chunk at a time (no stack or heap buffer).
+    // A document that overflowed its capacity is not sent (request error in getLastResult())
+    bool sendCommand(const char* const &command, const JsonDocument &payload, bool blocking = false);
+    bool sendRequest(const char* command, const char* payload, const JsonDocument *doc, bool blocking);
+
+    // read the body of server reply in m_rxbuffer (truncated to buffer size)
+    // params
+    //   contentLength: bytes to be read, waiting for them until m_replyTimeout (0 read only bytes available)
+    // returns
+    //   the number of bytes stored (connection is dropped if body is incomplete)
+    size_t readBody(size_t contentLength = 0);
+
+    // read headers of server reply with a line buffer (no need to store the whole header)
+    // params
+    //   contentLength: the value of Content-Length header (0 if missing)
+    //   closed       : true if server is going to close the connection
+    //   timeout      : max wait for headers (ms)
+    // returns
+    //   the HTTP status code (0 if error)
+    int readHeaders(size_t &contentLength, bool &closed, uint32_t timeout);
+
+    // count a request sent to server
+    // params
+    //   method: Bot API method (string literal)
+    //   bytes : request size
+    void statsRequest(const char* method, size_t bytes);
+
+    // slot of method in m_stats.methods (added if missing)
+    // returns
+    //   -1 if table is full
+    int8_t statsSlot(const char* method);
+
+    // record the result of last request (m_result is reset)
+    // params
+    //   status: HTTP status of reply, 0 if reply was not received, -1 if request was not sent
+    void statsReply(int status);
+
+    // open again a connection closed by server, or replace one about to be closed, while idle
+    void prewarm(void);
+
+    // dual connection mode: swap telegramClient (and the state of its request) with the parked connection
+    // params
+    //   polling: true for the polling connection, false for the sending one
+    void selectConnection(bool polling);
+
+    // true in dual connection mode while the sending connection is in use
+    inline bool sendingConnection() const { return m_otherClient != nullptr && !m_polling; }
+
+    // read the reply of last request, waiting for it until m_replyTimeout
+    // returns
+    //   true if request succeeded
+    bool readReply(void);
+
+    // dual connection mode: read the reply of last request on sending connection
+    // params
+    //   wait: wait for the reply (only one request at a time on sending connection), otherwise
+    //         read it only if already received
+    void readSendReply(bool wait = false);
+
+    // true if a connection can be attempted now (not backing off after failures)
+    bool connectAllowed(void);
+
+    // address of server for next connection: cached, resolved or a fallback IP
+    // returns
+    //   false if the bot must connect by hostname
+    bool serverAddress(IPAddress &ip);
+
+    // next address of m_fallbackIPs
+    bool fallbackAddress(IPAddress &ip);
+
+    // default resolver
+    static bool hostByName(const char *host, IPAddress &ip, uint32_t timeout);
+
+    // update connection health and backoff delay
+    void connectionFailed(void);
+    void connectionSucceeded(void);
+
+    // decode the reply in m_rxbuffer into m_result
+    // returns
+    //   true if request succeeded
+    bool decodeResult(void);
+
+    // wait for the reply of an upload request (until m_uploadTimeout)
+    // returns
+    //   true if file was accepted by server
+    bool readUploadReply();
 
         // query server for new incoming messages
     // returns
@@ -379,6 +742,29 @@ private:
 
     bool getUpdates();
 
+    // send a polling request (or a queued getFile) and read its reply, on current connection
+    bool pollUpdates();
+
+    inline uint32_t now() { return m_clock != nullptr ? m_clock() : millis(); }
+
+#if TB_TRACE_ENABLE
+    // trace time in microseconds (virtual clock has millisecond resolution)
+    inline uint32_t traceNow() { return m_clock != nullptr ? m_clock() * 1000UL : micros(); }
+
+    // start tracing a request
+    inline void traceMethod(const char* method) {
+        m_traceMethod = statsSlot(method);
+        m_traceTime = traceNow();
+    }
+
+    // record the time elapsed since t in phase histogram of current request, then restart t
+    inline void trace(TBTracePhase phase, uint32_t &t) {
+        const uint32_t time = traceNow();
+        m_trace.record(m_traceMethod, phase, time - t);
+        t = time;
+    }
+#endif
+
     // get some information about the bot
     // params
     //   user: the data structure that will contains the data retreived
@@ -386,8 +772,94 @@ private:
     //   true if no error occurred
     bool getMe();
 
+    // fill document structure with the result of a getFile request
+    void setFileInfo(TBDocument &doc, JsonVariant result);
+
+    // the queued file request is done: document is filled with result (null if failed)
+    void endFileRequest(JsonVariant result);
+
+    // send an HTTP GET request for a range of remote file and skip response headers
+    // params
+    //   to    : last byte of range (0 until the end of file)
+    //   resume: request after a dropped connection
+    // returns
+    //   the HTTP status code (0 if error) and the length of content
+    int requestRange(const char* path, size_t from, size_t to, size_t &contentLength, bool resume);
+
+
+};
 
 
+// Bot with buffers sized and statically allocated at compile time, so different bots
+// can be defined in the same sketch. Template parameters:
+//   RxSize      : size of buffer for body of server reply
+//   DocSize     : capacity of JSON documents for updates and requests payload
+//   AuxDocSize  : capacity of JSON document for keyboards and entities
+//   ChunkSize   : size of chunks for upload and download of files
+//   MaxKeyboards: max number of inline keyboards with callback functions
+template <size_t RxSize = BUFFER_BIG, size_t DocSize = BUFFER_BIG, size_t AuxDocSize = BUFFER_MEDIUM,
+          size_t ChunkSize = BLOCK_SIZE, uint8_t MaxKeyboards = 10>
+class AsyncTelegramBotT : public AsyncTelegramBotBase
+{
+    static_assert(RxSize >= BUFFER_SMALL, "RxSize is too small for a Telegram server reply");
+    static_assert(DocSize >= BUFFER_SMALL, "DocSize is too small for a Telegram update");
+    static_assert(AuxDocSize >= 128, "AuxDocSize is too small for a keyboard");
+    static_assert(ChunkSize >= BUFFER_SMALL && ChunkSize <= 0xFFFF, "ChunkSize must be in range 512 - 65535 bytes (requests header is built here)");
+    static_assert(MaxKeyboards > 0 && MaxKeyboards <= MAX_INLINEKYB_CB, "MaxKeyboards must be in range 1 - MAX_INLINEKYB_CB");
+
+public:
+    AsyncTelegramBotT(Client &client) :
+        AsyncTelegramBotBase(client, m_rxDocStorage, m_txDocStorage, m_auxDocStorage,
+                             m_rxStorage, RxSize, m_blockStorage, ChunkSize,
+                             m_keyboardStorage, MaxKeyboards) {}
+
+private:
+    StaticJsonDocument<DocSize>     m_rxDocStorage;
+    StaticJsonDocument<DocSize>     m_txDocStorage;
+    StaticJsonDocument<AuxDocSize>  m_auxDocStorage;
+    char                            m_rxStorage[RxSize];
+    uint8_t                         m_blockStorage[ChunkSize];
+    InlineKeyboard*                 m_keyboardStorage[MaxKeyboards];
+};
+
+// Default bot, same buffers size of previous versions
+typedef AsyncTelegramBotT<> AsyncTelegramBot;
+
+
+// Buffers and JSON documents of AsyncTelegramBotDynamic, obtained from a TBAllocator.
+// It's a base class of bot, so storage is ready before the bot is constructed.
+class TBAllocatedStorage
+{
+protected:
+    TBAllocatedStorage(TBAllocator &allocator, size_t rxSize, size_t docSize, size_t auxDocSize,
+                       size_t chunkSize, uint8_t maxKeyboards);
+    ~TBAllocatedStorage();
+    TBAllocatedStorage(const TBAllocatedStorage &) = delete;
+    TBAllocatedStorage &operator=(const TBAllocatedStorage &) = delete;
+
+    TBAllocator&        m_storageAllocator;
+    TBJsonDocument      m_rxDocStorage;
+    TBJsonDocument      m_txDocStorage;
+    TBJsonDocument      m_auxDocStorage;
+    char*               m_rxStorage;
+    uint8_t*            m_blockStorage;
+    InlineKeyboard**    m_keyboardStorage;
+};
+
+// Bot with buffers sized at runtime and allocated with a custom allocator
+// (ex. PSRAMAllocator in order to move the big buffers in external memory of ESP32).
+// begin() returns false if allocator was unable to provide the buffers.
+class AsyncTelegramBotDynamic : private TBAllocatedStorage, public AsyncTelegramBotBase
+{
+public:
+    AsyncTelegramBotDynamic(Client &client, TBAllocator &allocator,
+                            size_t rxSize = BUFFER_BIG, size_t docSize = BUFFER_BIG,
+                            size_t auxDocSize = BUFFER_MEDIUM, size_t chunkSize = BLOCK_SIZE,
+                            uint8_t maxKeyboards = 10) :
+        TBAllocatedStorage(allocator, rxSize, docSize, auxDocSize, chunkSize, maxKeyboards),
+        AsyncTelegramBotBase(client, m_rxDocStorage, m_txDocStorage, m_auxDocStorage,
+                             m_rxStorage, rxSize, m_blockStorage, chunkSize,
+                             m_keyboardStorage, maxKeyboards, allocator) {}
 };
 
 #endif
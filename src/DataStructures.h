@@ -43,11 +43,15 @@ struct TBContact {
   const char*  vCard;
 };
 
+#ifndef TB_FILE_NAME_SIZE
+#define TB_FILE_NAME_SIZE   64      // longer document names are shortened in the middle (extension is kept)
+#endif
+
 struct TBDocument {
-  bool         file_exists;
+  bool         file_exists = false;   // true when file_path was resolved (getFile or requestFile)
   int32_t      file_size;
-  const char*  file_id;
-  const char*  file_name;
+  String       file_id;
+  char         file_name[TB_FILE_NAME_SIZE] = "";   // copied: still valid after next update
   String	   file_path;
 };
 
@@ -71,5 +75,89 @@ struct TBMessage {
   String      	text;
 };
 
+#ifndef TB_STATS_METHODS
+#define TB_STATS_METHODS    12      // Bot API methods tracked by statistics
+#endif
+
+// Counters of a Bot API method. Latency is the time from request sent to reply headers received
+struct TBMethodStats {
+  const char*   method;             // method name (nullptr if slot is unused)
+  uint32_t      calls;
+  uint32_t      errors;             // reply missing or HTTP status != 200
+  uint32_t      replies;            // replies received (latency samples)
+  uint32_t      latencyMin;
+  uint32_t      latencyMax;
+  uint32_t      latencyTotal;
+  inline uint32_t latencyAvg() const { return replies ? latencyTotal / replies : 0; }
+};
+
+// Runtime statistics of the bot (see AsyncTelegramBot::getStats())
+struct TBStats {
+  TBMethodStats methods[TB_STATS_METHODS];
+  uint32_t      bytesSent;
+  uint32_t      bytesReceived;
+  uint32_t      handshakes;         // successful connections to server
+  uint32_t      handshakeTime;      // total time of successful connections, TLS handshake included (ms)
+  uint32_t      handshakeTimeMax;
+  uint32_t      resumedHandshakes;  // connections that resumed the TLS session (see setTLSSession())
+  uint32_t      resumedHandshakeTime;
+  uint32_t      dnsLookups;         // DNS resolutions of server address (see setDnsCache())
+  uint32_t      dnsFailures;
+  uint32_t      dnsTime;            // total time of DNS lookups (ms)
+  uint32_t      criticalHandshakes; // connections opened by a request of the sketch (the request waited for them)
+  uint32_t      prewarms;           // connections opened in advance while idle (see setPrewarm())
+  uint32_t      connectFailures;
+  uint32_t      reconnects;         // connections dropped by the bot after an error (reset)
+  uint32_t      timeouts;           // replies not received in time
+  uint32_t      rateLimited;        // HTTP 429 replies
+  uint32_t      parseFailures;      // replies that are not valid JSON (or truncated)
+  uint32_t      truncatedReplies;   // replies longer than the receive buffer (RxSize)
+  uint32_t      droppedUpdates;     // updates received but not supported (skipped)
+  uint8_t       pendingReplies;     // requests waiting for reply (current value)
+  uint8_t       queuedRequests;     // requests queued, ex. requestFile() (current value)
+  uint8_t       keyboards;          // inline keyboards with callbacks (current value)
+  uint32_t      idleClose;          // estimated idle timeout of server connections, ms (current value, 0 unknown)
+
+  // average time of full and resumed handshakes (ms)
+  inline uint32_t fullHandshakeAvg() const {
+    return handshakes > resumedHandshakes ?
+      (handshakeTime - resumedHandshakeTime) / (handshakes - resumedHandshakes) : 0;
+  }
+  inline uint32_t resumedHandshakeAvg() const {
+    return resumedHandshakes ? resumedHandshakeTime / resumedHandshakes : 0;
+  }
+};
+
+// Circuit breaker of connection with server (see AsyncTelegramBot::getHealth())
+enum TBBreakerState {
+  BreakerClosed,                    // server is working
+  BreakerOpen,                      // too many consecutive failures: requests fail without connecting
+  BreakerHalfOpen                   // probe connection after backoff delay
+};
+
+// Health of connection with server
+struct TBHealth {
+  TBBreakerState state;
+  uint16_t      consecutiveFailures; // failed connections and missing replies since last reply
+  uint32_t      lastSuccess;        // time of last reply received (ms)
+  uint32_t      lastFailure;
+  uint32_t      backoff;            // current delay between connection attempts (ms)
+  uint32_t      retryTime;          // no connection is attempted before this time (ms)
+  uint32_t      outages;            // times the circuit breaker has opened
+  uint32_t      lastRecovery;       // duration of last failure streak, from first failure to next reply (ms)
+  uint32_t      maxRecovery;
+};
+
+// Decoded reply of last Bot API request (see AsyncTelegramBot::getLastResult())
+struct TBResult {
+  int16_t       status;             // HTTP status (0 reply not received, -1 request not sent)
+  bool          ok;                 // request succeeded (HTTP 200 and "ok":true)
+  int16_t       errorCode;          // "error_code" of failed request (HTTP status if missing)
+  char          description[80];    // "description" of failed request (truncated)
+  bool          truncated;          // reply was longer than the receive buffer (RxSize): the rest is lost
+  uint32_t      retryAfter;         // parameters.retry_after: seconds to wait before repeating request (429)
+  int64_t       migrateToChatId;    // parameters.migrate_to_chat_id: group moved to a supergroup
+};
+
 #endif
 
@@ -1,35 +1,72 @@
 #include "InlineKeyboard.h"
+#include "TBHeapScope.h"
+#include <new>
 
-
-InlineKeyboard::InlineKeyboard()
+// Reserve storage once: JSON is then rebuilt in place, sending it doesn't need any copy
+InlineKeyboard::InlineKeyboard(TBAllocator &allocator) : m_allocator(allocator), m_json(allocator, BUFFER_SMALL)
 {
-  m_json = "{\"inline_keyboard\":[[]]}\"";
+  m_json.assign("{\"inline_keyboard\":[[]]}");
 }
 
-InlineKeyboard::~InlineKeyboard(){}
+InlineKeyboard::~InlineKeyboard()
+{
+  InlineButton *button = _firstButton;
+  while (button != nullptr) {
+    InlineButton *next = button->nextButton;
+    button->~InlineButton();
+    m_allocator.deallocate(button);
+    button = next;
+  }
+}
 
 bool InlineKeyboard::addRow()
 {
-  // if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  // DynamicJsonDocument doc(m_jsonSize + 128);	 // Current size + space for new row (empty)
-  
-  StaticJsonDocument<BUFFER_MEDIUM> doc;
-  deserializeJson(doc, m_json);
+  TB_HEAP_SCOPE("InlineKeyboard::addRow");
+  // Current size + space for new row (empty)
+  TBJsonDocument doc(m_json.jsonCapacity() + JSON_ARRAY_SIZE(1), TBJsonAllocator(m_allocator));
+  if (deserializeJson(doc, m_json.c_str()))
+    return false;
   JsonArray  rows = doc["inline_keyboard"];
-  rows.createNestedArray();
-  m_json = "";
-  serializeJson(doc, m_json);
-  //doc.shrinkToFit();
-  m_jsonSize = doc.memoryUsage();
-  return true;
+  if (rows.createNestedArray().isNull())
+    return false;
+  return m_json.assign(doc);
 }
 
 bool InlineKeyboard::addButton(const char* text, const char* command, InlineKeyboardButtonType buttonType, CallbackType onClick)
 {
+  TB_HEAP_SCOPE("InlineKeyboard::addButton");
   if ((buttonType != KeyboardButtonURL) && (buttonType != KeyboardButtonQuery))
     return false;
 
-  InlineButton *inlineButton = new InlineButton();
+  void *buttonMemory = m_allocator.allocate(sizeof(InlineButton));
+  if (buttonMemory == nullptr)
+    return false;
+
+  // As reccomended use local JsonDocument instead global
+  // inline keyboard json structure will be stored in a TBTextBuffer.
+  // Current size + space for new object (button) with a copy of its strings
+  TBJsonDocument doc(m_json.jsonCapacity() + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(2) + strlen(text) + strlen(command) + 2,
+                     TBJsonAllocator(m_allocator));
+  JsonObject button;
+  if (!deserializeJson(doc, m_json.c_str())) {
+    JsonArray  rows = doc["inline_keyboard"];
+    button = rows[rows.size()-1].createNestedObject();
+  }
+  if (!button.isNull()) {
+    button["text"] = text ;
+    if(KeyboardButtonURL == buttonType)
+      button["url"] = command;
+    else if (KeyboardButtonQuery == buttonType)
+      button["callback_data"] = command;
+  }
+
+  // Store inline keyboard json structure (document too small or no memory: keyboard is unchanged)
+  if (button.isNull() || doc.overflowed() || !m_json.assign(doc)) {
+    m_allocator.deallocate(buttonMemory);
+    return false;
+  }
+
+  InlineButton *inlineButton = new (buttonMemory) InlineButton();
   if (_firstButton == nullptr)
     _firstButton = inlineButton;
   else
@@ -38,29 +75,6 @@ bool InlineKeyboard::addButton(const char* text, const char* command, InlineKeyb
   inlineButton->btnName = (char*)command;
   _lastButton = inlineButton;
   m_buttonsCounter++;
-
-  // As reccomended use local JsonDocument instead global
-  // inline keyboard json structure will be stored in a String var
-  //if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  // DynamicJsonDocument doc(m_jsonSize + 256);	 // Current size + space for new object (button)
-  StaticJsonDocument<BUFFER_MEDIUM> doc;
-  deserializeJson(doc, m_json);
-
-  JsonArray  rows = doc["inline_keyboard"];
-  JsonObject button = rows[rows.size()-1].createNestedObject();
-
-  button["text"] = text ;
-  if(KeyboardButtonURL == buttonType)
-    button["url"] = command;
-  else if (KeyboardButtonQuery == buttonType)
-    button["callback_data"] = command;
-
-  // Store inline keyboard json structure
-  m_json = "";
-  serializeJson(doc, m_json);
-
-  //doc.shrinkToFit();
-  //m_jsonSize = doc.memoryUsage();
   return true;
 }
 
@@ -82,18 +96,16 @@ int InlineKeyboard::getButtonsNumber()
 
 String InlineKeyboard::getJSON() const
 {
-  return m_json;
+  return String(m_json.c_str());
 }
 
 String InlineKeyboard::getJSONPretty() const
 {
-  //uint16_t jsonSize;
-  //if(m_jsonSize < BUFFER_SMALL) jsonSize = BUFFER_SMALL;
-  //DynamicJsonDocument doc(jsonSize + 128);	// Current size + space for new lines
-  StaticJsonDocument<BUFFER_MEDIUM> doc;
-  deserializeJson(doc, m_json);
-
+  TBJsonDocument doc(m_json.jsonCapacity(), TBJsonAllocator(m_allocator));
   String serialized;
+  if (deserializeJson(doc, m_json.c_str()))
+    return serialized;
+
   serializeJsonPretty(doc, serialized);
   return serialized;
 }
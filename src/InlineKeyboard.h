@@ -7,6 +7,7 @@
 #include <ArduinoJson.h>
 #include <functional>
 #include "DataStructures.h"
+#include "TBAllocator.h"
 
 enum InlineKeyboardButtonType
 {
@@ -27,9 +28,13 @@ class InlineKeyboard
   };
 
 public:
-  InlineKeyboard();
-  InlineKeyboard(const String &keyboard);
+  // params:
+  //   allocator: source of memory for buttons and JSON (optional)
+  InlineKeyboard(TBAllocator &allocator = TBAllocator::getDefault());
   ~InlineKeyboard();
+  // Buttons and JSON are owned by the keyboard (and registered callbacks point to it): not copyable
+  InlineKeyboard(const InlineKeyboard &) = delete;
+  InlineKeyboard &operator=(const InlineKeyboard &) = delete;
 
   // Get total number of keyboard buttons
   int getButtonsNumber();
@@ -56,10 +61,10 @@ public:
   String getJSONPretty(void) const;
 
 private:
-  friend class AsyncTelegramBot;
-  String m_json;
+  friend class AsyncTelegramBotBase;
+  TBAllocator &m_allocator;
+  TBTextBuffer m_json;
   String m_name;
-  size_t m_jsonSize = BUFFER_MEDIUM;
 
   uint8_t m_buttonsCounter = 0;
   InlineButton *_firstButton = nullptr;
@@ -0,0 +1,206 @@
+#include "KeyPinning.h"
+#include "sha256.h"
+#include "serial_log.h"
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+#include <mbedtls/pk.h>
+#include <mbedtls/x509_crt.h>
+#endif
+
+static int8_t base64Value(char c)
+{
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+bool KeyPinSet::addPin(const char *base64)
+{
+  if (strncmp(base64, "sha256//", 8) == 0)
+    base64 += 8;
+  uint8_t hash[32];
+  size_t len = 0;
+  uint32_t bits = 0;
+  uint8_t count = 0;
+  for (const char *p = base64; *p && *p != '='; p++) {
+    const int8_t value = base64Value(*p);
+    if (value < 0)
+      return false;
+    bits = (bits << 6) | value;
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      if (len == sizeof(hash))
+        return false;
+      hash[len++] = bits >> count;
+    }
+  }
+  return len == sizeof(hash) && addPin(hash);
+}
+
+bool KeyPinSet::addPin(const uint8_t hash[32])
+{
+  if (m_count >= MAX_KEY_PINS)
+    return false;
+  memcpy(m_pins[m_count++], hash, 32);
+  return true;
+}
+
+bool KeyPinSet::matchHash(const uint8_t hash[32]) const
+{
+  for (uint8_t i = 0; i < m_count; i++) {
+    if (memcmp(m_pins[i], hash, 32) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool KeyPinSet::matchKey(const uint8_t *spki, size_t len) const
+{
+  if (spki == nullptr || len == 0)
+    return false;
+  TBSha256 sha;
+  uint8_t hash[32];
+  sha.update(spki, len);
+  sha.finalize(hash);
+  return matchHash(hash);
+}
+
+int PinnedClient::connect(IPAddress ip, uint16_t port)
+{
+  return connectTo(ip, port);
+}
+
+int PinnedClient::connect(const char *host, uint16_t port)
+{
+  return connectTo(host, port);
+}
+
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+int PinnedClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return connectTo(ip, port, timeout);
+}
+
+int PinnedClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  return connectTo(host, port, timeout);
+}
+#endif
+
+template <typename Host>
+int PinnedClient::connectClient(Host host, uint16_t port, int32_t timeout)
+{
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  if (timeout >= 0)
+    return m_client.connect(host, port, timeout);
+#endif
+  (void)timeout;
+  return m_client.connect(host, port);
+}
+
+template <typename Host>
+int PinnedClient::connectTo(Host host, uint16_t port, int32_t timeout)
+{
+  if (m_chainLeft == 0 || !m_fallback) {
+    // An empty set matches no key
+    if (m_pins.count() && m_pinning.usePins(m_pins) && connectClient(host, port, timeout)) {
+      // Nothing has been sent yet: a connection with a key not pinned is dropped
+      if (m_pinning.verifyPins(m_pins)) {
+        m_pinned++;
+        return 1;
+      }
+      m_client.stop();
+    }
+    if (!m_fallback) {
+      log_error("Server key not pinned (or connection failed), no fallback to chain");
+      return 0;
+    }
+    // Key not pinned or connection failed: certificate chain decides
+    if (!connectChain(host, port, timeout))
+      return 0;
+    log_error("Server key not pinned, certificate chain verified");
+    m_fallbacks++;
+    m_chainLeft = PIN_RETRY_CONNECTS;
+    return 1;
+  }
+
+  m_chainLeft--;
+  return connectChain(host, port, timeout);
+}
+
+template <typename Host>
+int PinnedClient::connectChain(Host host, uint16_t port, int32_t timeout)
+{
+  m_pinning.useChain();
+  if (!connectClient(host, port, timeout))
+    return 0;
+  if (!m_pinning.verifyChain()) {
+    log_error("Certificate chain not valid, connection refused");
+    m_client.stop();
+    return 0;
+  }
+  m_chain++;
+  return 1;
+}
+
+#if defined(ESP8266)
+bool BearSSLPinning::addKey(const uint8_t *spki, size_t len)
+{
+  if (m_keyCount >= MAX_KEY_PINS)
+    return false;
+  m_keys[m_keyCount] = spki;
+  m_keyLen[m_keyCount++] = len;
+  return true;
+}
+
+bool BearSSLPinning::usePins(const KeyPinSet &pins)
+{
+  // Handshake with the selected key failed (ex. server key rotated): try the next one
+  if (!m_keyConnected && m_keyCount)
+    m_selected = (m_selected + 1) % m_keyCount;
+  m_keyConnected = false;
+  for (uint8_t i = 0; i < m_keyCount; i++) {
+    const uint8_t key = (m_selected + i) % m_keyCount;
+    if (pins.matchKey(m_keys[key], m_keyLen[key]) && m_key.parse(m_keys[key], m_keyLen[key])) {
+      m_selected = key;
+      m_client.setKnownKey(&m_key);
+      return true;
+    }
+  }
+  return false;
+}
+
+#elif defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+bool MbedTLSPinning::verifyPins(const KeyPinSet &pins)
+{
+  const mbedtls_x509_crt *cert = m_client.getPeerCertificate();
+  if (cert == nullptr)
+    return false;
+  // Public key is written at the end of buffer
+  uint8_t der[600];
+  int len = mbedtls_pk_write_pubkey_der((mbedtls_pk_context *)&cert->pk, der, sizeof(der));
+  if (len <= 0)
+    return false;
+  return pins.matchKey(der + sizeof(der) - len, len);
+}
+
+bool MbedTLSPinning::verifyChain()
+{
+  if (!m_insecure)
+    return true;
+  const mbedtls_x509_crt *cert = m_client.getPeerCertificate();
+  if (cert == nullptr || m_caCert == nullptr)
+    return false;
+  // PEM is parsed with its terminator
+  mbedtls_x509_crt ca;
+  mbedtls_x509_crt_init(&ca);
+  uint32_t flags = 0;
+  const bool valid = mbedtls_x509_crt_parse(&ca, (const unsigned char *)m_caCert, strlen(m_caCert) + 1) == 0 &&
+                     mbedtls_x509_crt_verify((mbedtls_x509_crt *)cert, &ca, nullptr, m_host, &flags, nullptr, nullptr) == 0;
+  mbedtls_x509_crt_free(&ca);
+  return valid;
+}
+#endif
@@ -0,0 +1,212 @@
+
+#ifndef KEY_PINNING
+#define KEY_PINNING
+
+#include <Arduino.h>
+#include "Client.h"
+
+#ifndef MAX_KEY_PINS
+#define MAX_KEY_PINS        4       // public keys pinned (ex. current and next key of server)
+#endif
+#ifndef PIN_RETRY_CONNECTS
+#define PIN_RETRY_CONNECTS  32      // after a fallback, pins are tried again every N connections
+#endif
+
+// Set of pinned public keys. A pin is the SHA-256 of the server SubjectPublicKeyInfo (DER),
+// in base64 like curl --pinnedpubkey and HPKP:
+//   openssl s_client -connect api.telegram.org:443 </dev/null | openssl x509 -pubkey -noout |
+//   openssl pkey -pubin -outform der | openssl dgst -sha256 -binary | base64
+class KeyPinSet
+{
+public:
+  // add a pin ("sha256//" prefix is optional)
+  // returns
+  //   false if pin is not valid or set is full
+  bool addPin(const char *base64);
+  bool addPin(const uint8_t hash[32]);
+
+  // true if the SHA-256 of public key (SubjectPublicKeyInfo, DER) is pinned
+  bool matchKey(const uint8_t *spki, size_t len) const;
+  bool matchHash(const uint8_t hash[32]) const;
+
+  inline uint8_t count() const { return m_count; }
+  inline void clear() { m_count = 0; }
+
+private:
+  uint8_t m_pins[MAX_KEY_PINS][32];
+  uint8_t m_count = 0;
+};
+
+
+// Optional capability of a TLS client: verify the server with pinned keys only (fast path,
+// no certificate chain validation) or with the certificate chain (trust anchors, CA)
+class TLSPinning
+{
+public:
+  virtual ~TLSPinning() {}
+
+  // next connections check the server key against pins
+  // returns
+  //   false if no key can be checked against pins (connection is not attempted)
+  virtual bool usePins(const KeyPinSet &pins) = 0;
+
+  // next connections validate the certificate chain
+  virtual void useChain(void) = 0;
+
+  // called after connect() in pins mode, before any data is sent. Clients checking the key
+  // during the handshake (ex. BearSSL known key) don't need to override it
+  // returns
+  //   true if server key is pinned
+  virtual bool verifyPins(const KeyPinSet &pins) { (void)pins; return true; }
+
+  // called after connect() in chain mode, before any data is sent. Clients that can't be
+  // switched back from pins mode to chain validation check the chain here
+  // returns
+  //   true if certificate chain is valid
+  virtual bool verifyChain(void) { return true; }
+};
+
+
+// Client decorator: connect only to a server with a pinned key. Connections fail if the key
+// doesn't match or the set is empty, unless fallback to certificate chain validation is
+// enabled (ex. keys rotated by Telegram): after a fallback, pins are tried again every
+// PIN_RETRY_CONNECTS connections
+class PinnedClient : public Client
+{
+public:
+  PinnedClient(Client &client, TLSPinning &pinning, const KeyPinSet &pins) :
+    m_client(client), m_pinning(pinning), m_pins(pins) {}
+
+  // allow fallback to chain validation when server key is not pinned (default false)
+  inline void setFallback(bool fallback) { m_fallback = fallback; }
+
+  // connections verified by pinned keys, by certificate chain and fallbacks from pins to chain
+  inline uint32_t getPinnedCount() const { return m_pinned; }
+  inline uint32_t getChainCount() const { return m_chain; }
+  inline uint32_t getFallbackCount() const { return m_fallbacks; }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char *host, uint16_t port, int32_t timeout) override;
+#endif
+  size_t write(uint8_t data) override { return m_client.write(data); }
+  size_t write(const uint8_t *buf, size_t size) override { return m_client.write(buf, size); }
+  int available() override { return m_client.available(); }
+  int read() override { return m_client.read(); }
+  int read(uint8_t *buf, size_t size) override { return m_client.read(buf, size); }
+  int peek() override { return m_client.peek(); }
+  void flush() override { m_client.flush(); }
+  void stop() override { m_client.stop(); }
+  uint8_t connected() override { return m_client.connected(); }
+  operator bool() override { return m_client; }
+
+private:
+  Client            &m_client;
+  TLSPinning        &m_pinning;
+  const KeyPinSet   &m_pins;
+  bool              m_fallback = false;
+  uint16_t          m_chainLeft = 0;    // connections with chain validation before trying pins again
+  uint32_t          m_pinned = 0;
+  uint32_t          m_chain = 0;
+  uint32_t          m_fallbacks = 0;
+
+  // timeout < 0: default timeout of the client
+  template <typename Host>
+  int connectTo(Host host, uint16_t port, int32_t timeout = -1);
+  template <typename Host>
+  int connectChain(Host host, uint16_t port, int32_t timeout);
+  template <typename Host>
+  int connectClient(Host host, uint16_t port, int32_t timeout);
+};
+
+
+#if defined(ESP8266)
+#include <WiFiClientSecureBearSSL.h>
+
+// Pinning with BearSSL client (ESP8266): the known key is checked during the handshake.
+// BearSSL accepts only one known key: it's chosen among the keys added whose pin is in the set.
+// If a connection with a key fails, next connection tries the next pinned key (ex. rotated key)
+class BearSSLPinning : public TLSPinning
+{
+public:
+  BearSSLPinning(BearSSL::WiFiClientSecure &client, const BearSSL::X509List &chain) :
+    m_client(client), m_chain(chain) {}
+
+  // add a public key of server (SubjectPublicKeyInfo, DER), the buffer must stay valid
+  // returns
+  //   false if too many keys
+  bool addKey(const uint8_t *spki, size_t len);
+
+  bool usePins(const KeyPinSet &pins) override;
+  bool verifyPins(const KeyPinSet &) override { m_keyConnected = true; return true; }
+
+  void useChain(void) override {
+    m_client.setKnownKey(nullptr);
+    m_client.setTrustAnchors(&m_chain);
+  }
+
+private:
+  BearSSL::WiFiClientSecure &m_client;
+  const BearSSL::X509List   &m_chain;
+  BearSSL::PublicKey        m_key;
+  const uint8_t             *m_keys[MAX_KEY_PINS];
+  size_t                    m_keyLen[MAX_KEY_PINS];
+  uint8_t                   m_keyCount = 0;
+  uint8_t                   m_selected = 0;
+  bool                      m_keyConnected = true;  // last connection with the selected key succeeded
+};
+
+#elif defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+#include <WiFiClientSecure.h>
+
+// Pinning with mbedTLS client (ESP32): chain validation is skipped in pins mode and
+// the key of peer certificate is checked after the handshake.
+// setCACert() doesn't leave the insecure mode on every core version: once pins mode has been
+// used, the peer certificate chain and its hostname (host) are verified again with the CA after
+// chain mode handshakes
+class MbedTLSPinning : public TLSPinning
+{
+public:
+  MbedTLSPinning(WiFiClientSecure &client, const char *caCert, const char *host = "api.telegram.org") :
+    m_client(client), m_caCert(caCert), m_host(host) {}
+
+  // client certificate and key (mutual TLS): setInsecure() clears them, so set them here and not
+  // on the client, they are set again at each connection
+  inline void setClientCertificate(const char *cert, const char *key) {
+    m_clientCert = cert;
+    m_clientKey = key;
+  }
+
+  bool usePins(const KeyPinSet &) override {
+    m_client.setInsecure();
+    m_insecure = true;
+    setClientKey();
+    return true;
+  }
+  void useChain(void) override {
+    m_client.setCACert(m_caCert);
+    setClientKey();
+  }
+  bool verifyPins(const KeyPinSet &pins) override;
+  bool verifyChain(void) override;
+
+private:
+  WiFiClientSecure  &m_client;
+  const char        *m_caCert;
+  const char        *m_host;
+  const char        *m_clientCert = nullptr;
+  const char        *m_clientKey = nullptr;
+  bool              m_insecure = false;
+
+  inline void setClientKey(void) {
+    if (m_clientCert != nullptr && m_clientKey != nullptr) {
+      m_client.setCertificate(m_clientCert);
+      m_client.setPrivateKey(m_clientKey);
+    }
+  }
+};
+#endif
+
+#endif
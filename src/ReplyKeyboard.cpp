@@ -1,110 +1,106 @@
 #include "ReplyKeyboard.h"
-
-ReplyKeyboard::ReplyKeyboard()
-{
-  m_json = "{\"keyboard\":[[]]}\"";
-}
-
-ReplyKeyboard::~ReplyKeyboard() {}
-
-
-bool ReplyKeyboard::addRow()
-{
-  if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(m_jsonSize + 128);	 // Current size + space for new row (empty)
-
-  deserializeJson(doc, m_json);
-  JsonArray rows = doc["keyboard"];
-  rows.createNestedArray();
-  m_json = "";
-  serializeJson(doc, m_json);
-  doc.shrinkToFit();
-  m_jsonSize = doc.memoryUsage();
-  return true;
-}
-
-
-bool ReplyKeyboard::addButton(const char* text, ReplyKeyboardButtonType buttonType)
-{
-  if ((buttonType != KeyboardButtonContact) &&
-    (buttonType != KeyboardButtonLocation) &&
-    (buttonType != KeyboardButtonSimple))
-    return false;
-  // As reccomended use local JsonDocument instead global
-  // inline keyboard json structure will be stored in a String var
-  if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(m_jsonSize + 256);	 // Current size + space for new object (button)
-  deserializeJson(doc, m_json);
-
-  JsonArray  rows = doc["keyboard"];
-  JsonObject button = rows[rows.size()-1].createNestedObject();
-
-  button["text"] = text;
-  switch (buttonType){
-    case KeyboardButtonContact:
-      button["request_contact"] = true;
-      break;
-    case KeyboardButtonLocation:
-      button["request_location"] = true;
-      break;
-    default:
-      break;
-  }
-
-  // Store inline keyboard json structure
-  m_json = "";
-  serializeJson(doc, m_json);
-  doc.shrinkToFit();
-  m_jsonSize = doc.memoryUsage();
-  return true;
-}
-
-
-void ReplyKeyboard::enableResize()
-{
-  if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(m_jsonSize + 128);   // Current size + space for new field
-  deserializeJson(doc, m_json);
-  doc["resize_keyboard"] = true;
-  m_json = "";
-  serializeJson(doc, m_json);
-}
-
-void ReplyKeyboard::enableOneTime()
-{
-  if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(m_jsonSize + 128);	// Current size + space for new field
-  deserializeJson(doc, m_json);
-  doc["one_time_keyboard"] = true;
-  m_json = "";
-  serializeJson(doc, m_json);
-}
-
-void ReplyKeyboard::enableSelective()
-{
-  if(m_jsonSize < BUFFER_MEDIUM) m_jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(m_jsonSize + 128);  // Current size + space for new field
-  deserializeJson(doc, m_json);
-  doc["selective"] = true;
-  m_json = "";
-  serializeJson(doc, m_json);
-}
-
-String ReplyKeyboard::getJSON() const
-{
-  return m_json;
-}
-
-String ReplyKeyboard::getJSONPretty() const
-{
-  uint16_t jsonSize;
-  if(m_jsonSize < BUFFER_MEDIUM) jsonSize = BUFFER_MEDIUM;
-  DynamicJsonDocument doc(jsonSize + 128);	// Current size + space for new lines
-  deserializeJson(doc, m_json);
-
-  String serialized;
-  serializeJsonPretty(doc, serialized);
-  return serialized;
-}
-
-
+#include "TBHeapScope.h"
+
+// Reserve storage once: JSON is then rebuilt in place, sending it doesn't need any copy
+ReplyKeyboard::ReplyKeyboard(TBAllocator &allocator) : m_allocator(allocator), m_json(allocator, BUFFER_SMALL)
+{
+  m_json.assign("{\"keyboard\":[[]]}");
+}
+
+ReplyKeyboard::~ReplyKeyboard() {}
+
+
+bool ReplyKeyboard::addRow()
+{
+  TB_HEAP_SCOPE("ReplyKeyboard::addRow");
+  // Current size + space for new row (empty)
+  TBJsonDocument doc(m_json.jsonCapacity() + JSON_ARRAY_SIZE(1), TBJsonAllocator(m_allocator));
+
+  if (deserializeJson(doc, m_json.c_str()))
+    return false;
+  JsonArray rows = doc["keyboard"];
+  if (rows.createNestedArray().isNull())
+    return false;
+  return m_json.assign(doc);
+}
+
+
+bool ReplyKeyboard::addButton(const char* text, ReplyKeyboardButtonType buttonType)
+{
+  TB_HEAP_SCOPE("ReplyKeyboard::addButton");
+  if ((buttonType != KeyboardButtonContact) &&
+    (buttonType != KeyboardButtonLocation) &&
+    (buttonType != KeyboardButtonSimple))
+    return false;
+  // As reccomended use local JsonDocument instead global
+  // inline keyboard json structure will be stored in a TBTextBuffer.
+  // Current size + space for new object (button) with a copy of its text
+  TBJsonDocument doc(m_json.jsonCapacity() + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(2) + strlen(text) + 1,
+                     TBJsonAllocator(m_allocator));
+  if (deserializeJson(doc, m_json.c_str()))
+    return false;
+
+  JsonArray  rows = doc["keyboard"];
+  JsonObject button = rows[rows.size()-1].createNestedObject();
+  if (button.isNull())
+    return false;
+
+  button["text"] = text;
+  switch (buttonType){
+    case KeyboardButtonContact:
+      button["request_contact"] = true;
+      break;
+    case KeyboardButtonLocation:
+      button["request_location"] = true;
+      break;
+    default:
+      break;
+  }
+
+  // Store inline keyboard json structure
+  if (doc.overflowed())
+    return false;
+  return m_json.assign(doc);
+}
+
+
+void ReplyKeyboard::setOption(const char *name)
+{
+  TBJsonDocument doc(m_json.jsonCapacity() + JSON_OBJECT_SIZE(1), TBJsonAllocator(m_allocator));
+  if (deserializeJson(doc, m_json.c_str()))
+    return;
+  doc[name] = true;
+  if (!doc.overflowed())
+    m_json.assign(doc);
+}
+
+void ReplyKeyboard::enableResize()
+{
+  setOption("resize_keyboard");
+}
+
+void ReplyKeyboard::enableOneTime()
+{
+  setOption("one_time_keyboard");
+}
+
+void ReplyKeyboard::enableSelective()
+{
+  setOption("selective");
+}
+
+String ReplyKeyboard::getJSON() const
+{
+  return String(m_json.c_str());
+}
+
+String ReplyKeyboard::getJSONPretty() const
+{
+  TBJsonDocument doc(m_json.jsonCapacity(), TBJsonAllocator(m_allocator));
+  String serialized;
+  if (deserializeJson(doc, m_json.c_str()))
+    return serialized;
+
+  serializeJsonPretty(doc, serialized);
+  return serialized;
+}
@@ -6,6 +6,7 @@
 #define ARDUINOJSON_DECODE_UNICODE  1
 #include <ArduinoJson.h>
 #include "DataStructures.h"
+#include "TBAllocator.h"
 
 enum ReplyKeyboardButtonType {
   KeyboardButtonSimple   = 1,
@@ -17,12 +18,21 @@ enum ReplyKeyboardButtonType {
 class ReplyKeyboard
 {
 private:
-  String m_json;
-  size_t m_jsonSize = BUFFER_MEDIUM;
+  friend class AsyncTelegramBotBase;
+  TBAllocator &m_allocator;
+  TBTextBuffer m_json;
+
+  // set a boolean option of keyboard
+  void setOption(const char *name);
 
 public:
-  ReplyKeyboard();
+  // params:
+  //   allocator: source of memory for JSON (optional)
+  ReplyKeyboard(TBAllocator &allocator = TBAllocator::getDefault());
   ~ReplyKeyboard();
+  // JSON is owned by the keyboard: not copyable
+  ReplyKeyboard(const ReplyKeyboard &) = delete;
+  ReplyKeyboard &operator=(const ReplyKeyboard &) = delete;
 
   // add a new empty row of buttons
   // return:
@@ -0,0 +1,307 @@
+#include "TBAllocator.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+TBAllocator &TBAllocator::getDefault()
+{
+  // Local static: available also for keyboards defined as global objects
+  static MallocAllocator allocator;
+  return allocator;
+}
+
+void *MallocAllocator::allocate(size_t size)
+{
+  return malloc(size);
+}
+
+void MallocAllocator::deallocate(void *ptr)
+{
+  free(ptr);
+}
+
+void *MallocAllocator::reallocate(void *ptr, size_t size)
+{
+  return realloc(ptr, size);
+}
+
+
+#if defined(ESP32)
+void *PSRAMAllocator::allocate(size_t size)
+{
+  void *ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return ptr != nullptr ? ptr : malloc(size);
+}
+
+void PSRAMAllocator::deallocate(void *ptr)
+{
+  // heap_caps memory can be released with free()
+  free(ptr);
+}
+
+void *PSRAMAllocator::reallocate(void *ptr, size_t size)
+{
+  void *newPtr = heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return newPtr != nullptr ? newPtr : realloc(ptr, size);
+}
+#endif
+
+
+// Size of each block is stored in front of it (keeping the alignment of malloc)
+static const size_t TRACK_HEADER = alignof(max_align_t) > sizeof(size_t) ? alignof(max_align_t) : sizeof(size_t);
+
+void *TrackingAllocator::allocate(size_t size)
+{
+  uint8_t *block = (uint8_t *)m_allocator.allocate(size + TRACK_HEADER);
+  if (block == nullptr) {
+    m_failures++;
+    return nullptr;
+  }
+  memcpy(block, &size, sizeof(size_t));
+  m_allocations++;
+  m_used += size;
+  if (m_used > m_peak)
+    m_peak = m_used;
+  return block + TRACK_HEADER;
+}
+
+void TrackingAllocator::deallocate(void *ptr)
+{
+  if (ptr == nullptr)
+    return;
+  uint8_t *block = (uint8_t *)ptr - TRACK_HEADER;
+  size_t size;
+  memcpy(&size, block, sizeof(size_t));
+  m_used -= size;
+  m_allocator.deallocate(block);
+}
+
+void *TrackingAllocator::reallocate(void *ptr, size_t size)
+{
+  if (ptr == nullptr)
+    return allocate(size);
+  uint8_t *block = (uint8_t *)ptr - TRACK_HEADER;
+  size_t oldSize;
+  memcpy(&oldSize, block, sizeof(size_t));
+  block = (uint8_t *)m_allocator.reallocate(block, size + TRACK_HEADER);
+  if (block == nullptr) {
+    m_failures++;
+    return nullptr;
+  }
+  memcpy(block, &size, sizeof(size_t));
+  m_allocations++;
+  m_used += size - oldSize;
+  if (m_used > m_peak)
+    m_peak = m_used;
+  return block + TRACK_HEADER;
+}
+
+
+TBTextBuffer::TBTextBuffer(TBAllocator &allocator, size_t capacity) : m_allocator(allocator)
+{
+  reserve(capacity);
+}
+
+TBTextBuffer::~TBTextBuffer()
+{
+  m_allocator.deallocate(m_data);
+}
+
+bool TBTextBuffer::reserve(size_t size)
+{
+  if (size <= m_capacity)
+    return true;
+  char *data = (char *)m_allocator.reallocate(m_data, size);
+  if (data == nullptr)
+    return false;
+  if (m_data == nullptr)
+    data[0] = '\0';
+  m_data = data;
+  m_capacity = size;
+  return true;
+}
+
+bool TBTextBuffer::assign(const char *text)
+{
+  size_t len = strlen(text);
+  if (!reserve(len + 1))
+    return false;
+  memcpy(m_data, text, len + 1);
+  return true;
+}
+
+bool TBTextBuffer::assign(const JsonDocument &doc)
+{
+  size_t len = measureJson(doc);
+  if (!reserve(len + 1))
+    return false;
+  serializeJson(doc, m_data, m_capacity);
+  return true;
+}
+
+size_t TBTextBuffer::jsonCapacity() const
+{
+  // Each value of an array or object follows '[', '{' or ','
+  size_t values = 0, len = 0;
+  for (const char *p = c_str(); *p; p++, len++) {
+    if (*p == '[' || *p == '{' || *p == ',')
+      values++;
+  }
+  return JSON_ARRAY_SIZE(values) + len + 1;
+}
+
+
+// Arena blocks are contiguous: each block starts with its header (total size and used flag)
+struct ArenaBlock
+{
+  uint32_t size;
+  uint32_t used;
+};
+
+static const size_t ARENA_ALIGN = 8;
+static const size_t ARENA_HEADER = sizeof(ArenaBlock);
+
+static inline ArenaBlock *arenaBlock(uint8_t *block)
+{
+  return (ArenaBlock *)block;
+}
+
+// total size of a block with size bytes of data
+static inline size_t arenaBlockSize(size_t size)
+{
+  return (size + ARENA_HEADER + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+ArenaAllocator::ArenaAllocator(void *buffer, size_t size)
+{
+  init(buffer, size);
+}
+
+ArenaAllocator::ArenaAllocator(size_t size, TBAllocator &allocator) : m_owner(&allocator)
+{
+  init(allocator.allocate(size), size);
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+  if (m_owner != nullptr)
+    m_owner->deallocate(m_buffer);
+}
+
+void ArenaAllocator::init(void *buffer, size_t size)
+{
+  m_buffer = buffer;
+  if (buffer == nullptr)
+    return;
+  uintptr_t start = ((uintptr_t)buffer + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+  size_t skip = start - (uintptr_t)buffer;
+  if (size < skip + 2 * ARENA_HEADER)
+    return;
+  m_arena = (uint8_t *)start;
+  m_size = (size - skip) & ~(ARENA_ALIGN - 1);
+  arenaBlock(m_arena)->size = m_size;
+  arenaBlock(m_arena)->used = 0;
+}
+
+void ArenaAllocator::merge(uint8_t *block)
+{
+  uint8_t *next = block + arenaBlock(block)->size;
+  while (next < m_arena + m_size && !arenaBlock(next)->used) {
+    arenaBlock(block)->size += arenaBlock(next)->size;
+    next = block + arenaBlock(block)->size;
+  }
+}
+
+void ArenaAllocator::split(uint8_t *block, size_t size)
+{
+  size_t rest = arenaBlock(block)->size - size;
+  if (rest < ARENA_HEADER + ARENA_ALIGN)
+    return;
+  arenaBlock(block)->size = size;
+  uint8_t *free = block + size;
+  arenaBlock(free)->size = rest;
+  arenaBlock(free)->used = 0;
+  merge(free);
+}
+
+void *ArenaAllocator::allocate(size_t size)
+{
+  const size_t need = arenaBlockSize(size ? size : 1);
+  // First fit: adjacent free blocks are merged while searching
+  for (uint8_t *block = m_arena; block != nullptr && block < m_arena + m_size; block += arenaBlock(block)->size) {
+    if (arenaBlock(block)->used)
+      continue;
+    merge(block);
+    if (arenaBlock(block)->size >= need) {
+      split(block, need);
+      arenaBlock(block)->used = 1;
+      m_blocks++;
+      m_allocations++;
+      return block + ARENA_HEADER;
+    }
+  }
+  m_failures++;
+  return nullptr;
+}
+
+void ArenaAllocator::deallocate(void *ptr)
+{
+  if (ptr == nullptr)
+    return;
+  uint8_t *block = (uint8_t *)ptr - ARENA_HEADER;
+  arenaBlock(block)->used = 0;
+  m_blocks--;
+  merge(block);
+}
+
+void *ArenaAllocator::reallocate(void *ptr, size_t size)
+{
+  if (ptr == nullptr)
+    return allocate(size);
+  const size_t need = arenaBlockSize(size ? size : 1);
+  uint8_t *block = (uint8_t *)ptr - ARENA_HEADER;
+  const size_t oldSize = arenaBlock(block)->size;
+
+  // Resize in place when the following blocks are free
+  merge(block);
+  if (arenaBlock(block)->size >= need) {
+    split(block, need);
+    m_allocations++;
+    return ptr;
+  }
+  split(block, oldSize);
+
+  void *newPtr = allocate(size);
+  if (newPtr == nullptr)
+    return nullptr;
+  memcpy(newPtr, ptr, oldSize - ARENA_HEADER);
+  deallocate(ptr);
+  return newPtr;
+}
+
+size_t ArenaAllocator::getFreeHeap()
+{
+  size_t free = 0;
+  for (uint8_t *block = m_arena; block != nullptr && block < m_arena + m_size; block += arenaBlock(block)->size) {
+    if (!arenaBlock(block)->used) {
+      merge(block);
+      free += arenaBlock(block)->size - ARENA_HEADER;
+    }
+  }
+  return free;
+}
+
+size_t ArenaAllocator::getLargestFreeBlock()
+{
+  size_t largest = 0;
+  for (uint8_t *block = m_arena; block != nullptr && block < m_arena + m_size; block += arenaBlock(block)->size) {
+    if (!arenaBlock(block)->used) {
+      merge(block);
+      if (arenaBlock(block)->size - ARENA_HEADER > largest)
+        largest = arenaBlock(block)->size - ARENA_HEADER;
+    }
+  }
+  return largest;
+}
@@ -0,0 +1,195 @@
+
+#ifndef TB_ALLOCATOR
+#define TB_ALLOCATOR
+
+#define ARDUINOJSON_USE_LONG_LONG   1
+#define ARDUINOJSON_DECODE_UNICODE  1
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Source of dynamic memory for bot buffers, JSON documents and keyboards.
+// Implement this interface in order to place buffers in a specific memory (ex. PSRAM)
+class TBAllocator
+{
+public:
+  virtual ~TBAllocator() {}
+
+  // return:
+  //    the allocated block or nullptr
+  virtual void *allocate(size_t size) = 0;
+
+  virtual void deallocate(void *ptr) = 0;
+
+  // resize a block keeping its content (ptr can be nullptr)
+  // return:
+  //    the new block or nullptr (ptr is still valid in this case)
+  virtual void *reallocate(void *ptr, size_t size) = 0;
+
+  // the allocator used when no other allocator is specified (malloc/free)
+  static TBAllocator &getDefault(void);
+};
+
+
+// Plain malloc/free allocator
+class MallocAllocator : public TBAllocator
+{
+public:
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+};
+
+
+#if defined(ESP32)
+// Allocate in external PSRAM when available, otherwise in internal RAM
+class PSRAMAllocator : public TBAllocator
+{
+public:
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+};
+#endif
+
+
+// Forward requests to another allocator and keep usage statistics.
+// Use one instance for each subsystem (bot, keyboards, OTA...) to measure its peak usage
+class TrackingAllocator : public TBAllocator
+{
+public:
+  TrackingAllocator(TBAllocator &allocator = TBAllocator::getDefault()) : m_allocator(allocator) {}
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+
+  // bytes currently allocated
+  inline size_t getUsed() const { return m_used; }
+
+  // max value of bytes allocated at the same time
+  inline size_t getPeak() const { return m_peak; }
+
+  // number of successful allocations (reallocations included)
+  inline uint32_t getAllocations() const { return m_allocations; }
+
+  // number of failed allocations
+  inline uint32_t getFailures() const { return m_failures; }
+
+  // restart peak measuring from current usage
+  inline void resetPeak() { m_peak = m_used; }
+
+  // raise peak to a value read before resetPeak() (nested measures)
+  inline void mergePeak(size_t peak) { m_peak = peak > m_peak ? peak : m_peak; }
+
+private:
+  TBAllocator &m_allocator;
+  size_t    m_used = 0;
+  size_t    m_peak = 0;
+  uint32_t  m_allocations = 0;
+  uint32_t  m_failures = 0;
+};
+
+
+// First-fit allocator working on a fixed memory area, like the heap of a small MCU.
+// It can be used to check the fragmentation caused by the library over a long run (free memory
+// and largest free block are always known) or to reserve a dedicated memory area to the bot
+class ArenaAllocator : public TBAllocator
+{
+public:
+  // params:
+  //   buffer : memory area managed by allocator (8 bytes aligned)
+  //   size   : size of memory area
+  ArenaAllocator(void *buffer, size_t size);
+
+  // memory area is taken from allocator
+  ArenaAllocator(size_t size, TBAllocator &allocator = TBAllocator::getDefault());
+  ~ArenaAllocator();
+  ArenaAllocator(const ArenaAllocator &) = delete;
+  ArenaAllocator &operator=(const ArenaAllocator &) = delete;
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+
+  // free bytes (block headers excluded)
+  size_t getFreeHeap(void);
+
+  // size of the largest block that can be allocated
+  size_t getLargestFreeBlock(void);
+
+  // number of blocks currently allocated
+  inline uint32_t getBlocks() const { return m_blocks; }
+
+  // number of successful allocations (reallocations included)
+  inline uint32_t getAllocations() const { return m_allocations; }
+
+  // number of failed allocations
+  inline uint32_t getFailures() const { return m_failures; }
+
+  // size of memory area
+  inline size_t getSize() const { return m_size; }
+
+private:
+  TBAllocator *m_owner = nullptr;   // allocator of memory area (if not provided by user)
+  void      *m_buffer = nullptr;
+  uint8_t   *m_arena = nullptr;     // first block (aligned)
+  size_t    m_size = 0;
+  uint32_t  m_blocks = 0;
+  uint32_t  m_allocations = 0;
+  uint32_t  m_failures = 0;
+
+  void init(void *buffer, size_t size);
+  // merge free block with the free blocks that follow
+  void merge(uint8_t *block);
+  // cut block to size (the remaining part becomes a free block)
+  void split(uint8_t *block, size_t size);
+};
+
+
+// Adapter used by ArduinoJson BasicJsonDocument
+struct TBJsonAllocator
+{
+  TBJsonAllocator(TBAllocator &allocator = TBAllocator::getDefault()) : m_allocator(&allocator) {}
+  void *allocate(size_t size) { return m_allocator->allocate(size); }
+  void deallocate(void *ptr) { m_allocator->deallocate(ptr); }
+  void *reallocate(void *ptr, size_t size) { return m_allocator->reallocate(ptr, size); }
+  TBAllocator *m_allocator;
+};
+
+typedef BasicJsonDocument<TBJsonAllocator> TBJsonDocument;
+
+
+// Text buffer obtained from a TBAllocator and grown on demand (ex. serialized JSON of keyboards)
+class TBTextBuffer
+{
+public:
+  TBTextBuffer(TBAllocator &allocator, size_t capacity);
+  ~TBTextBuffer();
+  TBTextBuffer(const TBTextBuffer &) = delete;
+  TBTextBuffer &operator=(const TBTextBuffer &) = delete;
+
+  // grow buffer (content is preserved)
+  // return:
+  //    true if buffer can hold at least size bytes
+  bool reserve(size_t size);
+
+  // replace content with text
+  bool assign(const char *text);
+
+  // replace content with the serialized JSON document
+  bool assign(const JsonDocument &doc);
+  // capacity of a JSON document that can hold the content once parsed (upper bound:
+  // a slot for each value and a copy of each string)
+  size_t jsonCapacity() const;
+
+  inline const char *c_str() const { return m_data != nullptr ? m_data : ""; }
+  inline size_t capacity() const { return m_capacity; }
+
+private:
+  TBAllocator &m_allocator;
+  char     *m_data = nullptr;
+  size_t    m_capacity = 0;
+};
+
+#endif
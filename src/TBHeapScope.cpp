@@ -0,0 +1,129 @@
+#include "TBHeapScope.h"
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+static TBHeapUsage s_table[TB_HEAP_SCOPES];
+static TrackingAllocator *s_allocator = nullptr;
+static ArenaAllocator *s_arena = nullptr;
+static size_t s_capacity = 0;
+
+void TBHeapScope::setAllocator(TrackingAllocator *allocator, size_t capacity, ArenaAllocator *arena)
+{
+  s_allocator = allocator;
+  s_capacity = capacity;
+  s_arena = arena;
+}
+
+uint32_t TBHeapScope::freeHeap()
+{
+  if (s_allocator != nullptr)
+    return s_allocator->getUsed() < s_capacity ? s_capacity - s_allocator->getUsed() : 0;
+#if defined(ESP32)
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#elif defined(ESP8266)
+  return ESP.getFreeHeap();
+#else
+  return 0;
+#endif
+}
+
+uint32_t TBHeapScope::largestFreeBlock()
+{
+  if (s_allocator != nullptr)
+    return s_arena != nullptr ? s_arena->getLargestFreeBlock() : freeHeap();
+#if defined(ESP32)
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#elif defined(ESP8266)
+  return ESP.getMaxFreeBlockSize();
+#else
+  return 0;
+#endif
+}
+
+TBHeapScope::TBHeapScope(const char *function)
+{
+  for (uint8_t i = 0; i < TB_HEAP_SCOPES; i++) {
+    TBHeapUsage &usage = s_table[i];
+    if (usage.function == nullptr)
+      usage.function = function;
+    else if (usage.function != function && strcmp(usage.function, function) != 0)
+      continue;
+    m_usage = &usage;
+    break;
+  }
+
+  m_free = freeHeap();
+  m_largest = largestFreeBlock();
+  m_outerPeak = 0;
+  if (s_allocator != nullptr) {
+    m_outerPeak = s_allocator->getPeak();
+    s_allocator->resetPeak();
+  }
+#if defined(ESP32)
+  m_minEver = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+#endif
+}
+
+TBHeapScope::~TBHeapScope()
+{
+  uint32_t low = freeHeap();
+  if (s_allocator != nullptr) {
+    const size_t peak = s_allocator->getPeak();
+    low = peak < s_capacity ? s_capacity - peak : 0;
+    // Outer scopes must still see the peak reached before this scope
+    s_allocator->mergePeak(m_outerPeak);
+  }
+#if defined(ESP32)
+  else {
+    // A new low-water mark since boot was reached inside this scope
+    const uint32_t minEver = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    if (minEver < m_minEver && minEver < low)
+      low = minEver;
+  }
+#endif
+  if (m_usage == nullptr)
+    return;
+
+  TBHeapUsage &usage = *m_usage;
+  usage.calls++;
+  const uint32_t used = m_free > low ? m_free - low : 0;
+  const int32_t delta = (int32_t)largestFreeBlock() - (int32_t)m_largest;
+  if (usage.calls == 1 || low < usage.freeMin)
+    usage.freeMin = low;
+  if (used > usage.usedMax)
+    usage.usedMax = used;
+  if (usage.calls == 1 || delta < usage.largestDelta)
+    usage.largestDelta = delta;
+}
+
+const TBHeapUsage *TBHeapScope::getTable()
+{
+  return s_table;
+}
+
+const TBHeapUsage *TBHeapScope::find(const char *function)
+{
+  for (uint8_t i = 0; i < TB_HEAP_SCOPES && s_table[i].function != nullptr; i++) {
+    if (strcmp(s_table[i].function, function) == 0)
+      return &s_table[i];
+  }
+  return nullptr;
+}
+
+void TBHeapScope::printTo(Print &out)
+{
+  out.println("function                     calls   free min   used max   largest delta");
+  for (uint8_t i = 0; i < TB_HEAP_SCOPES && s_table[i].function != nullptr; i++) {
+    const TBHeapUsage &usage = s_table[i];
+    char line[96];
+    snprintf(line, sizeof(line), "%-26s %7lu %10lu %10lu %15ld\n", usage.function, (unsigned long)usage.calls,
+             (unsigned long)usage.freeMin, (unsigned long)usage.usedMax, (long)usage.largestDelta);
+    out.print(line);
+  }
+}
+
+void TBHeapScope::reset()
+{
+  memset(s_table, 0, sizeof(s_table));
+}
@@ -0,0 +1,73 @@
+
+#ifndef HEAP_SCOPE
+#define HEAP_SCOPE
+
+#include <Arduino.h>
+#include "TBAllocator.h"
+
+// Set true to record heap usage of library entry points (see TBHeapScope::getTable()).
+// When false, scopes are removed at compile time
+#ifndef TB_HEAP_SCOPE_ENABLE
+#define TB_HEAP_SCOPE_ENABLE  false
+#endif
+
+#ifndef TB_HEAP_SCOPES
+#define TB_HEAP_SCOPES        12      // functions recorded in table
+#endif
+
+#if TB_HEAP_SCOPE_ENABLE
+#define TB_HEAP_SCOPE(name)   TBHeapScope heapScope(name)
+#else
+#define TB_HEAP_SCOPE(name)
+#endif
+
+struct TBHeapUsage {
+  const char *function;     // entry point (nullptr: free slot)
+  uint32_t calls;
+  uint32_t freeMin;         // heap low-water mark: lowest free heap seen during calls
+  uint32_t usedMax;         // max heap taken by a call (free heap at entry - low-water mark)
+  int32_t  largestDelta;    // worst change of largest free block across a call (< 0: heap more fragmented)
+};
+
+// Records the heap usage of a library function in a static table: free heap and largest free block
+// are sampled when scope starts and ends. Scopes can be nested (ex. sendMessage() in a keyboard callback).
+// Low-water mark is exact with a TrackingAllocator (host) or on ESP32, sampled at exit on ESP8266
+class TBHeapScope
+{
+public:
+  TBHeapScope(const char *function);
+  ~TBHeapScope();
+  TBHeapScope(const TBHeapScope &) = delete;
+  TBHeapScope &operator=(const TBHeapScope &) = delete;
+
+  // Measure an allocator in place of MCU heap (host builds and simulations)
+  // params:
+  //   allocator: tracking allocator used by bot and keyboards (nullptr to restore MCU heap)
+  //   capacity : bytes available to allocator
+  //   arena    : arena wrapped by allocator, if any (source of largest free block)
+  static void setAllocator(TrackingAllocator *allocator, size_t capacity, ArenaAllocator *arena = nullptr);
+
+  // table of recorded functions (TB_HEAP_SCOPES entries)
+  static const TBHeapUsage *getTable(void);
+
+  // returns
+  //   usage of function (nullptr if never called)
+  static const TBHeapUsage *find(const char *function);
+
+  static void printTo(Print &out);
+  static void reset(void);
+
+private:
+  TBHeapUsage *m_usage = nullptr;
+  uint32_t  m_free;         // free heap at entry
+  uint32_t  m_largest;      // largest free block at entry
+  size_t    m_outerPeak;    // peak of tracking allocator at entry (restored for outer scopes)
+#if defined(ESP32)
+  uint32_t  m_minEver;      // low-water mark since boot at entry
+#endif
+
+  static uint32_t freeHeap(void);
+  static uint32_t largestFreeBlock(void);
+};
+
+#endif
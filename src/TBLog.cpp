@@ -0,0 +1,236 @@
+#include "TBLog.h"
+
+struct LogFormat {
+  uint32_t    id;
+  const char *format;
+};
+static LogFormat s_formats[TB_LOG_FORMATS];
+static uint8_t s_formatCount = 0;
+
+uint8_t TBLog::s_ring[TB_LOG_SIZE];
+size_t TBLog::s_head = 0;
+size_t TBLog::s_tail = 0;
+size_t TBLog::s_used = 0;
+uint32_t TBLog::s_records = 0;
+uint32_t TBLog::s_dropped = 0;
+TBLog::ClockFunction TBLog::s_clock = nullptr;
+
+static const char LOG_MAGIC[] = "TBLOG1\n";
+
+uint32_t TBLog::addFormat(const char *format)
+{
+  // FNV-1a: the same id is computed by host decoder from source code
+  uint32_t id = 2166136261UL;
+  for (const char *p = format; *p; p++) {
+    id ^= (uint8_t)*p;
+    id *= 16777619UL;
+  }
+  if (s_formatCount < TB_LOG_FORMATS && findFormat(id) == nullptr)
+    s_formats[s_formatCount++] = {id, format};
+  return id;
+}
+
+const char *TBLog::findFormat(uint32_t id)
+{
+  for (uint8_t i = 0; i < s_formatCount; i++) {
+    if (s_formats[i].id == id)
+      return s_formats[i].format;
+  }
+  return nullptr;
+}
+
+void TBLog::Record::add(char type, const void *value, uint8_t size)
+{
+  // Arguments not fitting in record are dropped (printed as '?')
+  if (len + 1 + size > TB_LOG_RECORD_MAX)
+    return;
+  data[len++] = type;
+  memcpy(data + len, value, size);
+  len += size;
+}
+
+void TBLog::Record::add(const char *str)
+{
+  if (len + 2 > TB_LOG_RECORD_MAX)
+    return;
+  if (str == nullptr)
+    str = "(null)";
+  size_t size = strlen(str);
+  if (size > TB_LOG_STRING_MAX)
+    size = TB_LOG_STRING_MAX;
+  if (size > TB_LOG_RECORD_MAX - len - 2u)
+    size = TB_LOG_RECORD_MAX - len - 2u;
+  data[len++] = 's';
+  data[len++] = size;
+  memcpy(data + len, str, size);
+  len += size;
+}
+
+void TBLog::commit(char level, uint32_t id, Record &record)
+{
+  const uint32_t time = now();
+  record.data[0] = record.len;
+  record.data[1] = level;
+  memcpy(record.data + 2, &time, 4);
+  memcpy(record.data + 6, &id, 4);
+
+  // Make room overwriting the oldest records
+  while (TB_LOG_SIZE - s_used < record.len) {
+    const uint8_t size = s_ring[s_tail];
+    s_tail = (s_tail + size) % TB_LOG_SIZE;
+    s_used -= size;
+    s_records--;
+    s_dropped++;
+  }
+  for (uint8_t i = 0; i < record.len; i++)
+    s_ring[(s_head + i) % TB_LOG_SIZE] = record.data[i];
+  s_head = (s_head + record.len) % TB_LOG_SIZE;
+  s_used += record.len;
+  s_records++;
+}
+
+void TBLog::format(Print &out, const uint8_t *record)
+{
+  const uint8_t *arg = record + HEADER_SIZE;
+  const uint8_t *end = record + record[0];
+  uint32_t time, id;
+  memcpy(&time, record + 2, 4);
+  memcpy(&id, record + 6, 4);
+  // Print::printf() is not available on every core
+  char text[64];
+  snprintf(text, sizeof(text), "[%c][%lu] ", (char)record[1], (unsigned long)time);
+  out.print(text);
+
+  const char *fmt = findFormat(id);
+  if (fmt == nullptr) {
+    // Format not registered on device: decode it on host
+    snprintf(text, sizeof(text), "<format %08lx>\n", (unsigned long)id);
+    out.print(text);
+    return;
+  }
+
+  char last = ' ';
+  while (*fmt == '\n')
+    fmt++;
+  for (const char *p = fmt; *p; p++) {
+    if (*p != '%' || p[1] == '%') {
+      p += (*p == '%');
+      out.write(*p);
+      last = *p;
+      continue;
+    }
+    // Flags, width and precision are kept, length modifiers are replaced
+    char spec[16] = "%";
+    size_t n = 1;
+    for (p++; *p && strchr("-+ #0123456789.", *p); p++) {
+      if (n < sizeof(spec) - 4)
+        spec[n++] = *p;
+    }
+    while (*p && strchr("hlLqjzt", *p))
+      p++;
+    if (*p == '\0')
+      break;
+
+    strcpy(text, "?");
+    if (arg < end) {
+      const char type = *arg++;
+      int64_t i = 0;
+      double f = 0;
+      char str[TB_LOG_STRING_MAX + 1] = "";
+      switch (type) {
+        case 'i': { int32_t v; memcpy(&v, arg, 4); i = v; f = v; arg += 4; break; }
+        case 'u': { uint32_t v; memcpy(&v, arg, 4); i = v; f = v; arg += 4; break; }
+        case 'I':
+        case 'U': memcpy(&i, arg, 8); f = (double)i; arg += 8; break;
+        case 'f': memcpy(&f, arg, sizeof(double)); i = (int64_t)f; arg += sizeof(double); break;
+        case 's':
+          memcpy(str, arg + 1, *arg);
+          str[*arg] = '\0';
+          arg += 1 + *arg;
+          break;
+        default: arg = end; break;
+      }
+      if (strchr("diouxXc", *p)) {
+        if (*p != 'c') {
+          spec[n++] = 'l';
+          spec[n++] = 'l';
+        }
+        spec[n++] = *p;
+        if (*p == 'c')
+          snprintf(text, sizeof(text), spec, (int)i);
+        else if (*p == 'd' || *p == 'i')
+          snprintf(text, sizeof(text), spec, (long long)i);
+        else
+          snprintf(text, sizeof(text), spec, (unsigned long long)i);
+      }
+      else if (strchr("fFeEgGaA", *p)) {
+        spec[n++] = *p;
+        snprintf(text, sizeof(text), spec, f);
+      }
+      else if (*p == 's') {
+        spec[n++] = 's';
+        snprintf(text, sizeof(text), spec, str);
+      }
+      else
+        snprintf(text, sizeof(text), "%llx", (unsigned long long)i);
+    }
+    out.print(text);
+    last = text[0] ? text[strlen(text) - 1] : last;
+  }
+  if (last != '\n')
+    out.println();
+}
+
+size_t TBLog::print(Print &out, uint32_t lastMs)
+{
+  const uint32_t time = now();
+  uint8_t record[TB_LOG_RECORD_MAX];
+  size_t count = 0;
+  for (size_t pos = s_tail, left = s_used; left > 0;) {
+    const uint8_t size = s_ring[pos];
+    for (uint8_t i = 0; i < size; i++)
+      record[i] = s_ring[(pos + i) % TB_LOG_SIZE];
+    pos = (pos + size) % TB_LOG_SIZE;
+    left -= size;
+
+    uint32_t recordTime;
+    memcpy(&recordTime, record + 2, 4);
+    if (lastMs && time - recordTime > lastMs)
+      continue;
+    format(out, record);
+    count++;
+  }
+  return count;
+}
+
+void TBLog::dump(Print &out, bool hex)
+{
+  const uint8_t *magic = (const uint8_t *)LOG_MAGIC;
+  const size_t magicLen = sizeof(LOG_MAGIC) - 1;
+  if (!hex) {
+    out.write(magic, magicLen);
+    for (size_t pos = s_tail, left = s_used; left > 0; left--, pos = (pos + 1) % TB_LOG_SIZE)
+      out.write(s_ring[pos]);
+    return;
+  }
+  // Hexadecimal text, 32 bytes for each line (ex. to be copied from serial monitor)
+  static const char digits[] = "0123456789abcdef";
+  size_t col = 0;
+  auto put = [&](uint8_t data) {
+    out.print(digits[data >> 4]);
+    out.print(digits[data & 0x0f]);
+    if (++col % 32 == 0)
+      out.println();
+  };
+  for (size_t i = 0; i < magicLen; i++)
+    put(magic[i]);
+  for (size_t pos = s_tail, left = s_used; left > 0; left--, pos = (pos + 1) % TB_LOG_SIZE)
+    put(s_ring[pos]);
+  out.println();
+}
+
+void TBLog::clear()
+{
+  s_head = s_tail = s_used = 0;
+  s_records = 0;
+}
@@ -0,0 +1,117 @@
+
+#ifndef RING_LOG
+#define RING_LOG
+
+#include <Arduino.h>
+#include <type_traits>
+
+// Set true to send log_debug/log_error/log_info to a RAM ring of binary records instead of Serial.
+// Records are formatted only on request (TBLog::print()) or on host by extras/log_decoder
+#ifndef TB_LOG_ENABLE
+#define TB_LOG_ENABLE       false
+#endif
+
+#ifndef TB_LOG_SIZE
+#define TB_LOG_SIZE         2048    // bytes of ring (about 100 records)
+#endif
+#ifndef TB_LOG_FORMATS
+#define TB_LOG_FORMATS      48      // format strings known on device (formatted by TBLog::print())
+#endif
+#define TB_LOG_RECORD_MAX   96      // max size of a record
+#define TB_LOG_STRING_MAX   32      // string arguments are truncated to this length
+
+// Add a record to ring log (level: 'E', 'I', 'D' or any char). Format must be a string literal:
+// it is registered only once for each call site, the record stores its id (FNV-1a hash)
+#define TB_LOG(level, format, ...) do { \
+    static const uint32_t tbLogId = TBLog::addFormat("" format); \
+    TBLog::write(level, tbLogId, ##__VA_ARGS__); } while (0)
+
+// Ring of binary log records: [size][level][time (ms)][format id][arguments].
+// Writing a record costs a few microseconds (no formatting, no Serial), so logging can stay on
+// in the field and the last records can be dumped after an incident
+class TBLog
+{
+public:
+  using ClockFunction = unsigned long (*)(void);
+
+  // register a format string (done once by TB_LOG for each call site)
+  // returns
+  //   the format id
+  static uint32_t addFormat(const char *format);
+
+  // add a record with raw arguments (integers, floating point, strings)
+  template <typename... Args>
+  static void write(char level, uint32_t id, const Args &...args) {
+    Record record;
+    encode(record, args...);
+    commit(level, id, record);
+  }
+
+  // format records on device, oldest first
+  // params
+  //   lastMs: only records of last lastMs milliseconds (0 all)
+  // returns
+  //   number of records printed
+  static size_t print(Print &out, uint32_t lastMs = 0);
+
+  // raw dump of records for extras/log_decoder (binary or hexadecimal text)
+  static void dump(Print &out, bool hex = false);
+
+  static void clear(void);
+
+  // records in ring and records overwritten since start
+  static inline uint32_t getRecords() { return s_records; }
+  static inline uint32_t getDropped() { return s_dropped; }
+
+  // time source (default millis())
+  static inline void setClock(ClockFunction clock) { s_clock = clock; }
+
+private:
+  struct Record {
+    uint8_t data[TB_LOG_RECORD_MAX];
+    uint8_t len = HEADER_SIZE;
+    void add(char type, const void *value, uint8_t size);
+    void add(const char *str);
+  };
+  static const uint8_t HEADER_SIZE = 10;
+
+  static uint8_t        s_ring[TB_LOG_SIZE];
+  static size_t         s_head;       // next byte to write
+  static size_t         s_tail;       // first byte of oldest record
+  static size_t         s_used;
+  static uint32_t       s_records;
+  static uint32_t       s_dropped;
+  static ClockFunction  s_clock;
+
+  static inline void encode(Record &) {}
+  template <typename T, typename... Args>
+  static inline void encode(Record &record, const T &value, const Args &...args) {
+    put(record, value);
+    encode(record, args...);
+  }
+
+  // integers are stored as 4 or 8 bytes, signed (i, I) or unsigned (u, U)
+  template <typename T>
+  static inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+  put(Record &record, const T &value) {
+    const bool sign = std::is_signed<T>::value;
+    if (sizeof(T) > 4) {
+      const int64_t v = (int64_t)value;
+      record.add(sign ? 'I' : 'U', &v, 8);
+    }
+    else {
+      const int32_t v = (int32_t)value;
+      record.add(sign ? 'i' : 'u', &v, 4);
+    }
+  }
+  static inline void put(Record &record, double value) { record.add('f', &value, sizeof(double)); }
+  static inline void put(Record &record, const char *value) { record.add(value); }
+  static inline void put(Record &record, const String &value) { record.add(value.c_str()); }
+
+  static void commit(char level, uint32_t id, Record &record);
+  static const char *findFormat(uint32_t id);
+  static void format(Print &out, const uint8_t *record);
+  static inline uint32_t now() { return s_clock != nullptr ? s_clock() : millis(); }
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "TBTrace.h"
+
+void TBTrace::record(int8_t method, TBTracePhase phase, uint32_t us)
+{
+  if (method >= TB_TRACE_METHODS)
+    return;
+  // Bucket b holds [2^(b+3), 2^(b+4)) us
+  uint8_t bucket = 0;
+  if (us >= 16) {
+    bucket = 31 - __builtin_clz(us) - 3;
+    if (bucket >= TB_TRACE_BUCKETS)
+      bucket = TB_TRACE_BUCKETS - 1;
+  }
+  uint16_t &count = m_hist[row(method)][phase][bucket];
+  if (count < UINT16_MAX)
+    count++;
+}
+
+uint32_t TBTrace::getSamples(int8_t method, TBTracePhase phase) const
+{
+  uint32_t samples = 0;
+  for (uint8_t b = 0; b < TB_TRACE_BUCKETS; b++)
+    samples += getCount(method, phase, b);
+  return samples;
+}
+
+uint32_t TBTrace::bucketLimit(uint8_t bucket)
+{
+  return bucket < TB_TRACE_BUCKETS - 1 ? 16UL << bucket : UINT32_MAX;
+}
+
+uint32_t TBTrace::getPercentile(int8_t method, TBTracePhase phase, uint8_t percentile) const
+{
+  const uint32_t samples = getSamples(method, phase);
+  if (!samples)
+    return 0;
+  uint32_t rank = (samples * percentile + 99) / 100;
+  if (rank == 0)
+    rank = 1;
+  uint32_t count = 0;
+  for (uint8_t b = 0; b < TB_TRACE_BUCKETS; b++) {
+    count += getCount(method, phase, b);
+    if (count >= rank)
+      return bucketLimit(b);
+  }
+  return bucketLimit(TB_TRACE_BUCKETS - 1);
+}
+
+const char *TBTrace::phaseName(TBTracePhase phase)
+{
+  static const char *const names[TracePhases] = {"connect", "header write", "body write", "first byte",
+                                                 "body read", "parse", "callback"};
+  return phase < TracePhases ? names[phase] : "";
+}
+
+void TBTrace::printTo(Print &out, const TBStats &stats) const
+{
+  out.println("method              phase            samples   p50 (us)   p90 (us)   p99 (us)");
+  for (int8_t m = -1; m < TB_TRACE_METHODS && m < TB_STATS_METHODS; m++) {
+    const char *method = m < 0 ? "(reconnect)" : stats.methods[m].method;
+    if (method == nullptr)
+      continue;
+    for (uint8_t p = 0; p < TracePhases; p++) {
+      const TBTracePhase phase = (TBTracePhase)p;
+      const uint32_t samples = getSamples(m, phase);
+      if (!samples)
+        continue;
+      char line[96];
+      snprintf(line, sizeof(line), "%-19s %-14s %9lu %10lu %10lu %10lu\n", method, phaseName(phase),
+               (unsigned long)samples, (unsigned long)getPercentile(m, phase, 50),
+               (unsigned long)getPercentile(m, phase, 90), (unsigned long)getPercentile(m, phase, 99));
+      out.print(line);
+    }
+  }
+}
+
+void TBTrace::reset()
+{
+  memset(m_hist, 0, sizeof(m_hist));
+}
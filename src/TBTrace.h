@@ -0,0 +1,77 @@
+
+#ifndef TB_TRACER
+#define TB_TRACER
+
+#include <Arduino.h>
+#include "DataStructures.h"
+
+// Set true to collect latency histograms of request phases (see AsyncTelegramBot::getTrace()).
+// When false, trace hooks are removed at compile time
+#ifndef TB_TRACE_ENABLE
+#define TB_TRACE_ENABLE     false
+#endif
+
+#ifndef TB_TRACE_METHODS
+#define TB_TRACE_METHODS    6       // Bot API methods traced (the first slots of TBStats::methods)
+#endif
+#define TB_TRACE_BUCKETS    20      // log2 buckets: < 16us, 16-32us, 32-64us ... >= 4.2s
+
+// Trace hooks used by the library (no code at all when trace is disabled)
+#if TB_TRACE_ENABLE
+#define TB_TRACE_METHOD(method)   traceMethod(method)
+#define TB_TRACE_START(t)         uint32_t t = traceNow()
+#define TB_TRACE(phase, t)        trace(phase, t)
+#else
+#define TB_TRACE_METHOD(method)
+#define TB_TRACE_START(t)
+#define TB_TRACE(phase, t)
+#endif
+
+enum TBTracePhase {
+  TraceConnect,         // connection and TLS handshake
+  TraceHeaderWrite,     // request header (and payload, when sent in one go)
+  TraceBodyWrite,       // request payload or uploaded file
+  TraceFirstByte,       // from request sent to first byte of reply
+  TraceBodyRead,        // from first byte to end of reply
+  TraceParse,           // JSON parsing of update
+  TraceCallback,        // user callbacks of inline keyboards
+  TracePhases
+};
+
+// Fixed-size log-scale histograms of the duration of each phase, for each Bot API method.
+// Method is the slot in TBStats::methods, -1 for connections started out of a request (begin, reset)
+class TBTrace
+{
+public:
+  // add a sample (methods beyond TB_TRACE_METHODS are ignored)
+  void record(int8_t method, TBTracePhase phase, uint32_t us);
+
+  // number of samples in bucket
+  inline uint16_t getCount(int8_t method, TBTracePhase phase, uint8_t bucket) const {
+    return m_hist[row(method)][phase][bucket];
+  }
+
+  // number of samples of a phase
+  uint32_t getSamples(int8_t method, TBTracePhase phase) const;
+
+  // upper limit (us) of the bucket containing the percentile (0-100) of samples
+  uint32_t getPercentile(int8_t method, TBTracePhase phase, uint8_t percentile) const;
+
+  // upper limit of bucket in microseconds (UINT32_MAX for last bucket)
+  static uint32_t bucketLimit(uint8_t bucket);
+
+  static const char *phaseName(TBTracePhase phase);
+
+  // print p50/p90/p99 of each phase with samples
+  void printTo(Print &out, const TBStats &stats) const;
+
+  void reset(void);
+
+private:
+  // last row is for connections out of a request
+  uint16_t m_hist[TB_TRACE_METHODS + 1][TracePhases][TB_TRACE_BUCKETS] = {};
+
+  static inline uint8_t row(int8_t method) { return method < 0 ? TB_TRACE_METHODS : method; }
+};
+
+#endif
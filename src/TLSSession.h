@@ -0,0 +1,62 @@
+
+#ifndef TLS_SESSION
+#define TLS_SESSION
+
+#include <Arduino.h>
+
+// Optional capability of a TLS client: keep the session negotiated with the server, so the next
+// connection can resume it (abbreviated handshake: no certificate chain, no key exchange).
+// The bot works with any Client: pass an implementation with AsyncTelegramBot::setTLSSession()
+// only if the client can resume sessions
+class TLSSession
+{
+public:
+  virtual ~TLSSession() {}
+
+  // called before each connection attempt
+  virtual void beforeConnect(void) {}
+
+  // returns
+  //    true if last connection resumed the saved session
+  virtual bool resumed(void) = 0;
+
+  // discard the saved session (next connection does a full handshake)
+  virtual void clear(void) = 0;
+};
+
+
+#if defined(ESP8266)
+#include <WiFiClientSecureBearSSL.h>
+
+// Session cache of a BearSSL client (ESP8266): BearSSL stores the session after each handshake
+// and offers it to the server at next connect(). Session parameters are not changed when
+// the server accepts to resume it, so comparing them tells if last handshake was abbreviated
+class BearSSLSession : public TLSSession
+{
+public:
+  BearSSLSession(BearSSL::WiFiClientSecure &client) { client.setSession(&m_session); }
+
+  void beforeConnect(void) override {
+    m_offered = m_saved;
+    m_previous = m_session;
+  }
+
+  bool resumed(void) override {
+    m_saved = true;
+    return m_offered && memcmp(&m_previous, &m_session, sizeof(m_session)) == 0;
+  }
+
+  void clear(void) override {
+    m_session = BearSSL::Session();
+    m_saved = false;
+  }
+
+private:
+  BearSSL::Session  m_session;
+  BearSSL::Session  m_previous;
+  bool              m_saved = false;    // a session was negotiated
+  bool              m_offered = false;
+};
+#endif
+
+#endif
@@ -0,0 +1,156 @@
+#include "TelegramOTA.h"
+
+TelegramOTA::TelegramOTA(AsyncTelegramBotBase &bot, UpdateSink &sink) :
+  m_bot(bot), m_sink(sink), m_allocator(bot.getAllocator()) {}
+
+TelegramOTA::TelegramOTA(AsyncTelegramBotBase &bot, UpdateSink &sink, TBAllocator &allocator) :
+  m_bot(bot), m_sink(sink), m_allocator(allocator) {}
+
+size_t TelegramOTA::BufferedSink::write(const uint8_t *data, size_t len)
+{
+  m_ota.m_sha.update(data, len);
+  size_t done = 0;
+  while (done < len) {
+    // Buffer is full and more data arrive: it isn't the last chunk, write it
+    if (m_ota.m_bufferLen == OTA_BUFFER_SIZE && !m_ota.flushBuffer())
+      return done;
+    size_t n = OTA_BUFFER_SIZE - m_ota.m_bufferLen;
+    if (n > len - done)
+      n = len - done;
+    memcpy(m_ota.m_buffer + m_ota.m_bufferLen, data + done, n);
+    m_ota.m_bufferLen += n;
+    done += n;
+  }
+  return done;
+}
+
+bool TelegramOTA::flushBuffer()
+{
+  if (m_sink.write(m_buffer, m_bufferLen) != m_bufferLen) {
+    log_error("Update sink write error");
+    m_writeError = true;
+    return false;
+  }
+  m_bufferLen = 0;
+  return true;
+}
+
+void TelegramOTA::sendProgress(const char *text)
+{
+  char payload[BUFFER_SMALL];
+  // First call: send a new message and store its ID for next edits
+  if (m_messageId == 0) {
+    snprintf(payload, BUFFER_SMALL, "{\"chat_id\":%lld,\"text\":\"%s\"}", (long long)m_chatId, text);
+    if (m_bot.sendCommand("sendMessage", payload, true)) {
+      StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_OBJECT_SIZE(1)> filter;
+      filter["result"]["message_id"] = true;
+      deserializeJson(m_bot.m_txDoc, (const char *)m_bot.m_rxbuffer, m_bot.m_rxLen,
+                      DeserializationOption::Filter(filter));
+      m_messageId = m_bot.m_txDoc["result"]["message_id"];
+    }
+    return;
+  }
+  snprintf(payload, BUFFER_SMALL, "{\"chat_id\":%lld,\"message_id\":%ld,\"text\":\"%s\"}",
+           (long long)m_chatId, (long)m_messageId, text);
+  // Wait reply, so connection is free for next download segment
+  m_bot.sendCommand("editMessageText", payload, true);
+}
+
+OTAResult TelegramOTA::update(TBMessage &msg)
+{
+  if (msg.messageType != MessageDocument)
+    return OTA_NO_FIRMWARE;
+  // Name of the document sent by user (file_path is the name on server, ex. documents/file_12.bin)
+  const char *name = msg.document.file_name;
+  const size_t nameLen = name != nullptr ? strlen(name) : 0;
+  if (nameLen < 4 || strcasecmp(name + nameLen - 4, ".bin") != 0)
+    return OTA_NO_FIRMWARE;
+
+  m_chatId = msg.chatId;
+  m_messageId = 0;
+
+  // A polling request is still waiting for reply: connection is needed for blocking requests.
+  // On sending connection (dual mode) the reply to last request is read instead
+  m_bot.readSendReply(true);
+  if (m_bot.m_waitingReply)
+    m_bot.reset();
+
+  uint8_t expected[32];
+  bool hasHash = TBSha256::parseHex(msg.text.c_str(), expected);
+  if (!hasHash && m_requireHash) {
+    sendProgress("Firmware update refused: SHA-256 missing in caption");
+    return OTA_NO_HASH;
+  }
+
+  if (!m_bot.getFile(msg.document)) {
+    sendProgress("Firmware update failed: file is unavailable");
+    return OTA_DOWNLOAD_ERROR;
+  }
+
+  const size_t size = msg.document.file_size;
+  m_buffer = (uint8_t *)m_allocator.allocate(OTA_BUFFER_SIZE);
+  if (m_buffer == nullptr || !m_sink.begin(size)) {
+    m_allocator.deallocate(m_buffer);
+    m_buffer = nullptr;
+    sendProgress("Firmware update failed: unable to start update");
+    return OTA_WRITE_ERROR;
+  }
+  m_sha.reset();
+  m_bufferLen = 0;
+  m_writeError = false;
+
+  char text[64];
+  snprintf(text, sizeof(text), "Firmware update: 0%% of %u bytes", (unsigned)size);
+  sendProgress(text);
+
+  OTAResult result = OTA_OK;
+  BufferedSink stream(*this);
+  for (size_t offset = 0; offset < size; offset += OTA_SEGMENT_SIZE) {
+    size_t len = size - offset < OTA_SEGMENT_SIZE ? size - offset : OTA_SEGMENT_SIZE;
+    bool done = m_bot.downloadFile(msg.document, stream, nullptr, offset, len);
+    if (m_writeError) {
+      result = OTA_WRITE_ERROR;
+      break;
+    }
+    if (!done) {
+      result = OTA_DOWNLOAD_ERROR;
+      break;
+    }
+    snprintf(text, sizeof(text), "Firmware update: %u%% of %u bytes",
+             (unsigned)((uint64_t)(offset + len) * 100 / size), (unsigned)size);
+    sendProgress(text);
+  }
+
+  // Verify the whole image before last chunk is written, so a wrong image is never committed
+  if (result == OTA_OK && hasHash) {
+    uint8_t digest[32];
+    m_sha.finalize(digest);
+    if (memcmp(digest, expected, sizeof(digest)) != 0)
+      result = OTA_HASH_MISMATCH;
+  }
+
+  if (result == OTA_OK) {
+    if (!flushBuffer() || !m_sink.end())
+      result = OTA_WRITE_ERROR;
+  }
+  else
+    m_sink.abort();
+  m_allocator.deallocate(m_buffer);
+  m_buffer = nullptr;
+
+  switch (result) {
+    case OTA_OK:
+      sendProgress("Firmware update completed, verified SHA-256");
+      break;
+    case OTA_HASH_MISMATCH:
+      sendProgress("Firmware update failed: SHA-256 mismatch");
+      break;
+    case OTA_WRITE_ERROR:
+      sendProgress("Firmware update failed: write error");
+      break;
+    default:
+      sendProgress("Firmware update failed: download error");
+      break;
+  }
+  return result;
+}
@@ -0,0 +1,78 @@
+
+#ifndef TELEGRAM_OTA
+#define TELEGRAM_OTA
+
+#include "AsyncTelegramBot.h"
+#include "UpdateSink.h"
+#include "sha256.h"
+
+#define OTA_BUFFER_SIZE     4096    // Size of the write buffer (one flash sector)
+#define OTA_SEGMENT_SIZE    65536   // Firmware is downloaded in segments: progress is reported after each one
+
+enum OTAResult {
+  OTA_OK              = 0,
+  OTA_NO_FIRMWARE     = 1,    // message is not a .bin document
+  OTA_NO_HASH         = 2,    // SHA-256 is missing in caption
+  OTA_DOWNLOAD_ERROR  = 3,
+  OTA_WRITE_ERROR     = 4,
+  OTA_HASH_MISMATCH   = 5
+};
+
+// Flash a firmware image received as Telegram document directly into an UpdateSink.
+// The image is streamed over the bot connection (no other TLS session is needed) and verified
+// with the SHA-256 written in the message caption before the last chunk is committed.
+// Progress is reported editing a message in the sender chat.
+class TelegramOTA
+{
+public:
+  TelegramOTA(AsyncTelegramBotBase &bot, UpdateSink &sink);
+
+  // write buffers are obtained from allocator (default: the bot allocator)
+  TelegramOTA(AsyncTelegramBotBase &bot, UpdateSink &sink, TBAllocator &allocator);
+
+  // accept also documents without a SHA-256 in caption (not recommended)
+  inline void setRequireHash(bool require) { m_requireHash = require; }
+
+  // flash the firmware image contained in a document message. The sketch should restart the
+  // board when OTA_OK is returned.
+  // params:
+  //   msg: the received MessageDocument message (caption must contain the SHA-256 of file)
+  // return:
+  //   OTA_OK if image was written and verified
+  OTAResult update(TBMessage &msg);
+
+private:
+  // Stream used as destination of downloadFile(): data are hashed and collected in a buffer.
+  // A full buffer is written to sink only when more data arrive, so the last chunk is still
+  // pending when image is verified and a corrupted image is never completed
+  class BufferedSink : public Stream
+  {
+  public:
+    BufferedSink(TelegramOTA &ota) : m_ota(ota) {}
+    size_t write(uint8_t data) override { return write(&data, 1); }
+    size_t write(const uint8_t *data, size_t len) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+  private:
+    TelegramOTA &m_ota;
+  };
+
+  AsyncTelegramBotBase &m_bot;
+  UpdateSink       &m_sink;
+  TBAllocator      &m_allocator;
+  TBSha256          m_sha;
+  bool              m_requireHash = true;
+  bool              m_writeError = false;
+
+  uint8_t  *m_buffer = nullptr;
+  size_t    m_bufferLen = 0;        // bytes in buffer, not yet written to sink
+
+  int64_t   m_chatId = 0;
+  int32_t   m_messageId = 0;
+
+  bool flushBuffer(void);
+  void sendProgress(const char *text);
+};
+
+#endif
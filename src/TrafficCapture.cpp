@@ -0,0 +1,141 @@
+#include "TrafficCapture.h"
+
+void RecordingClient::setCapture(Print *capture)
+{
+  flushCapture();
+  m_capture = capture;
+  m_headerWritten = false;
+}
+
+void RecordingClient::writeCapture(const uint8_t *data, size_t len)
+{
+  if (!m_headerWritten) {
+    m_headerWritten = true;
+    writeCapture((const uint8_t *)CAPTURE_HEADER, strlen(CAPTURE_HEADER));
+  }
+  m_captureSize += m_capture->write(data, len);
+}
+
+void RecordingClient::flushCapture()
+{
+  if (m_capture == nullptr || m_type == 0)
+    return;
+  const uint8_t head[7] = {m_type,
+                           (uint8_t)m_time, (uint8_t)(m_time >> 8), (uint8_t)(m_time >> 16), (uint8_t)(m_time >> 24),
+                           (uint8_t)m_len, (uint8_t)(m_len >> 8)};
+  writeCapture(head, sizeof(head));
+  if (m_len)
+    writeCapture(m_data, m_len);
+  m_type = 0;
+  m_len = 0;
+}
+
+void RecordingClient::record(uint8_t type, const uint8_t *data, size_t len)
+{
+  if (m_capture == nullptr)
+    return;
+  // Only data of the same direction is packed in one record
+  const bool packed = type == CaptureWrite || type == CaptureRead;
+  if (m_type != type || !packed)
+    flushCapture();
+  do {
+    if (m_len == CAPTURE_RECORD_SIZE)
+      flushCapture();
+    if (m_type == 0) {
+      m_type = type;
+      m_time = m_clock != nullptr ? m_clock() : millis();
+    }
+    size_t n = CAPTURE_RECORD_SIZE - m_len;
+    if (n > len)
+      n = len;
+    memcpy(m_data + m_len, data, n);
+    m_len += n;
+    data += n;
+    len -= n;
+  } while (len);
+  if (!packed)
+    flushCapture();
+}
+
+int RecordingClient::connect(IPAddress ip, uint16_t port)
+{
+  return recordConnect(m_client.connect(ip, port), ip);
+}
+
+int RecordingClient::connect(const char *host, uint16_t port)
+{
+  return recordConnect(m_client.connect(host, port), host);
+}
+
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+int RecordingClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return recordConnect(m_client.connect(ip, port, timeout), ip);
+}
+
+int RecordingClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  return recordConnect(m_client.connect(host, port, timeout), host);
+}
+#endif
+
+int RecordingClient::recordConnect(int result, IPAddress ip)
+{
+  char host[16];
+  snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return recordConnect(result, host);
+}
+
+int RecordingClient::recordConnect(int result, const char *host)
+{
+  char data[64];
+  data[0] = result > 0;
+  snprintf(data + 1, sizeof(data) - 1, "%s", host);
+  record(CaptureConnect, (const uint8_t *)data, strlen(data + 1) + 1);
+  m_wasConnected = result > 0;
+  return result;
+}
+
+size_t RecordingClient::write(const uint8_t *buf, size_t size)
+{
+  const size_t n = m_client.write(buf, size);
+  if (n)
+    record(CaptureWrite, buf, n);
+  return n;
+}
+
+int RecordingClient::read()
+{
+  const int c = m_client.read();
+  if (c >= 0) {
+    const uint8_t data = c;
+    record(CaptureRead, &data, 1);
+  }
+  return c;
+}
+
+int RecordingClient::read(uint8_t *buf, size_t size)
+{
+  const int n = m_client.read(buf, size);
+  if (n > 0)
+    record(CaptureRead, buf, n);
+  return n;
+}
+
+void RecordingClient::stop()
+{
+  m_client.stop();
+  if (m_wasConnected)
+    record(CaptureStop, nullptr, 0);
+  m_wasConnected = false;
+}
+
+uint8_t RecordingClient::connected()
+{
+  const uint8_t result = m_client.connected();
+  if (m_wasConnected && !result)
+    record(CaptureDisconnect, nullptr, 0);
+  m_wasConnected = result;
+  return result;
+}
+
@@ -0,0 +1,86 @@
+
+#ifndef TRAFFIC_CAPTURE
+#define TRAFFIC_CAPTURE
+
+#include <Arduino.h>
+#include "Client.h"
+
+// Capture file format (all numbers little endian):
+//   header  "TBCAP1\n"
+//   records type (1 byte), time in ms (4 bytes), length (2 bytes), data (length bytes)
+// Consecutive bytes in the same direction are packed in one record (max CAPTURE_RECORD_SIZE bytes)
+#define CAPTURE_HEADER        "TBCAP1\n"
+#define CAPTURE_RECORD_SIZE   256
+
+enum CaptureRecordType {
+  CaptureConnect    = 'C',    // data: result (1 byte) and host
+  CaptureWrite      = 'W',    // data: bytes sent by the bot
+  CaptureRead       = 'R',    // data: bytes received by the bot
+  CaptureStop       = 'S',    // connection closed by the bot
+  CaptureDisconnect = 'D'     // connection closed by the server
+};
+
+// Client decorator that records all the traffic of the wrapped client to a capture
+// (ex. a file on LittleFS/SD or the Serial port, to be saved on host disk and replayed
+// there with ReplayClient, see extras/host).
+// Note: requests contain the bot token
+class RecordingClient : public Client
+{
+public:
+  using ClockFunction = unsigned long (*)(void);
+
+  // params:
+  //   client  : client really connected to the server
+  //   capture : destination of records (nullptr, recording is paused)
+  RecordingClient(Client &client, Print *capture = nullptr) : m_client(client), m_capture(capture) {}
+
+  // change destination of records (pending data is written to the previous one)
+  void setCapture(Print *capture);
+
+  // write the pending record (call it before closing the capture file)
+  void flushCapture(void);
+
+  // time source of records (default millis)
+  inline void setClock(ClockFunction clock) { m_clock = clock; }
+
+  // bytes written to capture
+  inline uint32_t getCaptureSize() const { return m_captureSize; }
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+#if defined(ESP32) && defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char *host, uint16_t port, int32_t timeout) override;
+#endif
+  size_t write(uint8_t data) override { return write(&data, 1); }
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override { return m_client.available(); }
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override { return m_client.peek(); }
+  void flush() override { m_client.flush(); }
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return m_client; }
+
+private:
+  Client        &m_client;
+  Print         *m_capture;
+  ClockFunction m_clock = nullptr;
+  bool          m_headerWritten = false;
+  bool          m_wasConnected = false;
+  uint32_t      m_captureSize = 0;
+
+  // pending record
+  uint8_t       m_type = 0;
+  uint32_t      m_time = 0;
+  uint16_t      m_len = 0;
+  uint8_t       m_data[CAPTURE_RECORD_SIZE];
+
+  void record(uint8_t type, const uint8_t *data, size_t len);
+  int recordConnect(int result, IPAddress ip);
+  int recordConnect(int result, const char *host);
+  void writeCapture(const uint8_t *data, size_t len);
+};
+
+#endif
@@ -0,0 +1,98 @@
+
+#ifndef UPDATE_SINK
+#define UPDATE_SINK
+
+#include <Arduino.h>
+
+// Destination of a firmware image received with TelegramOTA.
+// Implement this interface in order to flash an external memory, a co-processor and so on
+class UpdateSink
+{
+public:
+  virtual ~UpdateSink() {}
+
+  // prepare destination for an image of size bytes
+  // return:
+  //    true if no error occurred
+  virtual bool begin(size_t size) = 0;
+
+  // write a chunk of image
+  // return:
+  //    the number of bytes written
+  virtual size_t write(const uint8_t *data, size_t len) = 0;
+
+  // complete the image (all bytes were written and verified)
+  // return:
+  //    true if no error occurred
+  virtual bool end(void) = 0;
+
+  // discard the partially written image
+  virtual void abort(void) {}
+};
+
+
+// Write the image to any Stream (ex. a file on filesystem, also on host for testing)
+class StreamUpdateSink : public UpdateSink
+{
+public:
+  StreamUpdateSink(Stream &stream) : m_stream(stream) {}
+
+  bool begin(size_t size) override {
+    m_size = size;
+    m_written = 0;
+    return true;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    size_t n = m_stream.write(data, len);
+    m_written += n;
+    return n;
+  }
+
+  bool end(void) override {
+    m_stream.flush();
+    return m_written == m_size;
+  }
+
+private:
+  Stream &m_stream;
+  size_t  m_size = 0;
+  size_t  m_written = 0;
+};
+
+
+#if defined(ESP8266) || defined(ESP32)
+#if defined(ESP8266)
+  #include <Updater.h>
+#else
+  #include <Update.h>
+#endif
+
+// Write the image to the OTA flash partition
+class FlashUpdateSink : public UpdateSink
+{
+public:
+  bool begin(size_t size) override {
+    return Update.begin(size);
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    return Update.write((uint8_t *)data, len);
+  }
+
+  bool end(void) override {
+    return Update.end();
+  }
+
+  // Image is not complete: end() will fail and new firmware will not be booted
+  void abort(void) override {
+  #if defined(ESP32)
+    Update.abort();
+  #else
+    Update.end();
+  #endif
+  }
+};
+#endif
+
+#endif
@@ -1,20 +1,31 @@
 #ifndef __LOG_H__
 #define __LOG_H__
 
+#include "TBLog.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// Name of source file without path: builtin macro of clang and GCC 12+, defined here otherwise
+#ifndef __FILE_NAME__
 // Windows
 #define __FILE_NAME__ (strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__)
 
 // Linux, Mac
 // #define __FILE_NAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
+#endif
 
 #define _LOG_FORMAT(letter, format)  "\n[" #letter "][%s:%u] %s():\t" format, __FILE_NAME__, __LINE__, __FUNCTION__
 
-#if DEBUG_ENABLE
+#if TB_LOG_ENABLE
+// Binary records in a RAM ring (see TBLog.h): nothing is formatted or printed at runtime
+#define log_debug(format, ...) TB_LOG('D', format, ##__VA_ARGS__)
+#define log_error(format, ...) TB_LOG('E', format, ##__VA_ARGS__)
+#define log_info(format, ...) TB_LOG('I', format, ##__VA_ARGS__)
+#define lineTrap() TB_LOG('T', "%s:%u", __FILE_NAME__, __LINE__)
+#elif DEBUG_ENABLE
 #define log_debug(format, ...) Serial.printf(_LOG_FORMAT(D, format), ##__VA_ARGS__)
 #define log_error(format, ...) { Serial.println(); Serial.printf(_LOG_FORMAT(E, format), ##__VA_ARGS__); }
 #define log_info(format, ...) Serial.printf(_LOG_FORMAT(I, format), ##__VA_ARGS__)
@@ -26,20 +37,7 @@ extern "C"
 #define lineTRap()
 #endif
 
-#define DEBUG_F true
-#if DEBUG_F
-	#ifdef ESP32
-		#define functionLog() { \
-		Serial.printf("Heap memory %6d / %6d", heap_caps_get_free_size(0), heap_caps_get_largest_free_block(0));\
-		Serial.print("\t\t\t--- "); Serial.print(millis()); Serial.print("mS > ");  Serial.print(__func__); Serial.println("()"); }
-	#elif defined(ESP8266)
-		#define functionLog() { \
-		uint32_t free; uint16_t max; uint8_t frag; ESP.getHeapStats(&free, &max, &frag); Serial.printf("free: %5d - max: %5d <- ", free, max);\
-		Serial.printf("[%s:%u]\t--- ", __FILE__, __LINE__); Serial.print(millis()); Serial.print("mS > ");  Serial.print(__func__); Serial.println("()"); }
-	#endif
-#else
-    #define functionLog()
-#endif
+// Heap usage of library functions is recorded with TB_HEAP_SCOPE() (see TBHeapScope.h)
 
 
 #ifdef __cplusplus
@@ -0,0 +1,118 @@
+#include "sha256.h"
+#include <string.h>
+#include <ctype.h>
+
+static const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+TBSha256::TBSha256()
+{
+  reset();
+}
+
+void TBSha256::reset()
+{
+  static const uint32_t init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  memcpy(m_state, init, sizeof(m_state));
+  m_length = 0;
+  m_blockLen = 0;
+}
+
+void TBSha256::transform(const uint8_t *block)
+{
+  uint32_t w[64];
+  for (uint8_t i = 0; i < 16; i++)
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+           (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+  for (uint8_t i = 16; i < 64; i++) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+  uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+  for (uint8_t i = 0; i < 64; i++) {
+    uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+    uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+  m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+}
+
+void TBSha256::update(const uint8_t *data, size_t len)
+{
+  m_length += len;
+  while (len) {
+    size_t n = 64 - m_blockLen;
+    if (n > len)
+      n = len;
+    memcpy(m_block + m_blockLen, data, n);
+    m_blockLen += n;
+    data += n;
+    len -= n;
+    if (m_blockLen == 64) {
+      transform(m_block);
+      m_blockLen = 0;
+    }
+  }
+}
+
+void TBSha256::finalize(uint8_t digest[32])
+{
+  uint64_t bits = m_length * 8;
+  uint8_t pad = 0x80;
+  update(&pad, 1);
+  pad = 0;
+  while (m_blockLen != 56)
+    update(&pad, 1);
+  uint8_t len[8];
+  for (uint8_t i = 0; i < 8; i++)
+    len[i] = bits >> (56 - i * 8);
+  update(len, 8);
+
+  for (uint8_t i = 0; i < 8; i++) {
+    digest[i * 4]     = m_state[i] >> 24;
+    digest[i * 4 + 1] = m_state[i] >> 16;
+    digest[i * 4 + 2] = m_state[i] >> 8;
+    digest[i * 4 + 3] = m_state[i];
+  }
+  reset();
+}
+
+static uint8_t hexValue(char c)
+{
+  return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+
+bool TBSha256::parseHex(const char *text, uint8_t digest[32])
+{
+  if (text == nullptr)
+    return false;
+  size_t run = 0;
+  for (const char *p = text; *p; p++) {
+    run = isxdigit(*p) ? run + 1 : 0;
+    // 64 hex chars not followed by other hex chars
+    if (run == 64 && !isxdigit(*(p + 1))) {
+      const char *hex = p - 63;
+      for (uint8_t i = 0; i < 32; i++)
+        digest[i] = hexValue(hex[i * 2]) << 4 | hexValue(hex[i * 2 + 1]);
+      return true;
+    }
+  }
+  return false;
+}
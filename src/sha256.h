@@ -0,0 +1,43 @@
+
+#ifndef TB_SHA256
+#define TB_SHA256
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal SHA-256 implementation (FIPS 180-4), used to verify downloaded files.
+// Data can be hashed incrementally, so there is no need to keep the whole file in RAM
+class TBSha256
+{
+public:
+  TBSha256();
+
+  // restart a new hash computation
+  void reset(void);
+
+  // add data to hash computation
+  void update(const uint8_t *data, size_t len);
+
+  // complete hash computation
+  // params:
+  //   digest: buffer for the 32 bytes result
+  void finalize(uint8_t digest[32]);
+
+  // parse the first 64 hexadecimal chars sequence found in text (ex. the caption of a message)
+  // params:
+  //   text  : text to be scanned
+  //   digest: buffer for the 32 bytes result
+  // return:
+  //    true if an hash was found
+  static bool parseHex(const char *text, uint8_t digest[32]);
+
+private:
+  uint32_t m_state[8];
+  uint64_t m_length;
+  uint8_t  m_block[64];
+  uint8_t  m_blockLen;
+
+  void transform(const uint8_t *block);
+};
+
+#endif